@@ -3,92 +3,173 @@
 #include "NFA.h"
 #include "debug.h"
 
-void free_node(Node *to_free);
-
-Node *create_node(size_t *id) {
-    Node *new = malloc(sizeof(Node));
-    new->edges = VLA_initialize(1, sizeof(Edge));
-    new->id = *id;
-
-    *id += 1;
+// Die Knoten bekommen fortlaufende IDs, node_count ist also immer die nächste freie.
+Node *create_node(NFA *nfa) {
+    Node *new = arena_allocate(nfa->arena, sizeof(Node));
+    new->id = nfa->node_count++;
     return new;
 }
 
-void free_node(Node *to_free) {
-    VLA_free(to_free->edges);
-    free(to_free);
-}
-
 NFA *initialize_nfa() {
-    NFA *new = malloc(sizeof(NFA));
+    Arena *arena = initialize_arena();
+    NFA *new = arena_allocate(arena, sizeof(NFA));
     new->start = NULL;
     new->stop = NULL;
+    new->node_count = 0;
+    new->group_count = 0;
+    new->arena = arena;
     return new;
 }
 
-void free_nfa(NFA *nfa, Node **nodes) {
-    for (size_t index = 0; index < nfa->node_count; index++) {
-        free_node(nodes[index]);
-    }
-    free(nfa);
+void free_nfa(NFA *nfa) {
+    free_arena(nfa->arena);
 }
 
 Compact_NFA *initialize_compact_nfa(size_t node_count) {
-    Compact_NFA *new = malloc(sizeof(Compact_NFA));
-    new->nodes = calloc(node_count, sizeof(Compact_Node));
+    Arena *arena = initialize_arena();
+    Compact_NFA *new = arena_allocate(arena, sizeof(Compact_NFA));
+    new->arena = arena;
+    new->nodes = arena_allocate(arena, node_count * sizeof(Compact_Node));
     new->node_count = node_count;
     new->start_node_index = 0;
     new->stop_node_index = 1;
+    new->pattern_ids = NULL;
+    new->group_count = 0;
 
     return new;
 }
 
-void free_compact_nfa(Compact_NFA *compact_nfa) {
+Compact_NFA *copy_compact_nfa(Compact_NFA *compact_nfa) {
+    Compact_NFA *copy = initialize_compact_nfa(compact_nfa->node_count);
+    copy->start_node_index = compact_nfa->start_node_index;
+    copy->stop_node_index = compact_nfa->stop_node_index;
+    copy->group_count = compact_nfa->group_count;
+    if (compact_nfa->pattern_ids != NULL) {
+        copy->pattern_ids = arena_allocate(copy->arena, compact_nfa->node_count * sizeof(size_t));
+        memcpy(copy->pattern_ids, compact_nfa->pattern_ids, compact_nfa->node_count * sizeof(size_t));
+    }
+
     for (size_t node_index = 0; node_index < compact_nfa->node_count; node_index++) {
-        for (size_t edge_index = 0; edge_index < compact_nfa->nodes[node_index].edge_count; edge_index++) {
-            free(compact_nfa->nodes[node_index].edges[edge_index].matches);
+        Compact_Node *original = &compact_nfa->nodes[node_index];
+        Compact_Node *node = &copy->nodes[node_index];
+        node->edge_count = original->edge_count;
+        node->edges = arena_allocate(copy->arena, node->edge_count * sizeof(Compact_Edge));
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            *edge = original->edges[edge_index];
+            if (edge->byte_set != NULL) {
+                edge->byte_set = arena_allocate(copy->arena, sizeof(Byte_Set));
+                *edge->byte_set = *original->edges[edge_index].byte_set;
+            }
+            if (edge->matches != NULL) {
+                edge->matches = arena_allocate(copy->arena, edge->match_length);
+                if (edge->match_length > 0) memcpy(edge->matches, original->edges[edge_index].matches, edge->match_length);
+            }
         }
-        free(compact_nfa->nodes[node_index].edges);
     }
 
-    free(compact_nfa->nodes);
-    free(compact_nfa);
+    return copy;
 }
 
-Compact_Node create_compact_node(Node *from) {
+void free_compact_nfa(Compact_NFA *compact_nfa) {
+    free_arena(compact_nfa->arena);
+}
+
+bool is_stop_node(Compact_NFA *compact_nfa, size_t node_index) {
+    if (node_index == compact_nfa->stop_node_index) return true;
+    return compact_nfa->pattern_ids != NULL && compact_nfa->pattern_ids[node_index] != NO_PATTERN;
+}
+
+Compact_Node create_compact_node(Compact_NFA *compact_nfa, Node *from) {
     Compact_Node new = {
-        .edges = calloc(VLA_get_length(from->edges), sizeof(Compact_Edge)),
-        .edge_count = VLA_get_length(from->edges),
+        .edges = arena_allocate(compact_nfa->arena, from->edge_count * sizeof(Compact_Edge)),
+        .edge_count = from->edge_count,
     };
 
     return new;
 }
 
-Compact_Edge create_compact_edge(Edge *from) {
+// Das Label wird in die Arena des Compact_NFA kopiert, damit der NFA danach freigegeben werden kann.
+Compact_Edge create_compact_edge(Compact_NFA *compact_nfa, Edge *from) {
     Compact_Edge new = {
-        .matches = (uint8_t *)from->matching,
-        .match_length = strlen(from->matching),
+        .matches = NULL,
+        .match_length = from->match_length,
+        .byte_set = NULL,
         .endpoint = from->endpoint->id,
+        .tag = from->tag,
+        .assertion = from->assertion,
     };
+    if (from->byte_set != NULL) {
+        new.byte_set = arena_allocate(compact_nfa->arena, sizeof(Byte_Set));
+        *new.byte_set = *from->byte_set;
+    } else {
+        new.matches = arena_allocate(compact_nfa->arena, from->match_length);
+        if (from->match_length > 0) memcpy(new.matches, from->matching, from->match_length);
+    }
 
     return new;
 }
 
-void add_edge_between(Node *from, Node *to, char *matching) {
+void add_edge_bytes(Byte_Set *set, const Compact_Edge *edge) {
+    if (edge->match_length == 0) return;
+    if (edge->byte_set == NULL) {
+        byte_set_add(set, edge->matches[0]);
+        return;
+    }
+    for (size_t word = 0; word < 4; word++) set->bits[word] |= edge->byte_set->bits[word];
+}
+
+bool get_single_edge_byte(const Compact_Edge *edge, uint8_t *byte) {
+    if (edge->match_length == 0) return false;
+    if (edge->byte_set == NULL) {
+        *byte = edge->matches[0];
+        return true;
+    }
+    if (byte_set_count(edge->byte_set) != 1) return false;
+    for (size_t word = 0; word < 4; word++) {
+        if (edge->byte_set->bits[word] != 0) *byte = word * 64 + __builtin_ctzll(edge->byte_set->bits[word]);
+    }
+    return true;
+}
+
+// Ist byte_set nicht NULL, wird die Menge in die Arena kopiert und die Kante verbraucht ein Byte daraus.
+void add_edge_between(NFA *nfa, Node *from, Node *to, char *matching, size_t match_length, const Byte_Set *byte_set) {
     if (from == NULL || to == NULL) {
         warn("Can't add edge between %p and %p because at least one of them doesn't exist.\n", from, to);
         return;
     }
 
-    debug("Adding edge between states z%u and z%u matching %s.\n", from->id, to->id, matching);
-    Edge *edge = (Edge *)VLA_reserve_next_slots(from->edges, 1);
+    debug("Adding edge between states z%u and z%u matching %.*s.\n", from->id, to->id, (int)match_length, matching);
+    Edge *edge = arena_allocate(nfa->arena, sizeof(Edge));
     edge->matching = matching;
+    edge->match_length = match_length;
     edge->endpoint = to;
+    if (byte_set != NULL) {
+        edge->byte_set = arena_allocate(nfa->arena, sizeof(Byte_Set));
+        *edge->byte_set = *byte_set;
+    }
+    if (from->last_edge == NULL) from->first_edge = edge;
+    else from->last_edge->next = edge;
+    from->last_edge = edge;
+    from->edge_count++;
 }
 
-void add_empty_edge_between(Node *from, Node *to) {
-    char *empty = calloc(1, sizeof(char));
-    add_edge_between(from, to, empty);
+void add_empty_edge_between(NFA *nfa, Node *from, Node *to) {
+    add_edge_between(nfa, from, to, NULL, 0, NULL);
+}
+
+void add_tagged_edge_between(NFA *nfa, Node *from, Node *to, size_t tag) {
+    add_empty_edge_between(nfa, from, to);
+    if (from != NULL && to != NULL) from->last_edge->tag = tag;
+}
+
+bool has_assertions(Compact_NFA *compact_nfa) {
+    for (size_t node = 0; node < compact_nfa->node_count; node++) {
+        for (size_t edge = 0; edge < compact_nfa->nodes[node].edge_count; edge++) {
+            if (compact_nfa->nodes[node].edges[edge].assertion != no_assertion) return true;
+        }
+    }
+    return false;
 }
 
 Node *VLA_binding_get_node_pointer(VLA *v, signed long index) {
@@ -96,11 +177,6 @@ Node *VLA_binding_get_node_pointer(VLA *v, signed long index) {
     return *(Node **)VLA_get(v, index);
 }
 
-Edge *VLA_binding_get_edge(VLA *v, signed long index) {
-    VLA_assert_item_size_matches(v, sizeof(Edge));
-    return (Edge *)VLA_get(v, index);
-}
-
 void node_pointer_formatter(VLA *output, void *item) {
     Node *casted = *(Node **)item;
     VLA_append(output, "z");
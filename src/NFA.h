@@ -1,7 +1,11 @@
 #ifndef NFA_H
 #define NFA_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "VLA.h"
+#include "arena.h"
+#include "byte_set.h"
 
 typedef struct Node Node;
 typedef struct Edge Edge;
@@ -10,27 +14,61 @@ typedef struct Compact_Node Compact_Node;
 typedef struct Compact_Edge Compact_Edge;
 typedef struct Compact_NFA Compact_NFA;
 
+#define NO_PATTERN SIZE_MAX
+// Slot 0 und 1 sind Anfang und Ende des ganzen Matches, Gruppe g schreibt in Slot 2g und 2g + 1. Kanten ohne Tag haben 0.
+#define NO_TAG 0
+
+// Bedingungen wie ^, $ und \b stehen an leeren Kanten, die nur passiert werden dürfen, wenn die Bedingung an der
+// aktuellen Position gilt. Sie hängen von den Bytes vor und hinter der Position ab, nicht von einem Zustand.
+typedef enum {
+    no_assertion = 0,
+    assertion_start = 1,
+    assertion_end = 2,
+    assertion_word_boundary = 3,
+} Assertion;
+
+// Alle Knoten, Kanten und Labels liegen in arena und werden mit free_nfa auf einmal freigegeben.
 struct NFA {
     Node *start;
     Node *stop;
     size_t node_count;
+    // Anzahl der Gruppen (...) im Regex, nummeriert in der Reihenfolge ihrer öffnenden Klammern ab 1.
+    size_t group_count;
+    Arena *arena;
 };
 
+// Die Kanten bilden eine Liste in der Reihenfolge, in der sie hinzugefügt wurden.
 struct Node {
-    VLA *edges;
+    Edge *first_edge;
+    Edge *last_edge;
+    size_t edge_count;
     size_t id;
 };
 
 struct Edge {
     Node *endpoint;
     char *matching;
+    size_t match_length;
+    // Bei Bereichen wie [a, z] die Menge der Bytes, von denen die Kante eines verbraucht, sonst NULL.
+    Byte_Set *byte_set;
+    // Leere Kanten an Gruppengrenzen schreiben die aktuelle Position in diesen Slot.
+    size_t tag;
+    Assertion assertion;
+    Edge *next;
 };
 
+// Der Compact_NFA selbst, seine Knoten, Kanten und Labels liegen in arena.
 struct Compact_NFA {
+    Arena *arena;
     Compact_Node *nodes;
     size_t node_count;
     size_t start_node_index;
     size_t stop_node_index;
+    // Nur bei Pattern-Sets: für jeden Knoten die Nummer des Patterns, dessen Stop-Knoten er ist, sonst NO_PATTERN.
+    size_t *pattern_ids;
+    // Wie bei NFA. Tags und Bedingungen an den Kanten hat aber nur der Automat direkt aus dem Generator,
+    // remove_empty_edges entfernt sie zusammen mit den leeren Kanten.
+    size_t group_count;
 };
 
 struct Compact_Node {
@@ -38,24 +76,43 @@ struct Compact_Node {
     size_t edge_count;
 };
 
+// Eine Kante verbraucht entweder das Byte matches[0], ein Byte aus byte_set (dann ist matches NULL)
+// oder, bei match_length 0, gar nichts.
 struct Compact_Edge {
     uint8_t *matches;
     size_t match_length;
+    Byte_Set *byte_set;
     size_t endpoint;
+    size_t tag;
+    Assertion assertion;
 };
 
-Node *create_node(size_t *id);
-void add_edge_between(Node *from, Node *to, char *matching);
-void add_empty_edge_between(Node *from, Node *to);
-Compact_Node create_compact_node(Node *from);
-Compact_Edge create_compact_edge(Edge *from);
+Node *create_node(NFA *nfa);
+void add_edge_between(NFA *nfa, Node *from, Node *to, char *matching, size_t match_length, const Byte_Set *byte_set);
+void add_empty_edge_between(NFA *nfa, Node *from, Node *to);
+void add_tagged_edge_between(NFA *nfa, Node *from, Node *to, size_t tag);
+// Ob eine Kante des Automaten eine Bedingung trägt.
+bool has_assertions(Compact_NFA *compact_nfa);
+Compact_Node create_compact_node(Compact_NFA *compact_nfa, Node *from);
+Compact_Edge create_compact_edge(Compact_NFA *compact_nfa, Edge *from);
 NFA *initialize_nfa();
-void free_nfa(NFA *NFA, Node **nodes);
+void free_nfa(NFA *NFA);
 Compact_NFA *initialize_compact_nfa(size_t node_count);
 void free_compact_nfa(Compact_NFA *compact_nfa);
+// Tiefe Kopie mit eigener Arena.
+Compact_NFA *copy_compact_nfa(Compact_NFA *compact_nfa);
+bool is_stop_node(Compact_NFA *compact_nfa, size_t node_index);
+// Fügt alle Bytes, die die Kante verbrauchen kann, zu set hinzu.
+void add_edge_bytes(Byte_Set *set, const Compact_Edge *edge);
+// Gibt true zurück, wenn die Kante genau ein bestimmtes Byte verbraucht, und schreibt es nach byte.
+bool get_single_edge_byte(const Compact_Edge *edge, uint8_t *byte);
+
+static inline bool edge_matches_byte(const Compact_Edge *edge, uint8_t byte) {
+    if (edge->match_length == 0) return false;
+    return edge->byte_set != NULL ? byte_set_contains(edge->byte_set, byte) : edge->matches[0] == byte;
+}
 
 Node *VLA_binding_get_node_pointer(VLA *v, signed long index);
-Edge *VLA_binding_get_edge(VLA *v, signed long index);
 void node_pointer_formatter(VLA *output, void *item);
 
 #endif
\ No newline at end of file
@@ -103,6 +103,11 @@ void VLA_clear(VLA* v) {
     v->length = 0;
 }
 
+void VLA_truncate(VLA* v, size_t length) {
+    if (v == NULL || length >= VLA_get_length(v)) return;
+    v->length = length * v->item_size;
+}
+
 uint8_t* VLA_get(VLA* v, signed long index) {
     index = VLA_normalize_index(v, index);
     VLA_assert_in_bounds(v, index);
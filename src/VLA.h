@@ -26,6 +26,7 @@ void VLA_append(VLA* v, void* address);
 void VLA_batch_append(VLA* v, void* address, size_t amount);
 void VLA_delete_at_index(VLA* v, signed long index);
 void VLA_clear(VLA* v);
+void VLA_truncate(VLA* v, size_t length);
 uint8_t* VLA_extract(VLA* v);
 uint8_t* VLA_get(VLA* v, signed long index);
 size_t VLA_get_length(VLA* v);
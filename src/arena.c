@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "debug.h"
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+#define FIRST_BLOCK_SIZE (4 << 10)
+#define MAX_BLOCK_SIZE (1 << 20)
+
+// Der aktuelle Block steht immer vorne in der Liste, nur in ihm wird noch Speicher vergeben.
+struct Arena_Block {
+    Arena_Block *next;
+    size_t size;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+Arena_Block *allocate_arena_block(size_t size);
+size_t align_arena_size(size_t size);
+
+Arena_Block *allocate_arena_block(size_t size) {
+    Arena_Block *block = malloc(sizeof(Arena_Block) + size);
+    if (block == NULL) {
+        panic("Could not allocate an arena block of %lu bytes, aborting.\n", size);
+    }
+    block->next = NULL;
+    block->size = size;
+    return block;
+}
+
+size_t align_arena_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+Arena *initialize_arena() {
+    Arena *new = malloc(sizeof(Arena));
+    new->blocks = NULL;
+    new->used = 0;
+    new->next_block_size = FIRST_BLOCK_SIZE;
+    return new;
+}
+
+void *arena_allocate(Arena *arena, size_t size) {
+    size = align_arena_size(size);
+    if (arena->blocks == NULL || arena->used + size > arena->blocks->size) {
+        // Große Objekte bekommen einen eigenen Block hinter dem aktuellen, damit dessen Rest nicht verloren geht.
+        if (size > arena->next_block_size / 2 && arena->blocks != NULL) {
+            Arena_Block *own = allocate_arena_block(size);
+            own->next = arena->blocks->next;
+            arena->blocks->next = own;
+            memset(own->data, 0, size);
+            return own->data;
+        }
+
+        size_t block_size = size > arena->next_block_size ? size : arena->next_block_size;
+        Arena_Block *block = allocate_arena_block(block_size);
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->used = 0;
+        if (arena->next_block_size < MAX_BLOCK_SIZE) arena->next_block_size *= 2;
+    }
+
+    void *allocated = arena->blocks->data + arena->used;
+    arena->used += size;
+    memset(allocated, 0, size);
+    return allocated;
+}
+
+void arena_adopt(Arena *into, Arena *from) {
+    if (from->blocks != NULL) {
+        Arena_Block *last = from->blocks;
+        while (last->next != NULL) last = last->next;
+        if (into->blocks == NULL) {
+            into->blocks = from->blocks;
+            into->used = from->used;
+        } else {
+            // Der aktuelle Block von into bleibt vorne, die übernommenen Blöcke sind voll genug.
+            last->next = into->blocks->next;
+            into->blocks->next = from->blocks;
+        }
+    }
+    free(from);
+}
+
+void free_arena(Arena *arena) {
+    Arena_Block *block = arena->blocks;
+    while (block != NULL) {
+        Arena_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct Arena Arena;
+typedef struct Arena_Block Arena_Block;
+
+// Ein Bump-Allokator für Speicher, der nur als Ganzes wieder freigegeben wird. Beim Übersetzen entstehen
+// sehr viele kleine Objekte, die so nur einen Zeiger verschieben statt malloc aufzurufen.
+struct Arena {
+    Arena_Block *blocks;
+    size_t used;
+    size_t next_block_size;
+};
+
+Arena *initialize_arena();
+// Gibt mit 0 initialisierten, passend ausgerichteten Speicher zurück, der bis free_arena gültig bleibt.
+void *arena_allocate(Arena *arena, size_t size);
+// Hängt alle Blöcke von from an into an. from wird dabei freigegeben, sein Speicher gehört danach into.
+void arena_adopt(Arena *into, Arena *from);
+void free_arena(Arena *arena);
+
+#endif
\ No newline at end of file
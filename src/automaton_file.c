@@ -0,0 +1,392 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "automaton_file.h"
+#include "lazy_dfa.h"
+#include "VLA.h"
+#include "debug.h"
+
+#define SECTION_ALIGNMENT 8
+// Für jeden Thread außer dem ersten wird beim Laden eine Lazy-DFA angelegt. Mehr hat kein Rechner, so ein Wert
+// kann nur aus einer beschädigten Datei stammen.
+#define MAX_FILE_THREAD_COUNT 4096
+
+File_Section append_section(VLA *file, const void *data, size_t item_size, size_t count);
+void append_nfa(VLA *file, Compact_NFA *nfa, File_NFA *header);
+File_Options encode_options(Regen_Options *options);
+bool write_file_atomically(const char *path, VLA *file);
+bool section_fits(File_Section *section, size_t item_size, size_t file_length);
+bool is_bool_array(const uint8_t *values, size_t count);
+bool decode_options(File_Options *encoded, Regen_Options *options);
+Compact_NFA *view_nfa(const uint8_t *mapping, size_t file_length, File_NFA *header);
+Epsilon_Closures *view_closures(const uint8_t *mapping, size_t file_length, Automaton_File_Header *header);
+Prefilter *view_prefilter(const uint8_t *mapping, size_t file_length, Automaton_File_Header *header);
+Full_DFA *view_full_dfa(const uint8_t *mapping, size_t file_length, Automaton_File_Header *header);
+bool read_automaton(const uint8_t *mapping, size_t file_length, Automaton_Parts *parts);
+
+// Jeder Abschnitt beginnt an einer durch SECTION_ALIGNMENT teilbaren Position, damit er direkt benutzt werden kann.
+File_Section append_section(VLA *file, const void *data, size_t item_size, size_t count) {
+    uint8_t zero = 0;
+    while (VLA_get_length(file) % SECTION_ALIGNMENT != 0) VLA_append(file, &zero);
+    File_Section section = {VLA_get_length(file), count};
+    if (count > 0) VLA_batch_append(file, (void *)data, item_size * count);
+    return section;
+}
+
+void append_nfa(VLA *file, Compact_NFA *nfa, File_NFA *header) {
+    header->node_count = nfa->node_count;
+    header->start_node_index = nfa->start_node_index;
+    header->stop_node_index = nfa->stop_node_index;
+    header->group_count = nfa->group_count;
+
+    VLA *nodes = VLA_initialize(nfa->node_count, sizeof(File_Node));
+    VLA *edges = VLA_initialize(nfa->node_count, sizeof(File_Edge));
+    VLA *byte_sets = VLA_initialize(4, sizeof(Byte_Set));
+    VLA *labels = VLA_initialize(16, sizeof(uint8_t));
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        Compact_Node *node = &nfa->nodes[node_index];
+        File_Node file_node = {VLA_get_length(edges), node->edge_count};
+        VLA_append(nodes, &file_node);
+
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            File_Edge file_edge = {
+                .endpoint = edge->endpoint,
+                .tag = edge->tag,
+                .byte_set = NO_FILE_INDEX,
+                .label = VLA_get_length(labels),
+                .match_length = edge->match_length,
+                .assertion = edge->assertion,
+            };
+            if (edge->byte_set != NULL) {
+                file_edge.byte_set = VLA_get_length(byte_sets);
+                VLA_append(byte_sets, edge->byte_set);
+            } else if (edge->match_length > 0) {
+                VLA_batch_append(labels, edge->matches, edge->match_length);
+            }
+            VLA_append(edges, &file_edge);
+        }
+    }
+
+    header->nodes = append_section(file, nodes->data, sizeof(File_Node), VLA_get_length(nodes));
+    header->edges = append_section(file, edges->data, sizeof(File_Edge), VLA_get_length(edges));
+    header->byte_sets = append_section(file, byte_sets->data, sizeof(Byte_Set), VLA_get_length(byte_sets));
+    header->labels = append_section(file, labels->data, sizeof(uint8_t), VLA_get_length(labels));
+    VLA_free(nodes);
+    VLA_free(edges);
+    VLA_free(byte_sets);
+    VLA_free(labels);
+}
+
+File_Options encode_options(Regen_Options *options) {
+    File_Options encoded = {
+        .engine = options->engine,
+        .dfa_cache_size = options->dfa_cache_size,
+        .dfa_state_limit = options->dfa_state_limit,
+        .thread_count = options->thread_count,
+        .match_mode = options->match_mode,
+        .captures = options->captures,
+        .multiline = options->multiline,
+        .max_states = options->max_states,
+        .max_matches = options->max_matches,
+        .max_steps = options->max_steps,
+        .max_memory = options->max_memory,
+    };
+    return encoded;
+}
+
+bool write_file_atomically(const char *path, VLA *file) {
+    char temporary[strlen(path) + 32];
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid());
+    int descriptor = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        warn("Can't create %s: %s\n", temporary, strerror(errno));
+        return false;
+    }
+
+    size_t length = VLA_get_length(file);
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result = write(descriptor, file->data + written, length - written);
+        if (result < 0 && errno == EINTR) continue;
+        if (result < 0) break;
+        written += result;
+    }
+    bool complete = written == length && close(descriptor) == 0;
+    if (written != length) close(descriptor);
+    if (!complete || rename(temporary, path) != 0) {
+        warn("Can't write %s: %s\n", path, strerror(errno));
+        unlink(temporary);
+        return false;
+    }
+    return true;
+}
+
+bool save_automaton(Automaton_Parts *parts, const char *path) {
+    Automaton_File_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AUTOMATON_MAGIC, sizeof(header.magic));
+    header.version = AUTOMATON_VERSION;
+    header.byte_order = AUTOMATON_BYTE_ORDER;
+    header.word_size = sizeof(size_t);
+    header.prefilter_size = sizeof(Prefilter);
+    header.classes_size = sizeof(Byte_Classes);
+    header.has_assertions = parts->has_assertions;
+    header.options = encode_options(&parts->options);
+
+    // Der Header wird erst zum Schluss eingetragen, wenn alle Offsets feststehen.
+    VLA *file = VLA_initialize(sizeof(header) + 1024, sizeof(uint8_t));
+    append_section(file, &header, sizeof(header), 1);
+    append_nfa(file, parts->nfa, &header.nfa);
+    if (parts->tagged_nfa != NULL) append_nfa(file, parts->tagged_nfa, &header.tagged_nfa);
+
+    Epsilon_Closures *closures = parts->closures;
+    header.closure_offsets = append_section(file, closures->offsets, sizeof(size_t), closures->node_count + 1);
+    header.closure_members = append_section(file, closures->members, sizeof(size_t), closures->offsets[closures->node_count]);
+    header.closure_accepting = append_section(file, closures->accepting, sizeof(bool), closures->node_count);
+    header.prefilter = append_section(file, parts->prefilter, sizeof(Prefilter), 1);
+
+    Full_DFA *dfa = parts->full_dfa;
+    if (dfa != NULL) {
+        size_t entries = dfa->state_count * dfa->classes.class_count;
+        header.dfa_classes = append_section(file, &dfa->classes, sizeof(Byte_Classes), 1);
+        if (dfa->wide) header.dfa_transitions = append_section(file, dfa->wide_transitions, sizeof(uint32_t), entries);
+        else header.dfa_transitions = append_section(file, dfa->narrow_transitions, sizeof(uint16_t), entries);
+        header.dfa_accepting = append_section(file, dfa->accepting, sizeof(bool), dfa->state_count);
+        header.dfa_state_count = dfa->state_count;
+        header.dfa_start_state = dfa->start_state;
+        header.dfa_wide = dfa->wide;
+    }
+
+    header.file_length = VLA_get_length(file);
+    memcpy(file->data, &header, sizeof(header));
+    bool saved = write_file_atomically(path, file);
+    VLA_free(file);
+    return saved;
+}
+
+bool section_fits(File_Section *section, size_t item_size, size_t file_length) {
+    if (section->offset % SECTION_ALIGNMENT != 0 || section->offset > file_length) return false;
+    return section->count <= (file_length - section->offset) / item_size;
+}
+
+bool is_bool_array(const uint8_t *values, size_t count) {
+    for (size_t index = 0; index < count; index++) {
+        if (values[index] > 1) return false;
+    }
+    return true;
+}
+
+bool decode_options(File_Options *encoded, Regen_Options *options) {
+    if (encoded->engine > engine_full_dfa || encoded->match_mode > match_shortest) return false;
+    if (encoded->captures > 1 || encoded->multiline > 1 || encoded->thread_count > MAX_FILE_THREAD_COUNT) return false;
+    options->engine = encoded->engine;
+    options->dfa_cache_size = encoded->dfa_cache_size;
+    options->dfa_state_limit = encoded->dfa_state_limit;
+    options->thread_count = encoded->thread_count > 0 ? encoded->thread_count : 1;
+    options->match_mode = encoded->match_mode;
+    options->captures = encoded->captures;
+    options->multiline = encoded->multiline;
+    options->max_states = encoded->max_states;
+    options->max_matches = encoded->max_matches;
+    options->max_steps = encoded->max_steps;
+    options->max_memory = encoded->max_memory;
+    return true;
+}
+
+// Die Engines verlassen sich darauf, dass jeder Index im Automaten gültig ist. Eine beschädigte Datei muss deshalb
+// hier auffallen, geprüft wird in einem Durchlauf über die Kanten.
+Compact_NFA *view_nfa(const uint8_t *mapping, size_t file_length, File_NFA *header) {
+    size_t node_count = header->node_count;
+    if (!section_fits(&header->nodes, sizeof(File_Node), file_length) || header->nodes.count != node_count) return NULL;
+    if (!section_fits(&header->edges, sizeof(File_Edge), file_length)) return NULL;
+    if (!section_fits(&header->byte_sets, sizeof(Byte_Set), file_length)) return NULL;
+    if (!section_fits(&header->labels, sizeof(uint8_t), file_length)) return NULL;
+    if (header->start_node_index >= node_count || header->stop_node_index >= node_count) return NULL;
+
+    const File_Node *nodes = (const File_Node *)(mapping + header->nodes.offset);
+    const File_Edge *edges = (const File_Edge *)(mapping + header->edges.offset);
+    Byte_Set *byte_sets = (Byte_Set *)(mapping + header->byte_sets.offset);
+    uint8_t *labels = (uint8_t *)(mapping + header->labels.offset);
+    size_t edge_count = header->edges.count;
+
+    Compact_NFA *nfa = initialize_compact_nfa(node_count);
+    nfa->start_node_index = header->start_node_index;
+    nfa->stop_node_index = header->stop_node_index;
+    nfa->group_count = header->group_count;
+    Compact_Edge *compact_edges = arena_allocate(nfa->arena, edge_count * sizeof(Compact_Edge));
+
+    for (size_t node_index = 0; node_index < node_count; node_index++) {
+        const File_Node *node = &nodes[node_index];
+        if (node->first_edge > edge_count || node->edge_count > edge_count - node->first_edge) goto invalid;
+        nfa->nodes[node_index].edges = compact_edges + node->first_edge;
+        nfa->nodes[node_index].edge_count = node->edge_count;
+    }
+
+    for (size_t edge_index = 0; edge_index < edge_count; edge_index++) {
+        const File_Edge *edge = &edges[edge_index];
+        if (edge->endpoint >= node_count || edge->assertion > assertion_word_boundary) goto invalid;
+        if (edge->tag > 2 * header->group_count + 1) goto invalid;
+        Compact_Edge *compact = &compact_edges[edge_index];
+        compact->match_length = edge->match_length;
+        compact->endpoint = edge->endpoint;
+        compact->tag = edge->tag;
+        compact->assertion = edge->assertion;
+        compact->byte_set = NULL;
+        compact->matches = NULL;
+        if (edge->byte_set != NO_FILE_INDEX) {
+            if (edge->byte_set >= header->byte_sets.count) goto invalid;
+            compact->byte_set = &byte_sets[edge->byte_set];
+        } else {
+            if (edge->label > header->labels.count || edge->match_length > header->labels.count - edge->label) goto invalid;
+            compact->matches = labels + edge->label;
+        }
+    }
+    return nfa;
+
+invalid:
+    free_compact_nfa(nfa);
+    return NULL;
+}
+
+Epsilon_Closures *view_closures(const uint8_t *mapping, size_t file_length, Automaton_File_Header *header) {
+    size_t node_count = header->nfa.node_count;
+    if (!section_fits(&header->closure_offsets, sizeof(size_t), file_length)) return NULL;
+    if (!section_fits(&header->closure_members, sizeof(size_t), file_length)) return NULL;
+    if (!section_fits(&header->closure_accepting, sizeof(bool), file_length)) return NULL;
+    if (header->closure_offsets.count != node_count + 1 || header->closure_accepting.count != node_count) return NULL;
+
+    size_t *offsets = (size_t *)(mapping + header->closure_offsets.offset);
+    size_t *members = (size_t *)(mapping + header->closure_members.offset);
+    bool *accepting = (bool *)(mapping + header->closure_accepting.offset);
+    if (offsets[0] != 0 || offsets[node_count] != header->closure_members.count) return NULL;
+    for (size_t node_index = 0; node_index < node_count; node_index++) {
+        if (offsets[node_index] > offsets[node_index + 1]) return NULL;
+    }
+    for (size_t member = 0; member < header->closure_members.count; member++) {
+        if (members[member] >= node_count) return NULL;
+    }
+    if (!is_bool_array((const uint8_t *)accepting, node_count)) return NULL;
+
+    Epsilon_Closures *closures = malloc(sizeof(Epsilon_Closures));
+    closures->offsets = offsets;
+    closures->members = members;
+    closures->accepting = accepting;
+    closures->node_count = node_count;
+    return closures;
+}
+
+Prefilter *view_prefilter(const uint8_t *mapping, size_t file_length, Automaton_File_Header *header) {
+    if (!section_fits(&header->prefilter, sizeof(Prefilter), file_length) || header->prefilter.count != 1) return NULL;
+    Prefilter *prefilter = (Prefilter *)(mapping + header->prefilter.offset);
+    if (prefilter->prefix_length > MAX_LITERAL_LENGTH || prefilter->suffix_length > MAX_LITERAL_LENGTH) return NULL;
+    if (!is_bool_array((const uint8_t *)&prefilter->has_first_bytes, 1)) return NULL;
+    // Horspool springt um die Werte aus den Tabellen weiter, eine 0 hielte die Suche an.
+    for (size_t byte = 0; byte < 256; byte++) {
+        size_t prefix_skip = prefilter->prefix_skip[byte];
+        size_t suffix_skip = prefilter->suffix_skip[byte];
+        if (prefilter->prefix_length > 1 && (prefix_skip == 0 || prefix_skip > prefilter->prefix_length)) return NULL;
+        if (prefilter->suffix_length > 1 && (suffix_skip == 0 || suffix_skip > prefilter->suffix_length)) return NULL;
+    }
+    return prefilter;
+}
+
+Full_DFA *view_full_dfa(const uint8_t *mapping, size_t file_length, Automaton_File_Header *header) {
+    size_t state_count = header->dfa_state_count;
+    size_t transition_size = header->dfa_wide ? sizeof(uint32_t) : sizeof(uint16_t);
+    if (!section_fits(&header->dfa_classes, sizeof(Byte_Classes), file_length) || header->dfa_classes.count != 1) return NULL;
+    if (!section_fits(&header->dfa_transitions, transition_size, file_length)) return NULL;
+    if (!section_fits(&header->dfa_accepting, sizeof(bool), file_length) || header->dfa_accepting.count != state_count) return NULL;
+    if (state_count == 0 || header->dfa_start_state >= state_count || header->dfa_wide != (state_count > UINT16_MAX)) return NULL;
+
+    Full_DFA *dfa = malloc(sizeof(Full_DFA));
+    memcpy(&dfa->classes, mapping + header->dfa_classes.offset, sizeof(Byte_Classes));
+    size_t class_count = dfa->classes.class_count;
+    bool valid = class_count > 0 && class_count <= 256 && header->dfa_transitions.count == state_count * class_count;
+    for (size_t byte = 0; valid && byte < 256; byte++) valid = dfa->classes.class_of[byte] < class_count;
+
+    dfa->state_count = state_count;
+    dfa->start_state = header->dfa_start_state;
+    dfa->wide = header->dfa_wide;
+    dfa->narrow_transitions = dfa->wide ? NULL : (uint16_t *)(mapping + header->dfa_transitions.offset);
+    dfa->wide_transitions = dfa->wide ? (uint32_t *)(mapping + header->dfa_transitions.offset) : NULL;
+    dfa->accepting = (bool *)(mapping + header->dfa_accepting.offset);
+    for (size_t entry = 0; valid && entry < header->dfa_transitions.count; entry++) {
+        size_t target = dfa->wide ? dfa->wide_transitions[entry] : dfa->narrow_transitions[entry];
+        valid = target < state_count;
+    }
+    if (!valid || !is_bool_array((const uint8_t *)dfa->accepting, state_count)) {
+        free(dfa);
+        return NULL;
+    }
+    return dfa;
+}
+
+bool read_automaton(const uint8_t *mapping, size_t file_length, Automaton_Parts *parts) {
+    Automaton_File_Header *header = (Automaton_File_Header *)mapping;
+    if (memcmp(header->magic, AUTOMATON_MAGIC, sizeof(header->magic)) != 0 || header->version != AUTOMATON_VERSION) return false;
+    if (header->byte_order != AUTOMATON_BYTE_ORDER || header->word_size != sizeof(size_t)) return false;
+    if (header->prefilter_size != sizeof(Prefilter) || header->classes_size != sizeof(Byte_Classes)) return false;
+    if (header->file_length != file_length || header->has_assertions > 1) return false;
+    if (!decode_options(&header->options, &parts->options)) return false;
+
+    parts->tagged_nfa = NULL;
+    parts->full_dfa = NULL;
+    parts->has_assertions = header->has_assertions;
+    parts->nfa = view_nfa(mapping, file_length, &header->nfa);
+    if (header->tagged_nfa.node_count > 0) parts->tagged_nfa = view_nfa(mapping, file_length, &header->tagged_nfa);
+    parts->closures = view_closures(mapping, file_length, header);
+    parts->prefilter = view_prefilter(mapping, file_length, header);
+    if (header->dfa_state_count > 0) parts->full_dfa = view_full_dfa(mapping, file_length, header);
+
+    bool needs_tagged_nfa = parts->has_assertions || parts->options.captures;
+    bool complete = parts->nfa != NULL && parts->closures != NULL && parts->prefilter != NULL;
+    complete = complete && (parts->tagged_nfa != NULL || !needs_tagged_nfa) && (header->tagged_nfa.node_count == 0 || parts->tagged_nfa != NULL);
+    complete = complete && (parts->full_dfa != NULL) == (parts->options.engine == engine_full_dfa);
+    if (!complete) free_loaded_automaton(parts, NULL, 0);
+    return complete;
+}
+
+void *load_automaton(const char *path, Automaton_Parts *parts, size_t *mapping_length) {
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        warn("Can't open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat file_stat;
+    if (fstat(descriptor, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(Automaton_File_Header)) {
+        warn("%s is not a compiled regex.\n", path);
+        close(descriptor);
+        return NULL;
+    }
+
+    // MAP_SHARED und nur lesbar: alle Prozesse, die dieselbe Datei laden, teilen sich ihre Seiten im Page-Cache.
+    size_t length = file_stat.st_size;
+    void *mapping = mmap(NULL, length, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED) {
+        warn("Can't map %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (!read_automaton(mapping, length, parts)) {
+        warn("%s is not a compiled regex of this version of regen.\n", path);
+        munmap(mapping, length);
+        return NULL;
+    }
+
+    debug("Loaded %s with %lu NFA nodes.\n", path, parts->nfa->node_count);
+    *mapping_length = length;
+    return mapping;
+}
+
+// Nur die Hüllen um die Tabellen gehören dem Prozess, die Tabellen selbst gehören zur Abbildung.
+void free_loaded_automaton(Automaton_Parts *parts, void *mapping, size_t mapping_length) {
+    if (parts->nfa != NULL) free_compact_nfa(parts->nfa);
+    if (parts->tagged_nfa != NULL) free_compact_nfa(parts->tagged_nfa);
+    free(parts->closures);
+    free(parts->full_dfa);
+    if (mapping != NULL) munmap(mapping, mapping_length);
+}
\ No newline at end of file
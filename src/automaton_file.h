@@ -0,0 +1,113 @@
+#ifndef AUTOMATON_FILE_H
+#define AUTOMATON_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "NFA.h"
+#include "closure.h"
+#include "prefilter.h"
+#include "full_dfa.h"
+#include "matcher.h"
+
+// Dateiformat für übersetzte Automaten. Alle Abschnitte sind flache Arrays, die sich über Offsets ab dem Anfang
+// der Datei statt über Zeiger referenzieren, die Datei kann also an jeder Adresse eingeblendet werden.
+// Ändert sich das Layout eines Abschnitts, muss AUTOMATON_VERSION steigen.
+#define AUTOMATON_MAGIC "regenFA"
+#define AUTOMATON_VERSION 1
+#define AUTOMATON_BYTE_ORDER 0x01020304
+
+typedef struct {
+    uint64_t offset;
+    uint64_t count;
+} File_Section;
+
+typedef struct {
+    uint64_t first_edge;
+    uint64_t edge_count;
+} File_Node;
+
+typedef struct {
+    uint64_t endpoint;
+    uint64_t tag;
+    // Index in byte_sets, oder NO_FILE_INDEX, dann verbraucht die Kante die match_length Bytes ab label in labels.
+    uint64_t byte_set;
+    uint64_t label;
+    uint32_t match_length;
+    uint32_t assertion;
+} File_Edge;
+
+#define NO_FILE_INDEX UINT64_MAX
+
+typedef struct {
+    uint64_t node_count;
+    uint64_t start_node_index;
+    uint64_t stop_node_index;
+    uint64_t group_count;
+    File_Section nodes;
+    File_Section edges;
+    File_Section byte_sets;
+    File_Section labels;
+} File_NFA;
+
+typedef struct {
+    uint64_t engine;
+    uint64_t dfa_cache_size;
+    uint64_t dfa_state_limit;
+    uint64_t thread_count;
+    uint64_t match_mode;
+    uint64_t captures;
+    uint64_t multiline;
+    uint64_t max_states;
+    uint64_t max_matches;
+    uint64_t max_steps;
+    uint64_t max_memory;
+} File_Options;
+
+// Die Hüllen, der Prefilter und der DFA werden direkt aus der Datei benutzt. Deren Strukturen und Wortbreite
+// stehen deshalb im Header, eine Datei von einer anderen Plattform wird abgelehnt statt falsch gelesen.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t word_size;
+    uint32_t prefilter_size;
+    uint32_t classes_size;
+    uint32_t has_assertions;
+    uint64_t file_length;
+    File_Options options;
+    File_NFA nfa;
+    // node_count ist 0, falls der Regex ohne Gruppen und Bedingungen übersetzt wurde.
+    File_NFA tagged_nfa;
+    File_Section closure_offsets;
+    File_Section closure_members;
+    File_Section closure_accepting;
+    File_Section prefilter;
+    // Ohne engine_full_dfa sind alle count 0.
+    File_Section dfa_classes;
+    File_Section dfa_transitions;
+    File_Section dfa_accepting;
+    uint64_t dfa_state_count;
+    uint64_t dfa_start_state;
+    uint64_t dfa_wide;
+} Automaton_File_Header;
+
+// Alles, was beim Übersetzen entsteht. Die Caches der Engines fehlen, die baut erst das Matchen auf.
+typedef struct {
+    Compact_NFA *nfa;
+    Epsilon_Closures *closures;
+    Prefilter *prefilter;
+    Full_DFA *full_dfa;
+    Compact_NFA *tagged_nfa;
+    Regen_Options options;
+    bool has_assertions;
+} Automaton_Parts;
+
+// Schreibt erst in eine temporäre Datei und benennt sie dann um, Prozesse mit der alten Datei behalten also deren Inhalt.
+bool save_automaton(Automaton_Parts *parts, const char *path);
+// Blendet die Datei nur lesbar ein und gibt die Abbildung zurück, oder NULL, falls sie fehlt oder nicht passt.
+// Die Tabellen in parts zeigen direkt in die Abbildung, nur die Knoten und Kanten der NFAs bekommen eigene
+// Arrays, deren Labels und Byte-Mengen aber auch in der Datei liegen.
+void *load_automaton(const char *path, Automaton_Parts *parts, size_t *mapping_length);
+void free_loaded_automaton(Automaton_Parts *parts, void *mapping, size_t mapping_length);
+
+#endif
\ No newline at end of file
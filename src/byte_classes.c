@@ -0,0 +1,82 @@
+#include <string.h>
+#include "byte_classes.h"
+#include "byte_set.h"
+#include "debug.h"
+
+#define NO_CLASS UINT16_MAX
+
+void refine_byte_classes(Byte_Classes *classes, size_t *class_sizes, const Byte_Set *set);
+void number_classes_by_first_byte(Byte_Classes *classes);
+
+// Zerlegt jede Klasse, die set nur teilweise enthält, in den Teil innerhalb und den außerhalb von set.
+void refine_byte_classes(Byte_Classes *classes, size_t *class_sizes, const Byte_Set *set) {
+    size_t inside[256] = {0};
+    uint16_t split_into[256];
+    for (size_t word = 0; word < 4; word++) {
+        for (uint64_t bits = set->bits[word]; bits != 0; bits &= bits - 1) {
+            inside[classes->class_of[word * 64 + __builtin_ctzll(bits)]]++;
+        }
+    }
+
+    // Erst entscheiden, welche Klassen zerfallen, weil sich die Größen beim Verschieben ändern.
+    size_t old_class_count = classes->class_count;
+    for (size_t class = 0; class < old_class_count; class++) {
+        split_into[class] = inside[class] > 0 && inside[class] < class_sizes[class] ? classes->class_count++ : NO_CLASS;
+    }
+    for (size_t word = 0; word < 4; word++) {
+        for (uint64_t bits = set->bits[word]; bits != 0; bits &= bits - 1) {
+            size_t byte = word * 64 + __builtin_ctzll(bits);
+            size_t class = classes->class_of[byte];
+            if (split_into[class] == NO_CLASS) continue;
+            classes->class_of[byte] = split_into[class];
+            class_sizes[class]--;
+            class_sizes[split_into[class]]++;
+        }
+    }
+}
+
+void number_classes_by_first_byte(Byte_Classes *classes) {
+    uint16_t renamed[256];
+    for (size_t class = 0; class < classes->class_count; class++) renamed[class] = NO_CLASS;
+    size_t next_name = 0;
+    for (size_t byte = 0; byte < 256; byte++) {
+        size_t class = classes->class_of[byte];
+        if (renamed[class] == NO_CLASS) {
+            renamed[class] = next_name;
+            classes->representatives[next_name++] = byte;
+        }
+        classes->class_of[byte] = renamed[class];
+    }
+}
+
+// Maßgeblich ist für jeden Knoten die Menge der Bytes, die zum selben Nachfolger führen. So landen z.B. a und b
+// aus (a|b)c in derselben Klasse, obwohl es zwei Kanten sind.
+void compute_byte_classes(Compact_NFA *nfa, Byte_Classes *classes) {
+    size_t class_sizes[256] = {256};
+    memset(classes->class_of, 0, sizeof(classes->class_of));
+    classes->class_count = 1;
+
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        Compact_Node *node = &nfa->nodes[node_index];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            if (edge->match_length == 0) continue;
+
+            // Jeder Nachfolger wird nur bei seiner ersten Kante betrachtet, dann aber mit allen Kanten zu ihm.
+            bool seen = false;
+            for (size_t earlier = 0; earlier < edge_index && !seen; earlier++) {
+                seen = node->edges[earlier].match_length > 0 && node->edges[earlier].endpoint == edge->endpoint;
+            }
+            if (seen) continue;
+
+            Byte_Set set = {0};
+            for (size_t later = edge_index; later < node->edge_count; later++) {
+                if (node->edges[later].endpoint == edge->endpoint) add_edge_bytes(&set, &node->edges[later]);
+            }
+            refine_byte_classes(classes, class_sizes, &set);
+        }
+    }
+
+    number_classes_by_first_byte(classes);
+    debug("Split the alphabet into %lu byte classes.\n", classes->class_count);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef BYTE_CLASSES_H
+#define BYTE_CLASSES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "NFA.h"
+
+// Teilt die 256 Bytes in Klassen, die der Automat nicht unterscheiden kann: zwei Bytes derselben Klasse führen
+// aus jedem Knoten zu denselben Nachfolgern. Übergangstabellen brauchen dann nur eine Spalte pro Klasse.
+typedef struct {
+    uint8_t class_of[256];
+    // Das kleinste Byte jeder Klasse, die Klassen sind danach sortiert.
+    uint8_t representatives[256];
+    size_t class_count;
+} Byte_Classes;
+
+void compute_byte_classes(Compact_NFA *nfa, Byte_Classes *classes);
+
+#endif
\ No newline at end of file
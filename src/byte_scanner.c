@@ -0,0 +1,116 @@
+#include <stdatomic.h>
+#include "byte_scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+typedef size_t (*Byte_Scan_Function)(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from);
+
+size_t scan_scalar(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from);
+Byte_Scan_Function select_scan_function();
+Byte_Scan_Function get_scan_function();
+#ifdef HAVE_X86_SIMD
+size_t scan_ssse3(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from);
+size_t scan_avx2(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from);
+#endif
+
+// Mehrere Threads können gleichzeitig übersetzen oder suchen. Alle wählen dieselbe Funktion, es reicht also, dass
+// Lesen und Schreiben atomar sind, eine Reihenfolge zu anderen Speicherzugriffen braucht es nicht.
+static _Atomic(Byte_Scan_Function) scan_function = NULL;
+
+void initialize_byte_scanner(Byte_Scanner *scanner, const Byte_Set *set) {
+    scanner->set = *set;
+    // Schon beim Übersetzen auswählen, damit die Suche nicht erst die CPU prüfen muss.
+    get_scan_function();
+    for (size_t nibble = 0; nibble < 16; nibble++) {
+        scanner->low_nibbles[0][nibble] = 0;
+        scanner->low_nibbles[1][nibble] = 0;
+        scanner->high_nibbles[0][nibble] = nibble < 8 ? 1 << nibble : 0;
+        scanner->high_nibbles[1][nibble] = nibble < 8 ? 0 : 1 << (nibble - 8);
+    }
+
+    for (size_t byte = 0; byte < 256; byte++) {
+        if (!byte_set_contains(set, byte)) continue;
+        size_t high = byte >> 4;
+        scanner->low_nibbles[high >= 8][byte & 15] |= 1 << (high & 7);
+    }
+}
+
+size_t scan_scalar(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from) {
+    for (size_t position = from; position < length; position++) {
+        if (byte_set_contains(&scanner->set, data[position])) return position;
+    }
+    return length;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("ssse3")))
+size_t scan_ssse3(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from) {
+    const __m128i low_first = _mm_loadu_si128((const __m128i *)scanner->low_nibbles[0]);
+    const __m128i low_second = _mm_loadu_si128((const __m128i *)scanner->low_nibbles[1]);
+    const __m128i high_first = _mm_loadu_si128((const __m128i *)scanner->high_nibbles[0]);
+    const __m128i high_second = _mm_loadu_si128((const __m128i *)scanner->high_nibbles[1]);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t position = from;
+    for (; position + 16 <= length; position += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + position));
+        __m128i low = _mm_and_si128(bytes, nibble_mask);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+        __m128i first = _mm_and_si128(_mm_shuffle_epi8(low_first, low), _mm_shuffle_epi8(high_first, high));
+        __m128i second = _mm_and_si128(_mm_shuffle_epi8(low_second, low), _mm_shuffle_epi8(high_second, high));
+        unsigned hits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(first, second), zero)) & 0xffff;
+        if (hits != 0) return position + __builtin_ctz(hits);
+    }
+    return scan_scalar(scanner, data, length, position);
+}
+
+__attribute__((target("avx2")))
+size_t scan_avx2(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from) {
+    // vpshufb arbeitet auf beiden 128-Bit-Hälften getrennt, deshalb stehen die Tabellen in beiden Hälften.
+    const __m256i low_first = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)scanner->low_nibbles[0]));
+    const __m256i low_second = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)scanner->low_nibbles[1]));
+    const __m256i high_first = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)scanner->high_nibbles[0]));
+    const __m256i high_second = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)scanner->high_nibbles[1]));
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t position = from;
+    for (; position + 32 <= length; position += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + position));
+        __m256i low = _mm256_and_si256(bytes, nibble_mask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble_mask);
+        __m256i first = _mm256_and_si256(_mm256_shuffle_epi8(low_first, low), _mm256_shuffle_epi8(high_first, high));
+        __m256i second = _mm256_and_si256(_mm256_shuffle_epi8(low_second, low), _mm256_shuffle_epi8(high_second, high));
+        uint32_t hits = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(first, second), zero));
+        if (hits != 0) return position + __builtin_ctz(hits);
+    }
+    return scan_ssse3(scanner, data, length, position);
+}
+#endif
+
+Byte_Scan_Function select_scan_function() {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scan_avx2;
+    if (__builtin_cpu_supports("ssse3")) return scan_ssse3;
+#endif
+    return scan_scalar;
+}
+
+// Ein mit regen_load geladener Scanner wurde nie initialisiert, deshalb wird auch hier noch ausgewählt.
+Byte_Scan_Function get_scan_function() {
+    Byte_Scan_Function selected = atomic_load_explicit(&scan_function, memory_order_relaxed);
+    if (selected == NULL) {
+        selected = select_scan_function();
+        atomic_store_explicit(&scan_function, selected, memory_order_relaxed);
+    }
+    return selected;
+}
+
+size_t find_byte_in_set(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from) {
+    return get_scan_function()(scanner, data, length, from);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef BYTE_SCANNER_H
+#define BYTE_SCANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "byte_set.h"
+
+// Sucht das nächste Byte, das in einer Menge liegt. Mit SSSE3 bzw. AVX2 werden 16 bzw. 32 Bytes auf einmal
+// über Nachschlagetabellen für das untere und obere Nibble geprüft (pshufb), sonst Byte für Byte.
+// Jede Tabelle deckt die Hälfte der oberen Nibbles ab, dadurch ist der Test für jede Menge exakt.
+typedef struct {
+    Byte_Set set;
+    uint8_t low_nibbles[2][16];
+    uint8_t high_nibbles[2][16];
+} Byte_Scanner;
+
+void initialize_byte_scanner(Byte_Scanner *scanner, const Byte_Set *set);
+// Gibt die erste Position >= from zurück, deren Byte in der Menge liegt, oder length.
+size_t find_byte_in_set(const Byte_Scanner *scanner, const uint8_t *data, size_t length, size_t from);
+
+#endif
\ No newline at end of file
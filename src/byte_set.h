@@ -0,0 +1,27 @@
+#ifndef BYTE_SET_H
+#define BYTE_SET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Eine Menge von Bytes als 256-Bit-Maske.
+typedef struct {
+    uint64_t bits[4];
+} Byte_Set;
+
+static inline void byte_set_add(Byte_Set *set, uint8_t byte) {
+    set->bits[byte >> 6] |= 1ULL << (byte & 63);
+}
+
+static inline bool byte_set_contains(const Byte_Set *set, uint8_t byte) {
+    return (set->bits[byte >> 6] >> (byte & 63)) & 1;
+}
+
+static inline size_t byte_set_count(const Byte_Set *set) {
+    size_t count = 0;
+    for (size_t index = 0; index < 4; index++) count += __builtin_popcountll(set->bits[index]);
+    return count;
+}
+
+#endif
\ No newline at end of file
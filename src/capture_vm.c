@@ -0,0 +1,573 @@
+#include <string.h>
+#include "capture_vm.h"
+#include "lanes.h"
+#include "stack.h"
+#include "debug.h"
+
+#define NO_EDGE SIZE_MAX
+
+typedef enum {
+    visit_node,
+    restore_slot,
+    add_edge_thread,
+} Closure_Action;
+
+// Ein Schritt der Epsilon-Hülle: node wird besucht, nachdem die aktuelle Position in slot geschrieben wurde,
+// slot bekommt beim Zurückgehen wieder value, damit die nächste Kante die Tags ihres Elternknotens sieht,
+// oder die verbrauchende Kante edge von node bekommt einen Thread.
+typedef struct {
+    Closure_Action action;
+    size_t node;
+    size_t edge;
+    size_t slot;
+    size_t value;
+} Closure_Step;
+
+// Ein Thread wartet auf einer verbrauchenden Kante oder, mit edge NO_EDGE, im Stop-Knoten. Die Kanten eines
+// Knotens können sich mit leeren Kanten abwechseln, deshalb reicht der Knoten allein nicht für die Priorität.
+typedef struct {
+    size_t node;
+    size_t edge;
+} Thread;
+
+// Eine Kante, die in einem Knoten endet, für den Lauf von hinten nach vorne.
+typedef struct {
+    size_t from;
+    size_t edge;
+} Incoming_Edge;
+
+// Die Threads stehen nach Startposition und dann nach Priorität geordnet, slots hat slot_count Einträge pro Thread.
+typedef struct {
+    VLA *threads;
+    VLA *slots;
+} Thread_List;
+
+struct Capture_VM {
+    Compact_NFA *nfa;
+    Regen_Match_Mode mode;
+    // ^ und $ gelten auch nach bzw. vor jedem \n.
+    bool multiline;
+    // Jeder Match muss am Anfang der Eingabe (mit multiline einer Zeile) anfangen bzw. an ihrem Ende aufhören.
+    bool anchored_start;
+    bool anchored_end;
+    // Ist das nicht NO_MATCH, wird nur diese Startposition versucht.
+    size_t only_start;
+    // Ohne Gruppen wird pro Match nur der ganze Match angehängt.
+    bool with_groups;
+    // Die Eingabe der laufenden Suche, an der die Bedingungen geprüft werden.
+    const uint8_t *data;
+    size_t length;
+    // Grenzen aus Regen_Options, 0 heißt ohne Grenze.
+    size_t max_matches;
+    size_t max_steps;
+    size_t max_memory;
+    // Die Matches der laufenden Suche ab first_new_match und die bisher verbrauchten Schritte.
+    VLA *matches;
+    size_t first_new_match;
+    size_t steps;
+    Regen_Status status;
+    size_t slot_count;
+    Thread_List current;
+    Thread_List next;
+    size_t *node_marks;
+    size_t mark;
+    Stack *closure;
+    size_t *working;
+    size_t *start_slots;
+    // Der beste Match der laufenden Suche, best[0] ist NO_MATCH, solange es keinen gibt.
+    size_t *best;
+    // Die Kanten, die in Knoten node enden, stehen in reverse_edges ab reverse_offsets[node].
+    size_t *reverse_offsets;
+    Incoming_Edge *reverse_edges;
+    Stack *pending;
+    VLA *reverse_current;
+    VLA *reverse_next;
+};
+
+void build_reverse_edges(Capture_VM *vm);
+bool is_anchored_start(Capture_VM *vm);
+bool is_anchored_end(Capture_VM *vm);
+bool is_word_byte(Capture_VM *vm, size_t position);
+bool assertion_holds(Capture_VM *vm, Assertion assertion, size_t position);
+size_t find_next_start(Capture_VM *vm, Prefilter *prefilter, Prefilter_Cursor *cursor, size_t from);
+size_t capture_vm_memory(Capture_VM *vm);
+bool limit_reached(Capture_VM *vm);
+void add_reverse_closure(Capture_VM *vm, VLA *nodes, size_t node_index, size_t position);
+void find_starts_backwards(Capture_VM *vm, VLA *starts);
+void find_end_anchored_matches(Capture_VM *vm, Prefilter *prefilter, VLA *matches);
+void initialize_thread_list(Thread_List *list, size_t slot_count);
+void free_thread_list(Thread_List *list);
+void clear_thread_list(Thread_List *list);
+void add_thread(Capture_VM *vm, Thread_List *list, size_t node_index, const size_t *slots, size_t position);
+void append_thread(Capture_VM *vm, Thread_List *list, size_t node_index, size_t edge_index);
+void step_thread(Capture_VM *vm, Thread *thread, const size_t *slots, uint8_t byte, size_t position);
+void swap_thread_lists(Capture_VM *vm);
+bool is_better_match(Capture_VM *vm, const size_t *slots, size_t position);
+bool find_best_match(Capture_VM *vm, Prefilter *prefilter, size_t from);
+void find_all_matches(Capture_VM *vm, Prefilter *prefilter, VLA *matches);
+void append_captures(Capture_VM *vm, const size_t *slots, size_t end, VLA *matches);
+int compare_capture_matches(const void *a, const void *b);
+
+void initialize_thread_list(Thread_List *list, size_t slot_count) {
+    list->threads = VLA_initialize(16, sizeof(Thread));
+    list->slots = VLA_initialize(16 * slot_count, sizeof(size_t));
+}
+
+void free_thread_list(Thread_List *list) {
+    VLA_free(list->threads);
+    VLA_free(list->slots);
+}
+
+void clear_thread_list(Thread_List *list) {
+    VLA_clear(list->threads);
+    VLA_clear(list->slots);
+}
+
+Capture_VM *initialize_capture_vm(Compact_NFA *nfa, Regen_Options *options) {
+    Capture_VM *vm = malloc(sizeof(Capture_VM));
+    vm->nfa = nfa;
+    vm->mode = options->match_mode;
+    vm->multiline = options->multiline;
+    vm->max_matches = options->max_matches;
+    vm->max_steps = options->max_steps;
+    vm->max_memory = options->max_memory;
+    vm->only_start = NO_MATCH;
+    vm->with_groups = true;
+    vm->slot_count = 2 * (nfa->group_count + 1);
+    initialize_thread_list(&vm->current, vm->slot_count);
+    initialize_thread_list(&vm->next, vm->slot_count);
+    vm->node_marks = calloc(nfa->node_count, sizeof(size_t));
+    vm->mark = 0;
+    vm->closure = stack_initialize(16, sizeof(Closure_Step));
+    vm->working = malloc(vm->slot_count * sizeof(size_t));
+    vm->start_slots = malloc(vm->slot_count * sizeof(size_t));
+    vm->best = malloc(vm->slot_count * sizeof(size_t));
+    for (size_t slot = 0; slot < vm->slot_count; slot++) vm->start_slots[slot] = NO_MATCH;
+    vm->pending = stack_initialize(16, sizeof(size_t));
+    vm->reverse_current = VLA_initialize(16, sizeof(size_t));
+    vm->reverse_next = VLA_initialize(16, sizeof(size_t));
+    build_reverse_edges(vm);
+    vm->anchored_start = is_anchored_start(vm);
+    vm->anchored_end = is_anchored_end(vm);
+    return vm;
+}
+
+void free_capture_vm(Capture_VM *vm) {
+    free_thread_list(&vm->current);
+    free_thread_list(&vm->next);
+    free(vm->node_marks);
+    VLA_free(vm->closure);
+    free(vm->working);
+    free(vm->start_slots);
+    free(vm->best);
+    free(vm->reverse_offsets);
+    free(vm->reverse_edges);
+    VLA_free(vm->pending);
+    VLA_free(vm->reverse_current);
+    VLA_free(vm->reverse_next);
+    free(vm);
+}
+
+void build_reverse_edges(Capture_VM *vm) {
+    Compact_NFA *nfa = vm->nfa;
+    vm->reverse_offsets = calloc(nfa->node_count + 1, sizeof(size_t));
+    for (size_t node = 0; node < nfa->node_count; node++) {
+        for (size_t edge = 0; edge < nfa->nodes[node].edge_count; edge++) vm->reverse_offsets[nfa->nodes[node].edges[edge].endpoint + 1]++;
+    }
+    for (size_t node = 0; node < nfa->node_count; node++) vm->reverse_offsets[node + 1] += vm->reverse_offsets[node];
+
+    vm->reverse_edges = malloc((vm->reverse_offsets[nfa->node_count] + 1) * sizeof(Incoming_Edge));
+    size_t *filled = calloc(nfa->node_count, sizeof(size_t));
+    for (size_t node = 0; node < nfa->node_count; node++) {
+        for (size_t edge = 0; edge < nfa->nodes[node].edge_count; edge++) {
+            size_t endpoint = nfa->nodes[node].edges[edge].endpoint;
+            vm->reverse_edges[vm->reverse_offsets[endpoint] + filled[endpoint]++] = (Incoming_Edge){.from = node, .edge = edge};
+        }
+    }
+    free(filled);
+}
+
+// Ob jeder Weg vom Start-Knoten zu einer verbrauchenden Kante oder zum Stop-Knoten über ein ^ führt.
+bool is_anchored_start(Capture_VM *vm) {
+    Compact_NFA *nfa = vm->nfa;
+    bool anchored = true;
+    vm->mark++;
+    stack_push(vm->pending, &nfa->start_node_index);
+    while (VLA_get_length(vm->pending) > 0) {
+        size_t node_index = *(size_t *)stack_pop(vm->pending);
+        if (!anchored || vm->node_marks[node_index] == vm->mark) continue;
+        vm->node_marks[node_index] = vm->mark;
+        if (node_index == nfa->stop_node_index) anchored = false;
+
+        Compact_Node *node = &nfa->nodes[node_index];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            if (edge->match_length > 0) anchored = false;
+            else if (edge->assertion != assertion_start) stack_push(vm->pending, &edge->endpoint);
+        }
+    }
+    return anchored;
+}
+
+// Wie is_anchored_start, nur rückwärts vom Stop-Knoten aus: Nach der letzten verbrauchenden Kante muss ein $ kommen.
+bool is_anchored_end(Capture_VM *vm) {
+    Compact_NFA *nfa = vm->nfa;
+    bool anchored = true;
+    vm->mark++;
+    stack_push(vm->pending, &nfa->stop_node_index);
+    while (VLA_get_length(vm->pending) > 0) {
+        size_t node_index = *(size_t *)stack_pop(vm->pending);
+        if (!anchored || vm->node_marks[node_index] == vm->mark) continue;
+        vm->node_marks[node_index] = vm->mark;
+        if (node_index == nfa->start_node_index) anchored = false;
+
+        for (size_t index = vm->reverse_offsets[node_index]; index < vm->reverse_offsets[node_index + 1]; index++) {
+            Incoming_Edge *incoming = &vm->reverse_edges[index];
+            Compact_Edge *edge = &nfa->nodes[incoming->from].edges[incoming->edge];
+            if (edge->match_length > 0) anchored = false;
+            else if (edge->assertion != assertion_end) stack_push(vm->pending, &incoming->from);
+        }
+    }
+    return anchored;
+}
+
+// Buchstaben, Ziffern und _ wie \w in anderen Regex-Engines. Außerhalb der Eingabe steht kein Wortzeichen.
+bool is_word_byte(Capture_VM *vm, size_t position) {
+    if (position >= vm->length) return false;
+    uint8_t byte = vm->data[position];
+    return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') || byte == '_';
+}
+
+// Die Position liegt zwischen den Bytes position - 1 und position.
+bool assertion_holds(Capture_VM *vm, Assertion assertion, size_t position) {
+    if (assertion == assertion_start) return position == 0 || (vm->multiline && vm->data[position - 1] == '\n');
+    if (assertion == assertion_end) return position == vm->length || (vm->multiline && vm->data[position] == '\n');
+    if (assertion == assertion_word_boundary) return (position > 0 && is_word_byte(vm, position - 1)) != is_word_byte(vm, position);
+    return true;
+}
+
+// Bei einem Regex mit ^ vorne kommen nur der Anfang der Eingabe und mit multiline die Zeilenanfänge in Frage. Die
+// sind billiger zu finden als mit dem Prefilter, der sonst bis zum nächsten Vorkommen seines Literals weiterliest.
+size_t find_next_start(Capture_VM *vm, Prefilter *prefilter, Prefilter_Cursor *cursor, size_t from) {
+    if (vm->only_start != NO_MATCH) return from <= vm->only_start ? vm->only_start : vm->length;
+    if (!vm->anchored_start) return find_next_candidate(prefilter, cursor, vm->data, vm->length, from);
+    if (from == 0) return 0;
+    if (!vm->multiline || from >= vm->length) return vm->length;
+    // Gesucht wird das nächste \n ab data[from - 1], aber vor dem letzten Byte.
+    const uint8_t *newline = memchr(vm->data + from - 1, '\n', vm->length - from);
+    return newline != NULL ? (size_t)(newline - vm->data) + 1 : vm->length;
+}
+
+size_t capture_vm_memory(Capture_VM *vm) {
+    VLA *lists[] = {vm->current.threads, vm->current.slots, vm->next.threads, vm->next.slots, vm->closure,
+                    vm->pending, vm->reverse_current, vm->reverse_next, vm->matches};
+    size_t memory = 0;
+    for (size_t list = 0; list < sizeof(lists) / sizeof(lists[0]); list++) memory += lists[list]->capacity;
+    return memory;
+}
+
+// Wird einmal pro Position geprüft. Ist eine Grenze erreicht, merkt sich die VM den Grund und hört auf.
+bool limit_reached(Capture_VM *vm) {
+    if (vm->status != regen_ok) return true;
+    size_t entries = vm->with_groups ? vm->slot_count / 2 : 1;
+    if (vm->max_matches > 0 && (VLA_get_length(vm->matches) - vm->first_new_match) / entries > vm->max_matches) {
+        vm->status = regen_match_limit;
+    } else if (vm->max_steps > 0 && vm->steps > vm->max_steps) {
+        vm->status = regen_step_limit;
+    } else if (vm->max_memory > 0 && capture_vm_memory(vm) > vm->max_memory) {
+        vm->status = regen_memory_limit;
+    }
+    return vm->status != regen_ok;
+}
+
+// Folgt ab node_index allen Kanten in ihrer Reihenfolge und hängt jede verbrauchende Kante und den Stop-Knoten
+// mit den bis dorthin geschriebenen Tags an list an. Knoten mit der aktuellen Markierung hat schon ein Thread
+// mit höherer Priorität erreicht, von ihnen aus geht es nicht weiter.
+void add_thread(Capture_VM *vm, Thread_List *list, size_t node_index, const size_t *slots, size_t position) {
+    memcpy(vm->working, slots, vm->slot_count * sizeof(size_t));
+    stack_push(vm->closure, &(Closure_Step){.action = visit_node, .node = node_index, .slot = NO_TAG});
+
+    while (VLA_get_length(vm->closure) > 0) {
+        Closure_Step step = *(Closure_Step *)stack_pop(vm->closure);
+        if (step.action == restore_slot) {
+            vm->working[step.slot] = step.value;
+            continue;
+        }
+        if (step.action == add_edge_thread) {
+            append_thread(vm, list, step.node, step.edge);
+            continue;
+        }
+        if (step.slot != NO_TAG) vm->working[step.slot] = position;
+        if (vm->node_marks[step.node] == vm->mark) continue;
+        vm->node_marks[step.node] = vm->mark;
+        if (step.node == vm->nfa->stop_node_index) append_thread(vm, list, step.node, NO_EDGE);
+
+        // Rückwärts, damit die erste Kante als erste vom Stack kommt.
+        Compact_Node *node = &vm->nfa->nodes[step.node];
+        for (size_t edge_index = node->edge_count; edge_index-- > 0;) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            if (edge->match_length > 0) {
+                stack_push(vm->closure, &(Closure_Step){.action = add_edge_thread, .node = step.node, .edge = edge_index});
+                continue;
+            }
+            if (edge->assertion != no_assertion && !assertion_holds(vm, edge->assertion, position)) continue;
+            if (edge->tag != NO_TAG) {
+                stack_push(vm->closure, &(Closure_Step){.action = restore_slot, .slot = edge->tag, .value = vm->working[edge->tag]});
+            }
+            stack_push(vm->closure, &(Closure_Step){.action = visit_node, .node = edge->endpoint, .slot = edge->tag});
+        }
+    }
+}
+
+void append_thread(Capture_VM *vm, Thread_List *list, size_t node_index, size_t edge_index) {
+    VLA_append(list->threads, &(Thread){.node = node_index, .edge = edge_index});
+    VLA_batch_append(list->slots, vm->working, vm->slot_count);
+}
+
+void step_thread(Capture_VM *vm, Thread *thread, const size_t *slots, uint8_t byte, size_t position) {
+    Compact_Edge *edge = &vm->nfa->nodes[thread->node].edges[thread->edge];
+    bool matches = edge->byte_set != NULL ? byte_set_contains(edge->byte_set, byte) : edge->matches[0] == byte;
+    if (matches) add_thread(vm, &vm->next, edge->endpoint, slots, position + 1);
+}
+
+void swap_thread_lists(Capture_VM *vm) {
+    Thread_List swap = vm->current;
+    vm->current = vm->next;
+    vm->next = swap;
+    clear_thread_list(&vm->next);
+}
+
+// Pro Schritt erreicht höchstens ein Thread den Stop-Knoten, der mit der höchsten Priorität.
+bool is_better_match(Capture_VM *vm, const size_t *slots, size_t position) {
+    if (vm->best[0] == NO_MATCH || slots[0] < vm->best[0]) return true;
+    if (slots[0] > vm->best[0]) return false;
+    // Bei leftmost-first kommen spätere Matches mit demselben Anfang nur noch von Threads mit höherer Priorität.
+    if (vm->mode == match_leftmost_first) return true;
+    return vm->mode == match_leftmost_longest && position > vm->best[1];
+}
+
+// Eine Suche nach vm->mode, die frühestens bei from anfängt. Wie bei der Pike VM mit Auswahl endet sie, sobald
+// keine Startposition mehr übrig ist, die den besten Match noch schlagen könnte.
+bool find_best_match(Capture_VM *vm, Prefilter *prefilter, size_t from) {
+    const uint8_t *data = vm->data;
+    size_t length = vm->length;
+    // Der Cursor merkt sich Positionen aus der vorigen Suche, die hinter from liegen können.
+    Prefilter_Cursor cursor;
+    initialize_prefilter_cursor(&cursor, false, SIZE_MAX);
+    vm->best[0] = NO_MATCH;
+    clear_thread_list(&vm->current);
+    clear_thread_list(&vm->next);
+    vm->mark++;
+    size_t candidate = find_next_start(vm, prefilter, &cursor, from);
+
+    for (size_t position = from; position <= length; position++) {
+        size_t thread_count = VLA_get_length(vm->current.threads);
+        if (thread_count == 0 && vm->best[0] != NO_MATCH) break;
+        // Lebt kein Thread mehr, kann direkt zur nächsten Position gesprungen werden, an der ein Match anfangen könnte.
+        if (thread_count == 0 && candidate > position) {
+            position = candidate;
+            if (position >= length) break;
+        }
+        if (position == candidate && position < length && vm->best[0] == NO_MATCH) {
+            vm->start_slots[0] = position;
+            add_thread(vm, &vm->current, vm->nfa->start_node_index, vm->start_slots, position);
+            candidate = find_next_start(vm, prefilter, &cursor, position + 1);
+        }
+
+        vm->mark++;
+        thread_count = VLA_get_length(vm->current.threads);
+        vm->steps += thread_count + 1;
+        if (limit_reached(vm)) return false;
+        for (size_t thread = 0; thread < thread_count; thread++) {
+            Thread *current = (Thread *)VLA_get(vm->current.threads, thread);
+            size_t *slots = (size_t *)VLA_get(vm->current.slots, thread * vm->slot_count);
+            if (current->edge == NO_EDGE) {
+                if (is_better_match(vm, slots, position)) {
+                    memcpy(vm->best, slots, vm->slot_count * sizeof(size_t));
+                    vm->best[1] = position;
+                }
+                // Alle folgenden Threads haben weniger Priorität als dieser Match.
+                if (vm->mode == match_leftmost_first) break;
+                continue;
+            }
+            if (vm->best[0] != NO_MATCH && (slots[0] > vm->best[0] || (vm->mode == match_shortest && slots[0] == vm->best[0]))) continue;
+            if (position < length) step_thread(vm, current, slots, data[position], position);
+        }
+        swap_thread_lists(vm);
+    }
+
+    return vm->best[0] != NO_MATCH;
+}
+
+// Bei match_all bekommt jede Startposition ihre eigenen Markierungen, damit sich Threads mit verschiedenen
+// Anfängen nicht gegenseitig verdrängen. Jeder Schritt meldet pro Startposition höchstens einen Match.
+void find_all_matches(Capture_VM *vm, Prefilter *prefilter, VLA *matches) {
+    const uint8_t *data = vm->data;
+    size_t length = vm->length;
+    Prefilter_Cursor cursor;
+    initialize_prefilter_cursor(&cursor, false, SIZE_MAX);
+    size_t candidate = find_next_start(vm, prefilter, &cursor, 0);
+    clear_thread_list(&vm->current);
+    clear_thread_list(&vm->next);
+
+    for (size_t position = 0; position <= length; position++) {
+        if (VLA_get_length(vm->current.threads) == 0 && candidate > position) {
+            position = candidate;
+            if (position >= length) break;
+        }
+        if (position == candidate && position < length) {
+            vm->mark++;
+            vm->start_slots[0] = position;
+            add_thread(vm, &vm->current, vm->nfa->start_node_index, vm->start_slots, position);
+            candidate = find_next_start(vm, prefilter, &cursor, position + 1);
+        }
+
+        size_t thread_count = VLA_get_length(vm->current.threads);
+        vm->steps += thread_count + 1;
+        if (limit_reached(vm)) return;
+        size_t previous_start = NO_MATCH;
+        for (size_t thread = 0; thread < thread_count; thread++) {
+            Thread *current = (Thread *)VLA_get(vm->current.threads, thread);
+            size_t *slots = (size_t *)VLA_get(vm->current.slots, thread * vm->slot_count);
+            if (slots[0] != previous_start) {
+                vm->mark++;
+                previous_start = slots[0];
+            }
+            if (current->edge == NO_EDGE) {
+                append_captures(vm, slots, position, matches);
+                continue;
+            }
+            if (position < length) step_thread(vm, current, slots, data[position], position);
+        }
+        swap_thread_lists(vm);
+    }
+}
+
+// Läuft ohne Automatenzustände wie die Pike VM, nur von hinten: nodes sind die Knoten, von denen aus der Rest der
+// Eingabe ab position zum Stop-Knoten führt.
+void add_reverse_closure(Capture_VM *vm, VLA *nodes, size_t node_index, size_t position) {
+    stack_push(vm->pending, &node_index);
+    while (VLA_get_length(vm->pending) > 0) {
+        size_t current = *(size_t *)stack_pop(vm->pending);
+        if (vm->node_marks[current] == vm->mark) continue;
+        vm->node_marks[current] = vm->mark;
+        VLA_append(nodes, &current);
+
+        for (size_t index = vm->reverse_offsets[current]; index < vm->reverse_offsets[current + 1]; index++) {
+            Incoming_Edge *incoming = &vm->reverse_edges[index];
+            Compact_Edge *edge = &vm->nfa->nodes[incoming->from].edges[incoming->edge];
+            if (edge->match_length > 0) continue;
+            if (edge->assertion != no_assertion && !assertion_holds(vm, edge->assertion, position)) continue;
+            stack_push(vm->pending, &incoming->from);
+        }
+    }
+}
+
+// Hängt jede Position vor dem Ende an starts an, ab der der Rest der Eingabe auf den Regex passt, von hinten nach vorne.
+// Der Lauf endet, sobald kein Knoten mehr übrig ist, liest also nur so weit zurück, wie ein Match reichen kann.
+void find_starts_backwards(Capture_VM *vm, VLA *starts) {
+    VLA_clear(vm->reverse_current);
+    vm->mark++;
+    add_reverse_closure(vm, vm->reverse_current, vm->nfa->stop_node_index, vm->length);
+
+    for (size_t position = vm->length; VLA_get_length(vm->reverse_current) > 0; position--) {
+        if (position < vm->length && vm->node_marks[vm->nfa->start_node_index] == vm->mark) VLA_append(starts, &position);
+        if (position == 0) break;
+        vm->steps += VLA_get_length(vm->reverse_current) + 1;
+        if (limit_reached(vm)) break;
+
+        vm->mark++;
+        VLA_clear(vm->reverse_next);
+        uint8_t byte = vm->data[position - 1];
+        size_t node_count = VLA_get_length(vm->reverse_current);
+        for (size_t index = 0; index < node_count; index++) {
+            size_t node_index = *(size_t *)VLA_get(vm->reverse_current, index);
+            for (size_t incoming = vm->reverse_offsets[node_index]; incoming < vm->reverse_offsets[node_index + 1]; incoming++) {
+                Incoming_Edge *edge = &vm->reverse_edges[incoming];
+                if (edge_matches_byte(&vm->nfa->nodes[edge->from].edges[edge->edge], byte)) {
+                    add_reverse_closure(vm, vm->reverse_next, edge->from, position - 1);
+                }
+            }
+        }
+
+        VLA *swap = vm->reverse_current;
+        vm->reverse_current = vm->reverse_next;
+        vm->reverse_next = swap;
+    }
+}
+
+// Kann ein Match nur am Ende der Eingabe aufhören, liefert der Lauf von hinten alle Startpositionen, ohne dass vorne
+// angefangen werden muss. Nur für die Gruppen wird noch einmal vorwärts gelesen, und zwar ab dem Anfang des Matches.
+// Außer bei match_all bleibt nur der Match mit dem kleinsten Offset, danach geht es hinter dem Ende nicht weiter.
+void find_end_anchored_matches(Capture_VM *vm, Prefilter *prefilter, VLA *matches) {
+    VLA *starts = VLA_initialize(16, sizeof(size_t));
+    find_starts_backwards(vm, starts);
+
+    for (size_t index = VLA_get_length(starts); index-- > 0 && !limit_reached(vm);) {
+        size_t start = *(size_t *)VLA_get(starts, index);
+        if (!vm->with_groups) {
+            VLA_append(matches, &(Match){.offset = start, .length = vm->length - start});
+        } else {
+            vm->only_start = start;
+            if (vm->mode == match_all) find_all_matches(vm, prefilter, matches);
+            else if (find_best_match(vm, prefilter, start)) append_captures(vm, vm->best, vm->best[1], matches);
+            vm->only_start = NO_MATCH;
+        }
+        if (vm->mode != match_all) break;
+    }
+    VLA_free(starts);
+}
+
+void append_captures(Capture_VM *vm, const size_t *slots, size_t end, VLA *matches) {
+    size_t group_count = vm->with_groups ? vm->slot_count / 2 : 1;
+    Match *appended = (Match *)VLA_reserve_next_slots(matches, group_count);
+    appended[0] = (Match){.offset = slots[0], .length = end - slots[0]};
+    for (size_t group = 1; group < group_count; group++) {
+        size_t open = slots[2 * group];
+        size_t close = slots[2 * group + 1];
+        if (open == NO_MATCH || close == NO_MATCH || close < open) {
+            appended[group] = (Match){.offset = REGEN_NO_GROUP, .length = 0};
+        } else {
+            appended[group] = (Match){.offset = open, .length = close - open};
+        }
+    }
+}
+
+int compare_capture_matches(const void *a, const void *b) {
+    const Match *first = a;
+    const Match *second = b;
+    if (first->offset != second->offset) return first->offset < second->offset ? -1 : 1;
+    if (first->length != second->length) return first->length < second->length ? -1 : 1;
+    return 0;
+}
+
+Regen_Status capture_vm_find_matches(Capture_VM *vm, Prefilter *prefilter, const uint8_t *data, size_t length, bool with_groups, VLA *matches) {
+    vm->data = data;
+    vm->length = length;
+    vm->with_groups = with_groups;
+    vm->matches = matches;
+    vm->first_new_match = VLA_get_length(matches);
+    vm->steps = 0;
+    vm->status = regen_ok;
+    size_t group_count = with_groups ? vm->slot_count / 2 : 1;
+    // Am Ende einer Zeile hört ein Match auch mitten in der Eingabe auf, dann hilft der Lauf von hinten nicht.
+    // Mit ^ vorne ist die Suche von vorne ohnehin nach wenigen Bytes vorbei.
+    if (vm->anchored_end && !vm->anchored_start && !vm->multiline) {
+        find_end_anchored_matches(vm, prefilter, matches);
+    } else if (vm->mode == match_all) {
+        find_all_matches(vm, prefilter, matches);
+        // Gefunden werden die Matches nach ihrem Ende. Ein Eintrag ist der ganze Match samt seinen Gruppen.
+        size_t found = (VLA_get_length(matches) - vm->first_new_match) / group_count;
+        if (found > 1) qsort(VLA_get(matches, vm->first_new_match), found, group_count * sizeof(Match), compare_capture_matches);
+    } else {
+        size_t from = 0;
+        while (from < length && find_best_match(vm, prefilter, from)) {
+            append_captures(vm, vm->best, vm->best[1], matches);
+            from = vm->best[1] > vm->best[0] ? vm->best[1] : vm->best[0] + 1;
+        }
+    }
+
+    // Erst bei einem Match zu viel steht fest, dass die Grenze erreicht ist.
+    if (vm->max_matches > 0) VLA_truncate(matches, vm->first_new_match + vm->max_matches * group_count);
+    return vm->status;
+}
\ No newline at end of file
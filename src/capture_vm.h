@@ -0,0 +1,28 @@
+#ifndef CAPTURE_VM_H
+#define CAPTURE_VM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "NFA.h"
+#include "prefilter.h"
+#include "matcher.h"
+#include "VLA.h"
+
+// Pike VM auf dem Automaten direkt aus dem Generator, dessen leere Kanten an den Gruppengrenzen Tags tragen.
+// Jeder Thread schreibt die Positionen mit, an denen er Tags passiert hat, und die Threads stehen wie bei einem
+// Backtracking-Matcher nach Priorität geordnet. Für jeden Match gelten die Gruppen des Pfads mit der höchsten
+// Priorität unter denen, die genau diesen Match ergeben. Anders als die Lanes der Pike VM lassen sich Threads
+// mit verschiedenen Tags nicht zusammenfassen, deshalb läuft das nur, wenn die Gruppen gebraucht werden.
+// Weil sie die ganze Eingabe vor sich hat, prüft sie auch die Bedingungen ^, $ und \b und ist damit die Engine für
+// jeden Regex, der welche enthält. Mit ^ vorne fängt sie nur am Anfang an, mit $ hinten liest sie vom Ende aus rückwärts.
+typedef struct Capture_VM Capture_VM;
+
+// Übernimmt aus options match_mode, multiline und die Grenzen pro Aufruf.
+Capture_VM *initialize_capture_vm(Compact_NFA *nfa, Regen_Options *options);
+void free_capture_vm(Capture_VM *vm);
+// Hängt für jeden Match group_count + 1 Match-Einträge an matches an: zuerst den ganzen Match, dann die Gruppen.
+// Eine Gruppe, die nicht teilgenommen hat, bekommt den Offset REGEN_NO_GROUP. Die Matches sind nach Offset und Länge sortiert.
+// Ohne with_groups ist es nur der ganze Match. Ist eine Grenze erreicht, bleiben die bis dahin gefundenen Matches.
+Regen_Status capture_vm_find_matches(Capture_VM *vm, Prefilter *prefilter, const uint8_t *data, size_t length, bool with_groups, VLA *matches);
+
+#endif
\ No newline at end of file
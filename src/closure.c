@@ -0,0 +1,70 @@
+#include <string.h>
+#include "closure.h"
+#include "stack.h"
+#include "debug.h"
+
+bool consumes_input(Compact_Node *node);
+void collect_closure(Compact_NFA *nfa, size_t node_index, size_t *visited_at, Stack *pending, VLA *members);
+
+bool consumes_input(Compact_Node *node) {
+    for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+        if (node->edges[edge_index].match_length > 0) return true;
+    }
+    return false;
+}
+
+// Tiefensuche über alle leeren Kanten. visited_at speichert, für welchen Knoten (+1) ein
+// Nachbar zuletzt besucht wurde, damit das Array nicht nach jedem Knoten geleert werden muss.
+void collect_closure(Compact_NFA *nfa, size_t node_index, size_t *visited_at, Stack *pending, VLA *members) {
+    visited_at[node_index] = node_index + 1;
+    stack_push(pending, &node_index);
+
+    while (VLA_get_length(pending) > 0) {
+        size_t current_index = *(size_t *)stack_pop(pending);
+        Compact_Node *current = &nfa->nodes[current_index];
+        if (is_stop_node(nfa, current_index) || consumes_input(current)) VLA_append(members, &current_index);
+
+        for (size_t edge_index = 0; edge_index < current->edge_count; edge_index++) {
+            Compact_Edge *edge = &current->edges[edge_index];
+            if (edge->match_length > 0 || visited_at[edge->endpoint] == node_index + 1) continue;
+            visited_at[edge->endpoint] = node_index + 1;
+            stack_push(pending, &edge->endpoint);
+        }
+    }
+}
+
+Epsilon_Closures *compute_epsilon_closures(Compact_NFA *nfa) {
+    Epsilon_Closures *closures = malloc(sizeof(Epsilon_Closures));
+    closures->node_count = nfa->node_count;
+    closures->offsets = calloc(nfa->node_count + 1, sizeof(size_t));
+    closures->accepting = calloc(nfa->node_count, sizeof(bool));
+
+    size_t *visited_at = calloc(nfa->node_count, sizeof(size_t));
+    Stack *pending = stack_initialize(nfa->node_count, sizeof(size_t));
+    VLA *members = VLA_initialize(nfa->node_count, sizeof(size_t));
+
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        closures->offsets[node_index] = VLA_get_length(members);
+        collect_closure(nfa, node_index, visited_at, pending, members);
+        closures->accepting[node_index] = visited_at[nfa->stop_node_index] == node_index + 1;
+    }
+    closures->offsets[nfa->node_count] = VLA_get_length(members);
+
+    debug("Computed epsilon closures for %lu nodes with %lu members in total.\n", nfa->node_count, VLA_get_length(members));
+    closures->members = (size_t *)VLA_extract(members);
+    VLA_free(pending);
+    free(visited_at);
+    return closures;
+}
+
+void free_epsilon_closures(Epsilon_Closures *closures) {
+    free(closures->offsets);
+    free(closures->members);
+    free(closures->accepting);
+    free(closures);
+}
+
+size_t *get_closure_members(Epsilon_Closures *closures, size_t node_index, size_t *member_count) {
+    *member_count = closures->offsets[node_index + 1] - closures->offsets[node_index];
+    return closures->members + closures->offsets[node_index];
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef CLOSURE_H
+#define CLOSURE_H
+
+#include <stdbool.h>
+#include "NFA.h"
+
+typedef struct Epsilon_Closures Epsilon_Closures;
+
+// Für jeden Knoten die Menge der Knoten, die nur über leere Kanten erreichbar sind.
+// Gespeichert werden nur Knoten, die entweder Bytes verbrauchen oder der Stop-Knoten sind,
+// alle anderen sind für die Simulation des Automaten uninteressant.
+struct Epsilon_Closures {
+    size_t *offsets;
+    size_t *members;
+    bool *accepting;
+    size_t node_count;
+};
+
+Epsilon_Closures *compute_epsilon_closures(Compact_NFA *nfa);
+void free_epsilon_closures(Epsilon_Closures *closures);
+size_t *get_closure_members(Epsilon_Closures *closures, size_t node_index, size_t *member_count);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,331 @@
+#include <string.h>
+#include "code_generator.h"
+#include "lazy_dfa.h"
+
+// Bis zu so vielen Bytes mit Übergang wird direkt auf das Byte verzweigt, darüber auf seine Byte-Klasse.
+#define MAX_BYTE_CASES 16
+#define MAX_INLINED_LITERAL 64
+
+typedef enum {
+    state_unplanned = 0,
+    // Genau ein Byte führt weiter, meist gleich mehrere hintereinander. Die werden mit einem Vergleich gelesen.
+    state_literal = 1,
+    state_byte_switch = 2,
+    state_class_switch = 3,
+    // Kein Byte führt weiter, oder beim kürzesten Match endet die Suche im ersten akzeptierenden Zustand.
+    state_final = 4,
+} State_Kind;
+
+// Welche Zustände ein Sprungziel bekommen und wie sie verzweigen. Zustände mitten in einem Literal kommen
+// nur vor, wenn sie auch anders erreicht werden, so gibt es keine unbenutzten Sprungziele.
+typedef struct {
+    Full_DFA *dfa;
+    Regen_Match_Mode mode;
+    State_Kind *kinds;
+    uint32_t *literal_targets;
+    uint32_t *order;
+    size_t planned_count;
+    bool uses_classes;
+} Matcher_Plan;
+
+uint32_t get_byte_transition(Full_DFA *dfa, uint32_t state, uint8_t byte);
+size_t count_live_bytes(Full_DFA *dfa, uint32_t state, uint8_t *last_live);
+size_t follow_literal(Full_DFA *dfa, uint32_t state, uint8_t *literal, uint32_t *target);
+void plan_state(Matcher_Plan *plan, uint32_t state);
+void plan_matcher(Matcher_Plan *plan, Full_DFA *dfa, Regen_Match_Mode mode);
+void free_matcher_plan(Matcher_Plan *plan);
+void write_byte_literal(FILE *output, uint8_t byte);
+void write_string_literal(FILE *output, const uint8_t *bytes, size_t length);
+void write_byte_table(FILE *output, const char *function_name, const char *table, const uint8_t *values);
+void write_jump(FILE *output, uint32_t state);
+void write_byte_switch(Full_DFA *dfa, uint32_t state, FILE *output);
+void write_class_switch(Full_DFA *dfa, uint32_t state, const char *function_name, FILE *output);
+void write_state(Matcher_Plan *plan, uint32_t state, const char *function_name, FILE *output);
+void write_start_skip(Full_DFA *dfa, const char *function_name, FILE *output);
+void write_match_loop_end(Regen_Match_Mode mode, FILE *output);
+
+uint32_t get_byte_transition(Full_DFA *dfa, uint32_t state, uint8_t byte) {
+    size_t index = (size_t)state * dfa->classes.class_count + dfa->classes.class_of[byte];
+    return dfa->wide ? dfa->wide_transitions[index] : dfa->narrow_transitions[index];
+}
+
+size_t count_live_bytes(Full_DFA *dfa, uint32_t state, uint8_t *last_live) {
+    size_t count = 0;
+    for (size_t byte = 0; byte < 256; byte++) {
+        if (get_byte_transition(dfa, state, byte) == DFA_DEAD_STATE) continue;
+        *last_live = byte;
+        count++;
+    }
+    return count;
+}
+
+// Liest ab state so lange Bytes, wie jeder Zustand nur ein Byte annimmt und keiner dazwischen akzeptiert.
+// Ein kürzeres Stück des Literals kann dann nie einen Match ergeben, es reicht also ein einziger Vergleich.
+size_t follow_literal(Full_DFA *dfa, uint32_t state, uint8_t *literal, uint32_t *target) {
+    size_t length = 0;
+    uint8_t byte;
+    while (length < MAX_INLINED_LITERAL && count_live_bytes(dfa, state, &byte) == 1) {
+        if (length > 0 && dfa->accepting[state]) break;
+        literal[length++] = byte;
+        state = get_byte_transition(dfa, state, byte);
+    }
+    *target = state;
+    return length;
+}
+
+void plan_state(Matcher_Plan *plan, uint32_t state) {
+    if (state == DFA_DEAD_STATE || plan->kinds[state] != state_unplanned) return;
+    Full_DFA *dfa = plan->dfa;
+    uint8_t literal[MAX_INLINED_LITERAL];
+    uint8_t byte;
+    size_t live_bytes = count_live_bytes(dfa, state, &byte);
+
+    if (live_bytes == 0 || (plan->mode == match_shortest && dfa->accepting[state])) {
+        plan->kinds[state] = state_final;
+    } else if (live_bytes == 1) {
+        plan->kinds[state] = state_literal;
+        follow_literal(dfa, state, literal, &plan->literal_targets[state]);
+    } else if (live_bytes <= MAX_BYTE_CASES) {
+        plan->kinds[state] = state_byte_switch;
+    } else {
+        plan->kinds[state] = state_class_switch;
+        plan->uses_classes = true;
+    }
+    plan->order[plan->planned_count++] = state;
+}
+
+// Besucht die Zustände in Breitensuche ab dem Startzustand, order dient dabei als Warteschlange.
+void plan_matcher(Matcher_Plan *plan, Full_DFA *dfa, Regen_Match_Mode mode) {
+    plan->dfa = dfa;
+    plan->mode = mode;
+    plan->kinds = calloc(dfa->state_count, sizeof(State_Kind));
+    plan->literal_targets = calloc(dfa->state_count, sizeof(uint32_t));
+    plan->order = malloc(dfa->state_count * sizeof(uint32_t));
+    plan->planned_count = 0;
+    plan->uses_classes = false;
+
+    plan_state(plan, dfa->start_state);
+    for (size_t planned = 0; planned < plan->planned_count; planned++) {
+        uint32_t state = plan->order[planned];
+        if (plan->kinds[state] == state_final) continue;
+        if (plan->kinds[state] == state_literal) {
+            plan_state(plan, plan->literal_targets[state]);
+            continue;
+        }
+        for (size_t byte = 0; byte < 256; byte++) plan_state(plan, get_byte_transition(dfa, state, byte));
+    }
+}
+
+void free_matcher_plan(Matcher_Plan *plan) {
+    free(plan->kinds);
+    free(plan->literal_targets);
+    free(plan->order);
+}
+
+void write_byte_literal(FILE *output, uint8_t byte) {
+    if (byte >= 'a' && byte <= 'z') fprintf(output, "'%c'", byte);
+    else if (byte >= 'A' && byte <= 'Z') fprintf(output, "'%c'", byte);
+    else if (byte >= '0' && byte <= '9') fprintf(output, "'%c'", byte);
+    else fprintf(output, "0x%02x", byte);
+}
+
+// Oktale Escapes haben höchstens drei Ziffern, ein folgendes Zeichen kann also nie dazugelesen werden.
+void write_string_literal(FILE *output, const uint8_t *bytes, size_t length) {
+    fputc('"', output);
+    for (size_t index = 0; index < length; index++) {
+        uint8_t byte = bytes[index];
+        bool plain = byte >= 0x20 && byte < 0x7f && byte != '"' && byte != '\\' && byte != '?';
+        if (plain) fputc(byte, output);
+        else fprintf(output, "\\%03o", byte);
+    }
+    fputc('"', output);
+}
+
+void write_byte_table(FILE *output, const char *function_name, const char *table, const uint8_t *values) {
+    fprintf(output, "static const uint8_t %s_%s[256] = {\n", function_name, table);
+    for (size_t byte = 0; byte < 256; byte++) {
+        fprintf(output, byte % 16 == 0 ? "    %u," : " %u,", values[byte]);
+        if (byte % 16 == 15) fputc('\n', output);
+    }
+    fprintf(output, "};\n\n");
+}
+
+void write_jump(FILE *output, uint32_t state) {
+    if (state == DFA_DEAD_STATE) fprintf(output, "goto done;");
+    else fprintf(output, "goto state_%u;", state);
+}
+
+void write_byte_switch(Full_DFA *dfa, uint32_t state, FILE *output) {
+    bool written[256] = {false};
+    fprintf(output, "        switch (data[position++]) {\n");
+    for (size_t byte = 0; byte < 256; byte++) {
+        uint32_t target = get_byte_transition(dfa, state, byte);
+        if (written[byte] || target == DFA_DEAD_STATE) continue;
+
+        fprintf(output, "        ");
+        for (size_t other = byte; other < 256; other++) {
+            if (get_byte_transition(dfa, state, other) != target) continue;
+            written[other] = true;
+            fprintf(output, "case ");
+            write_byte_literal(output, other);
+            fprintf(output, ": ");
+        }
+        write_jump(output, target);
+        fputc('\n', output);
+    }
+    fprintf(output, "        default: goto done;\n        }\n");
+}
+
+// Das Ziel der meisten Klassen wird zum default, bei [^\n]* bleibt so nur ein einziger case übrig.
+void write_class_switch(Full_DFA *dfa, uint32_t state, const char *function_name, FILE *output) {
+    size_t class_count = dfa->classes.class_count;
+    uint32_t targets[256];
+    bool written[256] = {false};
+    for (size_t class = 0; class < class_count; class++) {
+        targets[class] = get_byte_transition(dfa, state, dfa->classes.representatives[class]);
+    }
+
+    uint32_t most_common = DFA_DEAD_STATE;
+    size_t most_common_count = 0;
+    for (size_t class = 0; class < class_count; class++) {
+        size_t count = 0;
+        for (size_t other = 0; other < class_count; other++) count += targets[other] == targets[class];
+        if (count > most_common_count) {
+            most_common = targets[class];
+            most_common_count = count;
+        }
+    }
+
+    fprintf(output, "        switch (%s_classes[data[position++]]) {\n", function_name);
+    for (size_t class = 0; class < class_count; class++) {
+        if (written[class] || targets[class] == most_common) continue;
+
+        fprintf(output, "        ");
+        for (size_t other = class; other < class_count; other++) {
+            if (targets[other] != targets[class]) continue;
+            written[other] = true;
+            fprintf(output, "case %lu: ", other);
+        }
+        write_jump(output, targets[class]);
+        fputc('\n', output);
+    }
+    fprintf(output, "        default: ");
+    write_jump(output, most_common);
+    fprintf(output, "\n        }\n");
+}
+
+void write_state(Matcher_Plan *plan, uint32_t state, const char *function_name, FILE *output) {
+    Full_DFA *dfa = plan->dfa;
+    fprintf(output, "    state_%u:\n", state);
+    if (dfa->accepting[state] && plan->mode == match_all) {
+        fprintf(output, "        calls++;\n");
+        fprintf(output, "        if (on_match(start, position - start, user_data) == scan_stop) return calls;\n");
+    } else if (dfa->accepting[state]) {
+        fprintf(output, "        end = position;\n");
+    }
+
+    if (plan->kinds[state] == state_final) {
+        fprintf(output, "        goto done;\n");
+        return;
+    }
+
+    if (plan->kinds[state] == state_literal) {
+        uint8_t literal[MAX_INLINED_LITERAL];
+        uint32_t target;
+        size_t length = follow_literal(dfa, state, literal, &target);
+        if (length == 1) {
+            fprintf(output, "        if (position == length || data[position] != ");
+            write_byte_literal(output, literal[0]);
+            fprintf(output, ") goto done;\n        position++;\n        ");
+        } else {
+            fprintf(output, "        if (length - position < %lu || memcmp(data + position, ", length);
+            write_string_literal(output, literal, length);
+            fprintf(output, ", %lu) != 0) goto done;\n        position += %lu;\n        ", length, length);
+        }
+        write_jump(output, target);
+        fputc('\n', output);
+        return;
+    }
+
+    fprintf(output, "        if (position == length) goto done;\n");
+    if (plan->kinds[state] == state_byte_switch) write_byte_switch(dfa, state, output);
+    else write_class_switch(dfa, state, function_name, output);
+}
+
+// Startpositionen, an denen der Startzustand sofort stirbt, werden übersprungen. Akzeptiert er schon das leere
+// Wort, fängt an jeder Position ein Match an. Wie bei regen_exec gibt es hinter dem letzten Byte keinen leeren Match.
+void write_start_skip(Full_DFA *dfa, const char *function_name, FILE *output) {
+    if (dfa->accepting[dfa->start_state]) return;
+
+    uint8_t byte;
+    if (count_live_bytes(dfa, dfa->start_state, &byte) == 1) {
+        fprintf(output, "        const uint8_t* found = memchr(data + start, ");
+        write_byte_literal(output, byte);
+        fprintf(output, ", length - start);\n");
+        fprintf(output, "        if (found == NULL) break;\n");
+        fprintf(output, "        start = found - data;\n");
+        return;
+    }
+    fprintf(output, "        while (start < length && !%s_first_bytes[data[start]]) start++;\n", function_name);
+    fprintf(output, "        if (start == length) break;\n");
+}
+
+// Wie bei regen_exec beginnt die nächste Suche nach einem Match an seinem Ende, nach einem leeren ein Byte dahinter.
+void write_match_loop_end(Regen_Match_Mode mode, FILE *output) {
+    fprintf(output, "    done:\n");
+    if (mode == match_all) {
+        fprintf(output, "        start++;\n");
+        return;
+    }
+    fprintf(output, "        if (end == SIZE_MAX) {\n");
+    fprintf(output, "            start++;\n");
+    fprintf(output, "            continue;\n");
+    fprintf(output, "        }\n");
+    fprintf(output, "        calls++;\n");
+    fprintf(output, "        if (on_match(start, end - start, user_data) == scan_stop) return calls;\n");
+    fprintf(output, "        start = end > start ? end : start + 1;\n");
+}
+
+void write_c_matcher(Full_DFA *dfa, Regen_Match_Mode mode, const char *function_name, FILE *output) {
+    Matcher_Plan plan;
+    plan_matcher(&plan, dfa, mode);
+
+    fprintf(output, "#include <stddef.h>\n#include <stdint.h>\n#include <string.h>\n\n");
+    fprintf(output, "#ifndef MATCHER_H\n");
+    fprintf(output, "typedef enum {\n    scan_continue = 0,\n    scan_stop = 1,\n} Regen_Scan_Action;\n\n");
+    fprintf(output, "typedef Regen_Scan_Action (*Regen_Match_Callback)(size_t offset, size_t length, void* user_data);\n");
+    fprintf(output, "#endif\n\n");
+
+    if (plan.uses_classes) write_byte_table(output, function_name, "classes", dfa->classes.class_of);
+    uint8_t single_first_byte;
+    if (!dfa->accepting[dfa->start_state] && count_live_bytes(dfa, dfa->start_state, &single_first_byte) != 1) {
+        uint8_t first_bytes[256];
+        for (size_t byte = 0; byte < 256; byte++) {
+            first_bytes[byte] = get_byte_transition(dfa, dfa->start_state, byte) != DFA_DEAD_STATE;
+        }
+        write_byte_table(output, function_name, "first_bytes", first_bytes);
+    }
+
+    fprintf(output, "// Ruft on_match für jeden Match in der Reihenfolge von regen_exec auf, bis es scan_stop zurückgibt.\n");
+    fprintf(output, "// Gibt zurück, wie oft on_match aufgerufen wurde.\n");
+    fprintf(output, "size_t %s(const uint8_t* data, size_t length, Regen_Match_Callback on_match, void* user_data) {\n",
+            function_name);
+    // Akzeptiert schon der Start und gibt es keinen Übergang, wird data nie gelesen.
+    fprintf(output, "    (void)data;\n");
+    fprintf(output, "    size_t calls = 0;\n");
+    fprintf(output, "    for (size_t start = 0; start < length;) {\n");
+    write_start_skip(dfa, function_name, output);
+    fprintf(output, "        size_t position = start;\n");
+    if (mode != match_all) fprintf(output, "        size_t end = SIZE_MAX;\n");
+    fprintf(output, "        ");
+    write_jump(output, dfa->start_state);
+    fprintf(output, "\n\n");
+
+    for (size_t planned = 0; planned < plan.planned_count; planned++) {
+        write_state(&plan, plan.order[planned], function_name, output);
+    }
+    write_match_loop_end(mode, output);
+    fprintf(output, "    }\n    return calls;\n}\n");
+
+    free_matcher_plan(&plan);
+}
\ No newline at end of file
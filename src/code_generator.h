@@ -0,0 +1,13 @@
+#ifndef CODE_GENERATOR_H
+#define CODE_GENERATOR_H
+
+#include <stdio.h>
+#include "full_dfa.h"
+#include "matcher.h"
+
+// Schreibt eine C-Funktion function_name mit der Signatur von regen_exec_callback ohne den Compiled_Regex nach
+// output. Jeder Zustand des DFA wird ein Sprungziel, Literale werden mit memcmp verglichen, der Heap wird nie benutzt.
+// Jede Startposition wird einzeln probiert, deshalb geht das nur für Modi, die der DFA allein entscheiden kann.
+void write_c_matcher(Full_DFA *dfa, Regen_Match_Mode mode, const char *function_name, FILE *output);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include <string.h>
+#include "full_dfa.h"
+#include "lazy_dfa.h"
+#include "lanes.h"
+#include "matcher.h"
+#include "stack.h"
+#include "debug.h"
+
+// Partitionierung der Zustände für den Algorithmus von Hopcroft. Die Zustände eines Blocks liegen
+// zusammenhängend in elements, markierte Zustände werden an den Anfang ihres Blocks getauscht.
+typedef struct {
+    size_t *elements;
+    size_t *location;
+    size_t *block_of;
+    size_t *block_first;
+    size_t *block_end;
+    size_t *marked;
+    bool *pending;
+    size_t block_count;
+} Partition;
+
+typedef struct {
+    uint32_t state;
+    size_t starts_head;
+    size_t starts_tail;
+} Full_Lane;
+
+struct Full_DFA_Scan {
+    Full_DFA *dfa;
+    Full_Lane *current;
+    Full_Lane *building;
+    size_t building_count;
+    size_t *lane_of_state;
+    size_t *lane_generation;
+    size_t generation;
+    Start_Links starts;
+};
+
+Lazy_DFA *explore_all_states(Compact_NFA *nfa, Epsilon_Closures *closures, size_t state_limit);
+size_t *build_inverse_transitions(Lazy_DFA *subsets, size_t **inverse_offsets);
+void initialize_partition(Partition *partition, Lazy_DFA *subsets, VLA *worklist);
+void free_partition(Partition *partition);
+void mark_state(Partition *partition, size_t state, VLA *touched);
+void split_touched_blocks(Partition *partition, VLA *touched, VLA *worklist);
+void refine_partition(Partition *partition, Lazy_DFA *subsets);
+Full_DFA *create_minimized_dfa(Partition *partition, Lazy_DFA *subsets);
+static inline uint32_t get_full_transition(Full_DFA *dfa, uint32_t state, size_t byte_class, bool wide);
+static inline void feed_full_dfa(Full_DFA_Scan *scan, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset,
+                                 bool final_chunk, size_t start_limit, VLA *matches, bool wide);
+
+// Teilmengenkonstruktion: die Lazy-DFA ohne Speicherlimit so lange erweitern, bis alle Übergänge bekannt sind.
+// Pro Byte-Klasse reicht ein Byte, danach ist jede Spalte der Tabelle gefüllt.
+Lazy_DFA *explore_all_states(Compact_NFA *nfa, Epsilon_Closures *closures, size_t state_limit) {
+    Lazy_DFA *subsets = initialize_lazy_dfa(nfa, closures, SIZE_MAX);
+    for (uint32_t state = 0; state < subsets->state_count; state++) {
+        for (size_t byte_class = 0; byte_class < subsets->classes.class_count; byte_class++) {
+            lazy_dfa_next_state(subsets, state, subsets->classes.representatives[byte_class]);
+        }
+
+        if (subsets->state_count > state_limit) {
+            debug("The DFA for this regex needs more than %zu states.\n", state_limit);
+            free_lazy_dfa(subsets);
+            return NULL;
+        }
+    }
+
+    return subsets;
+}
+
+// Für jede Byte-Klasse c liegen die Vorgänger von t unter c in sources[offsets[c * (n + 1) + t] ...].
+size_t *build_inverse_transitions(Lazy_DFA *subsets, size_t **inverse_offsets) {
+    size_t state_count = subsets->state_count;
+    size_t class_count = subsets->classes.class_count;
+    size_t *offsets = calloc(class_count * (state_count + 1), sizeof(size_t));
+    size_t *sources = malloc(class_count * state_count * sizeof(size_t));
+
+    for (size_t state = 0; state < state_count; state++) {
+        for (size_t byte_class = 0; byte_class < class_count; byte_class++) {
+            offsets[byte_class * (state_count + 1) + subsets->transitions[state * class_count + byte_class] + 1]++;
+        }
+    }
+
+    size_t running = 0;
+    for (size_t byte_class = 0; byte_class < class_count; byte_class++) {
+        size_t *row = offsets + byte_class * (state_count + 1);
+        row[0] = running;
+        for (size_t target = 1; target <= state_count; target++) {
+            running += row[target];
+            row[target] = running;
+        }
+    }
+
+    size_t *filled = calloc(class_count * state_count, sizeof(size_t));
+    for (size_t state = 0; state < state_count; state++) {
+        for (size_t byte_class = 0; byte_class < class_count; byte_class++) {
+            size_t target = subsets->transitions[state * class_count + byte_class];
+            size_t slot = byte_class * state_count + target;
+            sources[offsets[byte_class * (state_count + 1) + target] + filled[slot]++] = state;
+        }
+    }
+    free(filled);
+
+    *inverse_offsets = offsets;
+    return sources;
+}
+
+void initialize_partition(Partition *partition, Lazy_DFA *subsets, VLA *worklist) {
+    size_t state_count = subsets->state_count;
+    partition->elements = malloc(state_count * sizeof(size_t));
+    partition->location = malloc(state_count * sizeof(size_t));
+    partition->block_of = malloc(state_count * sizeof(size_t));
+    partition->block_first = malloc(state_count * sizeof(size_t));
+    partition->block_end = malloc(state_count * sizeof(size_t));
+    partition->marked = calloc(state_count, sizeof(size_t));
+    partition->pending = calloc(state_count, sizeof(bool));
+    partition->block_count = 0;
+
+    // Anfangs gibt es nur zwei Blöcke: akzeptierende und nicht akzeptierende Zustände.
+    size_t filled = 0;
+    for (size_t pass = 0; pass < 2; pass++) {
+        bool accepting = pass == 1;
+        size_t first = filled;
+        for (size_t state = 0; state < state_count; state++) {
+            if (subsets->accepting[state] != accepting) continue;
+            partition->elements[filled] = state;
+            partition->location[state] = filled;
+            partition->block_of[state] = partition->block_count;
+            filled++;
+        }
+        if (filled == first) continue;
+
+        partition->block_first[partition->block_count] = first;
+        partition->block_end[partition->block_count] = filled;
+        partition->pending[partition->block_count] = true;
+        VLA_append(worklist, &partition->block_count);
+        partition->block_count++;
+    }
+}
+
+void free_partition(Partition *partition) {
+    free(partition->elements);
+    free(partition->location);
+    free(partition->block_of);
+    free(partition->block_first);
+    free(partition->block_end);
+    free(partition->marked);
+    free(partition->pending);
+}
+
+void mark_state(Partition *partition, size_t state, VLA *touched) {
+    size_t block = partition->block_of[state];
+    size_t boundary = partition->block_first[block] + partition->marked[block];
+    if (partition->location[state] < boundary) return;
+
+    size_t displaced = partition->elements[boundary];
+    partition->elements[partition->location[state]] = displaced;
+    partition->location[displaced] = partition->location[state];
+    partition->elements[boundary] = state;
+    partition->location[state] = boundary;
+
+    if (partition->marked[block]++ == 0) VLA_append(touched, &block);
+}
+
+void split_touched_blocks(Partition *partition, VLA *touched, VLA *worklist) {
+    for (size_t index = 0; index < VLA_get_length(touched); index++) {
+        size_t block = *(size_t *)VLA_get(touched, index);
+        size_t first = partition->block_first[block];
+        size_t marked = partition->marked[block];
+        partition->marked[block] = 0;
+        if (marked == partition->block_end[block] - first) continue;
+
+        size_t split = partition->block_count++;
+        partition->block_first[split] = first;
+        partition->block_end[split] = first + marked;
+        partition->block_first[block] = first + marked;
+        for (size_t element = first; element < first + marked; element++) {
+            partition->block_of[partition->elements[element]] = split;
+        }
+
+        // Hopcroft: liegt der alte Block schon in der Worklist, müssen beide Hälften hinein,
+        // ansonsten reicht die kleinere.
+        size_t added = split;
+        if (!partition->pending[block] && marked > partition->block_end[block] - partition->block_first[block]) {
+            added = block;
+        }
+        partition->pending[added] = true;
+        VLA_append(worklist, &added);
+    }
+    VLA_clear(touched);
+}
+
+void refine_partition(Partition *partition, Lazy_DFA *subsets) {
+    size_t *inverse_offsets;
+    size_t *inverse_sources = build_inverse_transitions(subsets, &inverse_offsets);
+    size_t state_count = subsets->state_count;
+    VLA *worklist = VLA_initialize(8, sizeof(size_t));
+    VLA *touched = VLA_initialize(8, sizeof(size_t));
+    VLA *splitter = VLA_initialize(8, sizeof(size_t));
+
+    initialize_partition(partition, subsets, worklist);
+    while (VLA_get_length(worklist) > 0) {
+        size_t block = *(size_t *)stack_pop(worklist);
+        partition->pending[block] = false;
+        VLA_clear(splitter);
+        VLA_batch_append(splitter, partition->elements + partition->block_first[block],
+                         partition->block_end[block] - partition->block_first[block]);
+
+        for (size_t byte_class = 0; byte_class < subsets->classes.class_count; byte_class++) {
+            size_t *offsets = inverse_offsets + byte_class * (state_count + 1);
+            for (size_t index = 0; index < VLA_get_length(splitter); index++) {
+                size_t target = ((size_t *)splitter->data)[index];
+                for (size_t source = offsets[target]; source < offsets[target + 1]; source++) {
+                    mark_state(partition, inverse_sources[source], touched);
+                }
+            }
+            split_touched_blocks(partition, touched, worklist);
+        }
+    }
+
+    VLA_free(worklist);
+    VLA_free(touched);
+    VLA_free(splitter);
+    free(inverse_offsets);
+    free(inverse_sources);
+}
+
+Full_DFA *create_minimized_dfa(Partition *partition, Lazy_DFA *subsets) {
+    Full_DFA *dfa = malloc(sizeof(Full_DFA));
+    dfa->classes = subsets->classes;
+    size_t class_count = dfa->classes.class_count;
+    dfa->state_count = partition->block_count;
+    dfa->wide = dfa->state_count > UINT16_MAX;
+    dfa->narrow_transitions = NULL;
+    dfa->wide_transitions = NULL;
+    if (dfa->wide) {
+        dfa->wide_transitions = malloc(dfa->state_count * class_count * sizeof(uint32_t));
+    } else {
+        dfa->narrow_transitions = malloc(dfa->state_count * class_count * sizeof(uint16_t));
+    }
+    dfa->accepting = malloc(dfa->state_count * sizeof(bool));
+
+    // Der Block mit dem toten Zustand bekommt die 0, alle anderen werden der Reihe nach durchnummeriert.
+    size_t dead_block = partition->block_of[DFA_DEAD_STATE];
+    uint32_t *renamed = malloc(partition->block_count * sizeof(uint32_t));
+    uint32_t next_name = 1;
+    for (size_t block = 0; block < partition->block_count; block++) {
+        renamed[block] = block == dead_block ? DFA_DEAD_STATE : next_name++;
+    }
+
+    for (size_t block = 0; block < partition->block_count; block++) {
+        size_t representative = partition->elements[partition->block_first[block]];
+        uint32_t state = renamed[block];
+        dfa->accepting[state] = subsets->accepting[representative];
+        for (size_t byte_class = 0; byte_class < class_count; byte_class++) {
+            uint32_t target = renamed[partition->block_of[subsets->transitions[representative * class_count + byte_class]]];
+            if (dfa->wide) {
+                dfa->wide_transitions[(size_t)state * class_count + byte_class] = target;
+            } else {
+                dfa->narrow_transitions[(size_t)state * class_count + byte_class] = target;
+            }
+        }
+    }
+    dfa->start_state = renamed[partition->block_of[subsets->start_state]];
+
+    free(renamed);
+    return dfa;
+}
+
+Full_DFA *build_full_dfa(Compact_NFA *nfa, Epsilon_Closures *closures, size_t state_limit) {
+    Lazy_DFA *subsets = explore_all_states(nfa, closures, state_limit);
+    if (subsets == NULL) return NULL;
+
+    Partition partition;
+    refine_partition(&partition, subsets);
+    Full_DFA *dfa = create_minimized_dfa(&partition, subsets);
+    debug("Minimized DFA from %lu to %lu states.\n", subsets->state_count, dfa->state_count);
+
+    free_partition(&partition);
+    free_lazy_dfa(subsets);
+    return dfa;
+}
+
+void free_full_dfa(Full_DFA *dfa) {
+    free(dfa->narrow_transitions);
+    free(dfa->wide_transitions);
+    free(dfa->accepting);
+    free(dfa);
+}
+
+static inline uint32_t get_full_transition(Full_DFA *dfa, uint32_t state, size_t byte_class, bool wide) {
+    size_t index = (size_t)state * dfa->classes.class_count + byte_class;
+    return wide ? dfa->wide_transitions[index] : dfa->narrow_transitions[index];
+}
+
+// Wie bei der Lazy-DFA teilen sich alle Startpositionen im selben Zustand eine Lane. Da die Tabelle
+// vollständig ist, gibt es hier weder unbekannte Übergänge noch einen Cache, der voll laufen kann.
+// wide ist bei beiden Aufrufen konstant, der Compiler kann die Schleife also für jede Breite spezialisieren.
+static inline void feed_full_dfa(Full_DFA_Scan *scan, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset,
+                                 bool final_chunk, size_t start_limit, VLA *matches, bool wide) {
+    Full_DFA *dfa = scan->dfa;
+    Prefilter_Cursor cursor;
+    initialize_prefilter_cursor(&cursor, !final_chunk, start_limit);
+    size_t candidate = find_next_candidate(prefilter, &cursor, data, length, 0);
+
+    for (size_t position = 0; position < length; position++) {
+        if (scan->building_count == 0 && selection_settled(&scan->starts, 0)) break;
+        if (scan->building_count == 0 && candidate > position) {
+            position = candidate;
+            if (position == length) break;
+        }
+        if (position == candidate && !has_candidate(&scan->starts)) {
+            candidate = find_next_candidate(prefilter, &cursor, data, length, position + 1);
+            if (dfa->accepting[dfa->start_state]) report_match(&scan->starts, offset + position, offset + position, matches);
+            // Die Startposition bekommt nur dann eine Lane, wenn sie das nächste Byte überlebt.
+            if (get_full_transition(dfa, dfa->start_state, dfa->classes.class_of[data[position]], wide) != DFA_DEAD_STATE) {
+                size_t link = allocate_start_link(&scan->starts, offset + position);
+                if (drop_outdone_lane(&scan->starts, link, link)) {
+                    // Beim kürzesten Match ist nach einem leeren Match an dieser Position schon alles entschieden.
+                } else if (scan->lane_generation[dfa->start_state] == scan->generation) {
+                    Full_Lane *equal = &scan->building[scan->lane_of_state[dfa->start_state]];
+                    merge_start_links(&scan->starts, &equal->starts_head, &equal->starts_tail, link, link);
+                } else {
+                    scan->building[scan->building_count] = (Full_Lane){dfa->start_state, link, link};
+                    scan->lane_of_state[dfa->start_state] = scan->building_count++;
+                    scan->lane_generation[dfa->start_state] = scan->generation;
+                }
+            }
+        }
+
+        Full_Lane *current = scan->building;
+        size_t current_count = scan->building_count;
+        scan->building = scan->current;
+        scan->current = current;
+        scan->building_count = 0;
+        scan->generation++;
+
+        size_t byte_class = dfa->classes.class_of[data[position]];
+        for (size_t lane_index = 0; lane_index < current_count; lane_index++) {
+            Full_Lane *lane = &current[lane_index];
+            uint32_t next = get_full_transition(dfa, lane->state, byte_class, wide);
+            if (next == DFA_DEAD_STATE) {
+                release_start_links(&scan->starts, lane->starts_head, lane->starts_tail);
+                continue;
+            }
+
+            if (dfa->accepting[next]) report_start_links(&scan->starts, lane->starts_head, offset + position + 1, matches);
+            if (drop_outdone_lane(&scan->starts, lane->starts_head, lane->starts_tail)) continue;
+            if (scan->lane_generation[next] == scan->generation) {
+                Full_Lane *equal = &scan->building[scan->lane_of_state[next]];
+                merge_start_links(&scan->starts, &equal->starts_head, &equal->starts_tail, lane->starts_head, lane->starts_tail);
+                continue;
+            }
+
+            scan->building[scan->building_count] = (Full_Lane){next, lane->starts_head, lane->starts_tail};
+            scan->lane_of_state[next] = scan->building_count++;
+            scan->lane_generation[next] = scan->generation;
+        }
+    }
+
+    // Nach dem letzten Stück kann keine Lane mehr matchen, der Durchlauf ist danach frei für eine neue Suche.
+    if (final_chunk) {
+        for (size_t lane_index = 0; lane_index < scan->building_count; lane_index++) {
+            release_start_links(&scan->starts, scan->building[lane_index].starts_head, scan->building[lane_index].starts_tail);
+        }
+        scan->building_count = 0;
+        scan->generation++;
+    }
+    selection_settled(&scan->starts, scan->building_count);
+}
+
+Full_DFA_Scan *initialize_full_dfa_scan(Full_DFA *dfa) {
+    Full_DFA_Scan *scan = calloc(1, sizeof(Full_DFA_Scan));
+    scan->dfa = dfa;
+    scan->current = malloc(dfa->state_count * sizeof(Full_Lane));
+    scan->building = malloc(dfa->state_count * sizeof(Full_Lane));
+    scan->lane_of_state = malloc(dfa->state_count * sizeof(size_t));
+    scan->lane_generation = calloc(dfa->state_count, sizeof(size_t));
+    scan->generation = 1;
+    initialize_start_links(&scan->starts);
+    return scan;
+}
+
+size_t full_dfa_scan_memory(Full_DFA_Scan *scan) {
+    size_t per_state = 2 * sizeof(Full_Lane) + 2 * sizeof(size_t);
+    return scan->dfa->state_count * per_state + start_links_memory(&scan->starts);
+}
+
+void full_dfa_scan_select_matches(Full_DFA_Scan *scan, Match_Selection *selection) {
+    scan->starts.selection = selection;
+}
+
+void free_full_dfa_scan(Full_DFA_Scan *scan) {
+    free(scan->current);
+    free(scan->building);
+    free(scan->lane_of_state);
+    free(scan->lane_generation);
+    free_start_links(&scan->starts);
+    free(scan);
+}
+
+void full_dfa_feed(Full_DFA_Scan *scan, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset, bool final_chunk,
+                   size_t start_limit, VLA *matches) {
+    if (scan->dfa->wide) {
+        feed_full_dfa(scan, prefilter, data, length, offset, final_chunk, start_limit, matches, true);
+    } else {
+        feed_full_dfa(scan, prefilter, data, length, offset, final_chunk, start_limit, matches, false);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef FULL_DFA_H
+#define FULL_DFA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "NFA.h"
+#include "closure.h"
+#include "byte_classes.h"
+#include "prefilter.h"
+#include "lanes.h"
+#include "VLA.h"
+
+typedef struct Full_DFA Full_DFA;
+typedef struct Full_DFA_Scan Full_DFA_Scan;
+
+// Vollständig determinisierter und minimierter Automat. Zustand 0 ist immer der tote Zustand.
+// Solange es höchstens UINT16_MAX Zustände gibt, ist die Übergangstabelle nur 16 Bit breit.
+// Wie bei der Lazy-DFA hat sie eine Spalte pro Byte-Klasse.
+struct Full_DFA {
+    Byte_Classes classes;
+    size_t state_count;
+    uint32_t start_state;
+    bool wide;
+    uint16_t *narrow_transitions;
+    uint32_t *wide_transitions;
+    bool *accepting;
+};
+
+// Gibt NULL zurück, falls der Automat mehr als state_limit Zustände bräuchte.
+Full_DFA *build_full_dfa(Compact_NFA *nfa, Epsilon_Closures *closures, size_t state_limit);
+void free_full_dfa(Full_DFA *dfa);
+Full_DFA_Scan *initialize_full_dfa_scan(Full_DFA *dfa);
+void free_full_dfa_scan(Full_DFA_Scan *scan);
+// Wie dfa_scan_select_matches.
+void full_dfa_scan_select_matches(Full_DFA_Scan *scan, Match_Selection *selection);
+// Speicher für Lanes und Startpositionen in Bytes, ohne die Übergangstabelle.
+size_t full_dfa_scan_memory(Full_DFA_Scan *scan);
+// Wie pike_vm_feed.
+void full_dfa_feed(Full_DFA_Scan *scan, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset, bool final_chunk,
+                   size_t start_limit, VLA *matches);
+
+#endif
\ No newline at end of file
@@ -8,16 +8,29 @@ typedef struct Generator {
     Stack *block_start_nodes;
     Stack *block_stop_nodes;
     Stack *block_start_offsets;
-    size_t *global_node_index;
+    // Die Nummer der Gruppe, zu der jede offene Ebene gehört, 0 für die äußerste.
+    Stack *block_groups;
     NFA *generated;
+    size_t node_limit;
+    bool too_large;
 } Generator;
 
 size_t VLA_binding_get_size_t(VLA *v, signed long index);
+size_t get_close_tag(Generator *generator);
 void size_t_formatter(VLA *output, void *item);
-Generator *initialize_generator();
+Generator *initialize_generator(size_t node_limit);
 void free_generator(Generator *state);
 void increment_current_block_offset(VLA *offsets);
-void advance_current_path(Generator *state, char *match);
+void advance_current_path(Generator *state, char *match, size_t match_length, const Byte_Set *byte_set);
+void advance_current_path_by_codepoint(Generator *generator, char *bytes, size_t length);
+void add_assertion(Generator *generator, Assertion assertion);
+size_t add_value_range(Generator *generator, ParserState *parsed, size_t range_start);
+size_t get_token_length(ParserState *parsed, size_t index);
+unsigned long read_unsigned_long_token(ParserState *parsed, size_t index);
+Node *append_atom_copy(Generator *generator, Node **atom_nodes, size_t *edge_counts, size_t atom_size, size_t *local_index, Node *from);
+size_t add_repetition_range(Generator *generator, ParserState *parsed, size_t range_start);
+bool followed_by_loop(ParserState *parsed, size_t index);
+size_t find_block_close(ParserState *parsed, size_t block_open_index);
 void backtrack_to_path_start(Generator *state);
 void loop_current_path_bidirectional(Generator *state, size_t anchor_offset);
 void loop_current_path_forward(Generator *state, size_t anchor_offset);
@@ -25,30 +38,33 @@ void loop_current_path_backward(Generator *state, size_t anchor_offset);
 void open_new_block_level(Generator *state);
 void close_current_block_level(Generator *state);
 
-Generator *initialize_generator() {
+Generator *initialize_generator(size_t node_limit) {
     Generator *new = malloc(sizeof(Generator));
     new->block_start_nodes = stack_initialize(2, sizeof(Node *));
     new->block_stop_nodes = stack_initialize(2, sizeof(Node *));
     new->block_start_offsets = stack_initialize(2, sizeof(size_t));
-    new->global_node_index = calloc(1, sizeof(size_t));
+    new->block_groups = stack_initialize(2, sizeof(size_t));
     new->generated = initialize_nfa();
-    new->generated->start = create_node(new->global_node_index);
-    new->generated->stop = create_node(new->global_node_index);
+    new->generated->start = create_node(new->generated);
+    new->generated->stop = create_node(new->generated);
+    new->node_limit = node_limit;
+    new->too_large = false;
 
     stack_push(new->block_start_nodes, &(new->generated->start));
     stack_push(new->block_stop_nodes, &(new->generated->stop));
     // Einen zusätzlich, damit es beim letzten Aufruf von close_current_block_level() keinen Segfault gibt
     stack_push(new->block_start_offsets, &(size_t){0});
     stack_push(new->block_start_offsets, &(size_t){0});
+    stack_push(new->block_groups, &(size_t){0});
 
     return new;
 }
 
 void free_generator(Generator *generator) {
     VLA_free(generator->block_start_offsets);
+    VLA_free(generator->block_groups);
     VLA_free(generator->block_start_nodes);
     VLA_free(generator->block_stop_nodes);
-    free(generator->global_node_index);
     free(generator);
 }
 
@@ -57,6 +73,12 @@ size_t VLA_binding_get_size_t(VLA *v, signed long index) {
     return *(size_t *)VLA_get(v, index);
 }
 
+// Der Slot, in den ein Pfad beim Verlassen der aktuellen Ebene seine Position schreibt, bzw. NO_TAG auf der äußersten.
+size_t get_close_tag(Generator *generator) {
+    size_t group = VLA_binding_get_size_t(generator->block_groups, -1);
+    return group == 0 ? NO_TAG : 2 * group + 1;
+}
+
 void size_t_formatter(VLA *output, void *item) {
     size_t casted = *(size_t *)item;
     const int n = snprintf(NULL, 0, "%zu", casted);
@@ -73,10 +95,12 @@ void increment_current_block_offset(VLA *offsets) {
 
 void open_new_block_level(Generator *generator) {
     Node *last_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
-    Node *start = create_node(generator->global_node_index);
-    Node *stop = create_node(generator->global_node_index);
+    Node *start = create_node(generator->generated);
+    Node *stop = create_node(generator->generated);
+    size_t group = ++generator->generated->group_count;
 
-    add_empty_edge_between(last_start, start);
+    add_tagged_edge_between(generator->generated, last_start, start, 2 * group);
+    stack_push(generator->block_groups, &group);
     stack_push(generator->block_start_nodes, &start);
     stack_push(generator->block_stop_nodes, &stop);
     increment_current_block_offset(generator->block_start_offsets);
@@ -90,32 +114,55 @@ void close_current_block_level(Generator *generator) {
     size_t offset = VLA_binding_get_size_t(generator->block_start_offsets, -1);
     stack_pop_n(generator->block_start_offsets, 1);
 
-    add_empty_edge_between(last_start, block_stop);
-    stack_pop_n(generator->block_start_nodes, offset);
+    add_tagged_edge_between(generator->generated, last_start, block_stop, get_close_tag(generator));
+    stack_pop_n(generator->block_groups, 1);
+    // Der Startknoten der Gruppe wird durch ihren Stop-Knoten ersetzt. Schleifen hängen sich so an den Knoten
+    // vor der Gruppe und laufen bei jeder Wiederholung wieder über die Kante, die den Anfang der Gruppe markiert.
+    stack_pop_n(generator->block_start_nodes, offset + 1);
     stack_pop_n(generator->block_stop_nodes, 1);
     stack_push(generator->block_start_nodes, &block_stop);
-    increment_current_block_offset(generator->block_start_offsets);
 }
 
 void insert_proxy_start(Generator *generator) {
-    char *empty = calloc(1, sizeof(char));
-    advance_current_path(generator, empty);
+    advance_current_path(generator, NULL, 0, NULL);
+}
+
+void advance_current_path(Generator *generator, char *match, size_t match_length, const Byte_Set *byte_set) {
+    Node *last_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
+    Node *new = create_node(generator->generated);
+    add_edge_between(generator->generated, last_start, new, match, match_length, byte_set);
+    stack_push(generator->block_start_nodes, &new);
+    increment_current_block_offset(generator->block_start_offsets);
 }
 
-void advance_current_path(Generator *generator, char *match) {
+// Die Engines lesen pro Kante ein Byte, ein Codepoint aus mehreren Bytes wird deshalb eine Kette von Kanten. Auf den
+// Stapel kommt nur ihr Ende, Modifikatoren und Wiederholungsbereiche beziehen sich also auf den ganzen Codepoint.
+void advance_current_path_by_codepoint(Generator *generator, char *bytes, size_t length) {
     Node *last_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
-    Node *new = create_node(generator->global_node_index);
-    add_edge_between(last_start, new, match);
+    for (size_t index = 0; index + 1 < length; index++) {
+        Node *next = create_node(generator->generated);
+        add_edge_between(generator->generated, last_start, next, bytes + index, 1, NULL);
+        last_start = next;
+    }
+    Node *new = create_node(generator->generated);
+    add_edge_between(generator->generated, last_start, new, bytes + length - 1, 1, NULL);
     stack_push(generator->block_start_nodes, &new);
     increment_current_block_offset(generator->block_start_offsets);
 }
 
+// Wie ein Zeichen, nur dass die Kante nichts verbraucht.
+void add_assertion(Generator *generator, Assertion assertion) {
+    Node *last_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
+    advance_current_path(generator, NULL, 0, NULL);
+    last_start->last_edge->assertion = assertion;
+}
+
 void backtrack_to_path_start(Generator *generator) {
     size_t offset = VLA_binding_get_size_t(generator->block_start_offsets, -1);
     Node *last_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
     Node *path_stop = VLA_binding_get_node_pointer(generator->block_stop_nodes, -1);
 
-    add_empty_edge_between(last_start, path_stop);
+    add_tagged_edge_between(generator->generated, last_start, path_stop, get_close_tag(generator));
     stack_pop_n(generator->block_start_nodes, offset);
     stack_pop_n(generator->block_start_offsets, 1);
     stack_push(generator->block_start_offsets, &(size_t){0});
@@ -125,42 +172,192 @@ void loop_current_path_bidirectional(Generator *generator, size_t anchor_offset)
     Node *loop_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -anchor_offset);
     Node *loop_stop = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
 
-    add_empty_edge_between(loop_start, loop_stop);
-    add_empty_edge_between(loop_stop, loop_start);
+    add_empty_edge_between(generator->generated, loop_start, loop_stop);
+    add_empty_edge_between(generator->generated, loop_stop, loop_start);
 }
 
 void loop_current_path_forward(Generator *generator, size_t anchor_offset) {
     Node *loop_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -anchor_offset);
     Node *loop_stop = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
 
-    add_empty_edge_between(loop_start, loop_stop);
+    add_empty_edge_between(generator->generated, loop_start, loop_stop);
 }
 
 void loop_current_path_backward(Generator *generator, size_t anchor_offset) {
     Node *loop_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -anchor_offset);
     Node *loop_stop = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
 
-    add_empty_edge_between(loop_stop, loop_start);
+    add_empty_edge_between(generator->generated, loop_stop, loop_start);
+}
+
+// [a, z] wird zu einer einzigen Kante mit allen Bytes von a bis z. Gibt den Index des schließenden Tokens zurück.
+size_t add_value_range(Generator *generator, ParserState *parsed, size_t range_start) {
+    size_t range_stop = range_start + 4;
+    uint8_t low = parsed->regex[parsed->token_offsets[range_start + 1]];
+    uint8_t high = parsed->regex[parsed->token_offsets[range_start + 3]];
+    if (followed_by_loop(parsed, range_stop)) insert_proxy_start(generator);
+
+    Byte_Set range = {0};
+    for (size_t byte = low; byte <= high; byte++) byte_set_add(&range, byte);
+    advance_current_path(generator, NULL, 1, &range);
+    return range_stop;
 }
 
-NFA *generate_nfa_from_parsed_regex(ParserState *parsed) {
-    Generator *generator = initialize_generator();
+// Schleifen und Wiederholungen brauchen einen eigenen Startknoten vor dem Atom, an dem sonst nichts hängt.
+bool followed_by_loop(ParserState *parsed, size_t index) {
+    if (index + 1 >= parsed->number_of_tokens) return false;
+    Token next = parsed->tokens[index + 1];
+    return next == mod_any || next == mod_multiple || next == repetition_range_start;
+}
+
+// Gibt den Index der Klammer zurück, die die Gruppe bei block_open_index schließt.
+size_t find_block_close(ParserState *parsed, size_t block_open_index) {
+    size_t depth = 0;
+    for (size_t index = block_open_index; index < parsed->number_of_tokens; index++) {
+        if (parsed->tokens[index] == block_open) depth++;
+        if (parsed->tokens[index] == block_close && --depth == 0) return index;
+    }
+    return parsed->number_of_tokens;
+}
+
+size_t get_token_length(ParserState *parsed, size_t index) {
+    size_t next_offset = index + 1 < parsed->number_of_tokens ? parsed->token_offsets[index + 1] : parsed->regex_length;
+    return next_offset - parsed->token_offsets[index];
+}
+
+// Die Zahl steht roh im Regex und muss nicht ausgerichtet sein.
+unsigned long read_unsigned_long_token(ParserState *parsed, size_t index) {
+    unsigned long value;
+    memcpy(&value, parsed->regex + parsed->token_offsets[index], sizeof(unsigned long));
+    return value;
+}
 
-    for (size_t index = 0; index < strlen(parsed->regex); index++) {
+// Kopiert das Atom und verbindet from mit einer leeren Kante mit dem Anfang der Kopie. Gibt das Ende der Kopie zurück.
+// atom_nodes[0] ist der Anfang und atom_nodes[atom_size - 1] das Ende des Atoms, local_index bildet die IDs darauf ab.
+// Von jedem Knoten werden nur die ersten edge_counts Kanten kopiert, die Verbindungen zu früheren Kopien gehören nicht zum Atom.
+Node *append_atom_copy(Generator *generator, Node **atom_nodes, size_t *edge_counts, size_t atom_size, size_t *local_index, Node *from) {
+    NFA *nfa = generator->generated;
+    Node **copies = malloc(atom_size * sizeof(Node *));
+    for (size_t index = 0; index < atom_size; index++) copies[index] = create_node(nfa);
+
+    for (size_t index = 0; index < atom_size; index++) {
+        Edge *edge = atom_nodes[index]->first_edge;
+        for (size_t edge_index = 0; edge_index < edge_counts[index]; edge_index++, edge = edge->next) {
+            Node *endpoint = copies[local_index[edge->endpoint->id]];
+            add_edge_between(nfa, copies[index], endpoint, edge->matching, edge->match_length, edge->byte_set);
+            copies[index]->last_edge->tag = edge->tag;
+            copies[index]->last_edge->assertion = edge->assertion;
+        }
+    }
+
+    add_empty_edge_between(nfa, from, copies[0]);
+    Node *copy_stop = copies[atom_size - 1];
+    free(copies);
+    return copy_stop;
+}
+
+// X{m, n} wird zu m Kopien von X, auf die n - m ineinander verschachtelte optionale Kopien folgen. Alle optionalen
+// Kopien springen zum selben Ausgang, deshalb bleibt jede Epsilon-Hülle klein und der Automat wächst nur linear mit n.
+// FIXME: Für große n fehlt noch eine Darstellung mit Zählern, die sublinear wächst (eigener Backlog-Eintrag user-026).
+// Bis dahin kostet auf langen Folgen des Atoms jedes Byte Arbeit proportional zu n, siehe README.
+// Gibt den Index des schließenden Tokens zurück.
+size_t add_repetition_range(Generator *generator, ParserState *parsed, size_t range_start) {
+    size_t range_stop = range_start + 4;
+    unsigned long minimum = read_unsigned_long_token(parsed, range_start + 1);
+    unsigned long maximum = read_unsigned_long_token(parsed, range_start + 3);
+    NFA *nfa = generator->generated;
+    Node *atom_start = VLA_binding_get_node_pointer(generator->block_start_nodes, -2);
+    Node *atom_stop = VLA_binding_get_node_pointer(generator->block_start_nodes, -1);
+
+    // Das Atom hat keine Kanten nach außen, alles, was vom Anfang aus erreichbar ist, gehört dazu.
+    // Das Ende kommt an die letzte Stelle, damit die Kopien es leicht wiederfinden.
+    size_t id_limit = nfa->node_count;
+    size_t *local_index = malloc(id_limit * sizeof(size_t));
+    memset(local_index, 0xFF, id_limit * sizeof(size_t));
+    VLA *atom = VLA_initialize(8, sizeof(Node *));
+    Stack *pending = stack_initialize(8, sizeof(Node *));
+    local_index[atom_start->id] = 0;
+    local_index[atom_stop->id] = 0;
+    stack_push(pending, &atom_start);
+    while (VLA_get_length(pending) > 0) {
+        Node *visiting = *(Node **)stack_pop(pending);
+        if (visiting != atom_stop) VLA_append(atom, &visiting);
+        for (Edge *edge = visiting->first_edge; edge != NULL; edge = edge->next) {
+            if (local_index[edge->endpoint->id] != SIZE_MAX) continue;
+            local_index[edge->endpoint->id] = 0;
+            stack_push(pending, &(edge->endpoint));
+        }
+    }
+    VLA_append(atom, &atom_stop);
+    size_t atom_size = VLA_get_length(atom);
+    Node **atom_nodes = (Node **)VLA_extract(atom);
+    size_t *edge_counts = malloc(atom_size * sizeof(size_t));
+    for (size_t index = 0; index < atom_size; index++) {
+        local_index[atom_nodes[index]->id] = index;
+        edge_counts[index] = atom_nodes[index]->edge_count;
+    }
+
+    size_t remaining_nodes = nfa->node_count < generator->node_limit ? generator->node_limit - nfa->node_count : 0;
+    if (maximum > 0 && maximum - 1 > remaining_nodes / atom_size) {
+        debug("Repetition range {%lu, %lu} would need more than %zu states.\n", minimum, maximum, generator->node_limit);
+        generator->too_large = true;
+    } else {
+        // Die Kanten zum Ausgang kommen erst dazu, wenn alle Kopien stehen, sonst würden sie mitkopiert.
+        // Bei X{0, 0} bleibt das Ende des Atoms eine Sackgasse, es zählt nur die leere Kante zum Ausgang.
+        Node **repetition_stops = malloc((maximum > 0 ? maximum : 1) * sizeof(Node *));
+        repetition_stops[0] = atom_stop;
+        for (unsigned long repetition = 1; repetition < maximum; repetition++) {
+            repetition_stops[repetition] = append_atom_copy(generator, atom_nodes, edge_counts, atom_size, local_index, repetition_stops[repetition - 1]);
+        }
+
+        Node *exit = create_node(nfa);
+        if (minimum == 0) add_empty_edge_between(nfa, atom_start, exit);
+        for (unsigned long repetition = minimum > 0 ? minimum : 1; repetition <= maximum; repetition++) {
+            add_empty_edge_between(nfa, repetition_stops[repetition - 1], exit);
+        }
+        free(repetition_stops);
+
+        stack_pop_n(generator->block_start_nodes, 1);
+        stack_push(generator->block_start_nodes, &exit);
+    }
+
+    free(atom_nodes);
+    free(edge_counts);
+    free(local_index);
+    VLA_free(pending);
+    return range_stop;
+}
+
+NFA *generate_nfa_from_parsed_regex(ParserState *parsed, size_t node_limit) {
+    Generator *generator = initialize_generator(node_limit);
+
+    // Der Regex kann durch \0 selbst Null-Bytes enthalten, deshalb zählen hier nur die Tokens.
+    for (size_t index = 0; index < parsed->number_of_tokens; index++) {
         Token current = parsed->tokens[index];
 
         if (current == block_open) {
+            if (followed_by_loop(parsed, find_block_close(parsed, index))) insert_proxy_start(generator);
             open_new_block_level(generator);
         } else if (current == block_close) {
             close_current_block_level(generator);
         } else if (current == utf8_codepoint) {
-            if (index + 1 < strlen(parsed->regex) && (parsed->tokens[index + 1] == mod_any || parsed->tokens[index + 1] == mod_multiple)) {
-                insert_proxy_start(generator);
-            }
-
-            char *match = calloc(2, sizeof(char));
-            match[0] = parsed->regex[index];
-            advance_current_path(generator, match);
+            if (followed_by_loop(parsed, index)) insert_proxy_start(generator);
+
+            size_t length = get_token_length(parsed, index);
+            char *match = arena_allocate(generator->generated->arena, length);
+            memcpy(match, parsed->regex + parsed->token_offsets[index], length);
+            advance_current_path_by_codepoint(generator, match, length);
+        } else if (current == anchor_start) {
+            add_assertion(generator, assertion_start);
+        } else if (current == anchor_end) {
+            add_assertion(generator, assertion_end);
+        } else if (current == word_boundary) {
+            add_assertion(generator, assertion_word_boundary);
+        } else if (current == value_range_start) {
+            index = add_value_range(generator, parsed, index);
+        } else if (current == repetition_range_start) {
+            index = add_repetition_range(generator, parsed, index);
+            if (generator->too_large) break;
         } else if (current == mod_choice) {
             backtrack_to_path_start(generator);
         } else if (current == mod_any) {
@@ -170,14 +367,23 @@ NFA *generate_nfa_from_parsed_regex(ParserState *parsed) {
         } else if (current == mod_optional) {
             loop_current_path_forward(generator, 2);
         } else {
-            // TODO: Unterstützung von Repetition/ValueRange
             warn("NFA generation for tokens of type %s is not handled yet.\n", get_token_description(current));
         }
+        // Ohne Wiederholungsbereiche kommen pro Token nur ein paar Knoten dazu, es reicht also, hier zu prüfen.
+        if (generator->generated->node_count > node_limit) {
+            debug("The regex needs more than %zu states.\n", node_limit);
+            generator->too_large = true;
+            break;
+        }
     }
 
-    close_current_block_level(generator);
     NFA *generated = generator->generated;
-    generated->node_count = *generator->global_node_index;
+    if (generator->too_large) {
+        free_nfa(generated);
+        generated = NULL;
+    } else {
+        close_current_block_level(generator);
+    }
     free_parser_state(parsed);
     free_generator(generator);
     return generated;
@@ -185,7 +391,7 @@ NFA *generate_nfa_from_parsed_regex(ParserState *parsed) {
 
 Compact_NFA *compact_generated_NFA(NFA *nfa) {
     Compact_NFA *compact_nfa = initialize_compact_nfa(nfa->node_count);
-    Node **visited_nodes = calloc(nfa->node_count, sizeof(Node *));
+    Node **visited_nodes = arena_allocate(nfa->arena, nfa->node_count * sizeof(Node *));
     visited_nodes[nfa->start->id] = nfa->start;
     Stack *visitor_order = stack_initialize(nfa->node_count, sizeof(Node *));
     stack_push(visitor_order, &(nfa->start));
@@ -193,12 +399,12 @@ Compact_NFA *compact_generated_NFA(NFA *nfa) {
     while (VLA_get_length(visitor_order) > 0) {
         VLA_print(visitor_order, node_pointer_formatter);
         Node *visiting = *(Node **)stack_pop(visitor_order);
-        debug("NFA state at %p with id=%lu and %lu outgoing edges.\n", visiting, visiting->id, VLA_get_length(visiting->edges));
-        compact_nfa->nodes[visiting->id] = create_compact_node(visiting);
+        debug("NFA state at %p with id=%lu and %lu outgoing edges.\n", visiting, visiting->id, visiting->edge_count);
+        compact_nfa->nodes[visiting->id] = create_compact_node(compact_nfa, visiting);
 
-        for (size_t index = 0; index < compact_nfa->nodes[visiting->id].edge_count; index++) {
-            Edge *edge = VLA_binding_get_edge(visiting->edges, index);
-            compact_nfa->nodes[visiting->id].edges[index] = create_compact_edge(edge);
+        size_t index = 0;
+        for (Edge *edge = visiting->first_edge; edge != NULL; edge = edge->next, index++) {
+            compact_nfa->nodes[visiting->id].edges[index] = create_compact_edge(compact_nfa, edge);
             if (visited_nodes[edge->endpoint->id] == NULL) {
                 visited_nodes[edge->endpoint->id] = edge->endpoint;
                 stack_push(visitor_order, &(edge->endpoint));
@@ -207,7 +413,7 @@ Compact_NFA *compact_generated_NFA(NFA *nfa) {
     }
 
     VLA_free(visitor_order);
-    free_nfa(nfa, visited_nodes);
-    free(visited_nodes);
+    compact_nfa->group_count = nfa->group_count;
+    free_nfa(nfa);
     return compact_nfa;
 }
\ No newline at end of file
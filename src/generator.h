@@ -4,7 +4,13 @@
 #include "NFA.h"
 #include "parser.h"
 
-NFA *generate_nfa_from_parsed_regex(ParserState *parsed);
+// Wie viele Knoten der generierte NFA ohne andere Vorgabe höchstens haben darf. Mehr kann praktisch nur durch große
+// Wiederholungen wie a{1, 1000000} entstehen.
+#define GENERATED_NODE_LIMIT (1 << 18)
+
+// Gibt NULL zurück, wenn der NFA mehr als node_limit Knoten bräuchte. Die Grenze wird schon während des Generierens
+// geprüft, ein zu großer Regex kostet also nicht erst den ganzen Speicher.
+NFA *generate_nfa_from_parsed_regex(ParserState *parsed, size_t node_limit);
 Compact_NFA *compact_generated_NFA(NFA *NFA);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include "lanes.h"
+#include "matcher.h"
+
+void select_match(Match_Selection *selection, size_t start, size_t end);
+int compare_matches(const void *a, const void *b);
+int compare_set_matches(const void *a, const void *b);
+
+void initialize_start_links(Start_Links *links) {
+    links->links = VLA_initialize(16, sizeof(Start_Link));
+    links->free_head = NO_LINK;
+    links->selection = NULL;
+}
+
+void free_start_links(Start_Links *links) {
+    VLA_free(links->links);
+}
+
+size_t start_links_memory(Start_Links *links) {
+    return links->links->capacity;
+}
+
+size_t allocate_start_link(Start_Links *links, size_t start) {
+    size_t index = links->free_head;
+    if (index == NO_LINK) {
+        index = VLA_get_length(links->links);
+        VLA_reserve_next_slots(links->links, 1);
+    } else {
+        links->free_head = ((Start_Link *)VLA_get(links->links, index))->next;
+    }
+
+    Start_Link *link = (Start_Link *)VLA_get(links->links, index);
+    link->start = start;
+    link->next = NO_LINK;
+    return index;
+}
+
+// Hängt die gesamte Liste auf einmal vor die Freiliste, damit der Speicher nicht mit der Eingabe wächst.
+void release_start_links(Start_Links *links, size_t head, size_t tail) {
+    ((Start_Link *)VLA_get(links->links, tail))->next = links->free_head;
+    links->free_head = head;
+}
+
+void concatenate_start_links(Start_Links *links, size_t tail, size_t head) {
+    ((Start_Link *)VLA_get(links->links, tail))->next = head;
+}
+
+// Mit Auswahl hat jede Lane nur eine Startposition, die kleinere verdrängt die größere.
+void merge_start_links(Start_Links *links, size_t *head, size_t *tail, size_t other_head, size_t other_tail) {
+    if (links->selection == NULL) {
+        concatenate_start_links(links, *tail, other_head);
+        *tail = other_tail;
+        return;
+    }
+
+    Start_Link *kept = (Start_Link *)VLA_get(links->links, *head);
+    Start_Link *other = (Start_Link *)VLA_get(links->links, other_head);
+    if (other->start < kept->start) {
+        release_start_links(links, *head, *tail);
+        *head = other_head;
+        *tail = other_tail;
+    } else {
+        release_start_links(links, other_head, other_tail);
+    }
+}
+
+// Die Kandidaten kommen in der Reihenfolge ihres Endes an. Bei gleichem Anfang gewinnt beim längsten Match
+// also immer der neue. Bei leftmost-first auch, weil in der Lane nach einem Match nur noch Threads mit höherer
+// Priorität weiterlaufen.
+void select_match(Match_Selection *selection, size_t start, size_t end) {
+    if (selection->best_start == NO_MATCH || start < selection->best_start) {
+        selection->best_start = start;
+        selection->best_end = end;
+    } else if (start == selection->best_start && selection->mode != match_shortest) {
+        selection->best_end = end;
+    }
+}
+
+void report_match(Start_Links *links, size_t start, size_t end, VLA *matches) {
+    if (links->selection != NULL) {
+        select_match(links->selection, start, end);
+        return;
+    }
+    Match *match = (Match *)VLA_reserve_next_slots(matches, 1);
+    match->offset = start;
+    match->length = end - start;
+}
+
+void report_start_links(Start_Links *links, size_t head, size_t position, VLA *matches) {
+    for (size_t link_index = head; link_index != NO_LINK;) {
+        Start_Link *link = (Start_Link *)VLA_get(links->links, link_index);
+        report_match(links, link->start, position, matches);
+        link_index = link->next;
+    }
+}
+
+// Lanes, die rechts vom Kandidaten angefangen haben, können keinen Match mehr liefern, der weiter links liegt.
+// Beim kürzesten Match gilt das auch für die Lane des Kandidaten selbst, jedes weitere Ende wäre länger.
+bool drop_outdone_lane(Start_Links *links, size_t head, size_t tail) {
+    Match_Selection *selection = links->selection;
+    if (selection == NULL || selection->best_start == NO_MATCH) return false;
+
+    size_t start = ((Start_Link *)VLA_get(links->links, head))->start;
+    if (start < selection->best_start || (start == selection->best_start && selection->mode != match_shortest)) return false;
+    release_start_links(links, head, tail);
+    return true;
+}
+
+bool has_candidate(Start_Links *links) {
+    return links->selection != NULL && links->selection->best_start != NO_MATCH;
+}
+
+bool selection_settled(Start_Links *links, size_t lane_count) {
+    if (lane_count > 0 || !has_candidate(links)) return false;
+    links->selection->finished = true;
+    return true;
+}
+
+void reset_match_selection(Match_Selection *selection, Regen_Match_Mode mode) {
+    selection->mode = mode;
+    selection->best_start = NO_MATCH;
+    selection->best_end = NO_MATCH;
+    selection->finished = false;
+}
+
+// Kopiert eine Liste in einen anderen Speicher, z.B. wenn eine Lane an eine andere Engine übergeben wird.
+void copy_start_links(Start_Links *from, size_t head, Start_Links *to, size_t *to_head, size_t *to_tail) {
+    *to_head = NO_LINK;
+    *to_tail = NO_LINK;
+    for (size_t link_index = head; link_index != NO_LINK;) {
+        Start_Link *link = (Start_Link *)VLA_get(from->links, link_index);
+        size_t copy = allocate_start_link(to, link->start);
+        if (*to_head == NO_LINK) {
+            *to_head = copy;
+        } else {
+            concatenate_start_links(to, *to_tail, copy);
+        }
+        *to_tail = copy;
+        link_index = ((Start_Link *)VLA_get(from->links, link_index))->next;
+    }
+}
+
+void report_pattern_start_links(Start_Links *links, size_t head, size_t position, size_t pattern, VLA *matches) {
+    for (size_t link_index = head; link_index != NO_LINK;) {
+        Start_Link *link = (Start_Link *)VLA_get(links->links, link_index);
+        Set_Match *match = (Set_Match *)VLA_reserve_next_slots(matches, 1);
+        match->pattern = pattern;
+        match->offset = link->start;
+        match->length = position - link->start;
+        link_index = link->next;
+    }
+}
+
+int compare_matches(const void *a, const void *b) {
+    const Match *first = a;
+    const Match *second = b;
+    if (first->offset != second->offset) return first->offset < second->offset ? -1 : 1;
+    if (first->length != second->length) return first->length < second->length ? -1 : 1;
+    return 0;
+}
+
+void sort_matches(VLA *matches, size_t from) {
+    if (VLA_get_length(matches) <= from) return;
+    qsort(VLA_get(matches, from), VLA_get_length(matches) - from, sizeof(Match), compare_matches);
+}
+
+int compare_set_matches(const void *a, const void *b) {
+    const Set_Match *first = a;
+    const Set_Match *second = b;
+    if (first->offset != second->offset) return first->offset < second->offset ? -1 : 1;
+    if (first->length != second->length) return first->length < second->length ? -1 : 1;
+    if (first->pattern != second->pattern) return first->pattern < second->pattern ? -1 : 1;
+    return 0;
+}
+
+void sort_set_matches(VLA *matches, size_t from) {
+    if (VLA_get_length(matches) <= from) return;
+    qsort(VLA_get(matches, from), VLA_get_length(matches) - from, sizeof(Set_Match), compare_set_matches);
+}
\ No newline at end of file
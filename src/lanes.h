@@ -0,0 +1,61 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "VLA.h"
+#include "matcher.h"
+
+#define NO_LINK SIZE_MAX
+#define NO_MATCH SIZE_MAX
+
+// Die Engines fassen alle Startpositionen, die gerade im selben Zustand stehen, zu einer Lane zusammen.
+// Die Startpositionen einer Lane sind eine einfach verkettete Liste, damit das Verschmelzen O(1) bleibt.
+typedef struct {
+    size_t start;
+    size_t next;
+} Start_Link;
+
+// Außer bei match_all merkt sich eine Suche statt aller Matches nur den besten Kandidaten. Jede Lane behält dann
+// nur ihre kleinste Startposition, und Lanes, die hinter dem Kandidaten angefangen haben, sterben sofort.
+typedef struct {
+    Regen_Match_Mode mode;
+    size_t best_start;
+    size_t best_end;
+    // Es gibt einen Kandidaten und keine Lane mehr, die ihn noch verdrängen könnte.
+    bool finished;
+} Match_Selection;
+
+typedef struct {
+    VLA *links;
+    size_t free_head;
+    // NULL, wenn alle Matches gemeldet werden.
+    Match_Selection *selection;
+} Start_Links;
+
+void initialize_start_links(Start_Links *links);
+void free_start_links(Start_Links *links);
+// Speicher für die Startpositionen in Bytes. Er wächst mit der Anzahl der Startpositionen, die noch leben.
+size_t start_links_memory(Start_Links *links);
+size_t allocate_start_link(Start_Links *links, size_t start);
+void release_start_links(Start_Links *links, size_t head, size_t tail);
+void concatenate_start_links(Start_Links *links, size_t tail, size_t head);
+// Verschmilzt die Startpositionen einer Lane mit denen einer gleichen Lane, die in *head bis *tail stehen.
+void merge_start_links(Start_Links *links, size_t *head, size_t *tail, size_t other_head, size_t other_tail);
+void report_match(Start_Links *links, size_t start, size_t end, VLA *matches);
+void report_start_links(Start_Links *links, size_t head, size_t position, VLA *matches);
+// Wie report_start_links, aber für Pattern-Sets mit der Nummer des Patterns, dessen Stop-Knoten erreicht wurde.
+void report_pattern_start_links(Start_Links *links, size_t head, size_t position, size_t pattern, VLA *matches);
+// Gibt die Startpositionen frei und gibt true zurück, wenn die Lane den Kandidaten nicht mehr verdrängen kann.
+bool drop_outdone_lane(Start_Links *links, size_t head, size_t tail);
+// Ob schon ein Kandidat feststeht. Dann fangen keine neuen Lanes mehr an, weil sie alle rechts davon lägen.
+bool has_candidate(Start_Links *links);
+// Ob die Suche vorbei ist, weil es einen Kandidaten und keine lebende Lane mehr gibt. Merkt sich das in der Auswahl.
+bool selection_settled(Start_Links *links, size_t lane_count);
+void reset_match_selection(Match_Selection *selection, Regen_Match_Mode mode);
+void copy_start_links(Start_Links *from, size_t head, Start_Links *to, size_t *to_head, size_t *to_tail);
+// Sortiert alle Matches ab Index from nach Offset und Länge.
+void sort_matches(VLA *matches, size_t from);
+void sort_set_matches(VLA *matches, size_t from);
+
+#endif
\ No newline at end of file
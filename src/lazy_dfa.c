@@ -0,0 +1,460 @@
+#include <string.h>
+#include "lazy_dfa.h"
+#include "lanes.h"
+#include "matcher.h"
+#include "debug.h"
+
+#define ALPHABET_SIZE 256
+#define EMPTY_SLOT UINT32_MAX
+#define CACHE_FULL (UINT32_MAX - 1)
+// Wurden seit dem letzten Leeren weniger Bytes pro Zustand gelesen, lohnt sich der Cache nicht mehr.
+#define MIN_BYTES_PER_STATE 10
+#define MAX_THRASH_COUNT 3
+
+typedef struct {
+    uint32_t state;
+    size_t starts_head;
+    size_t starts_tail;
+} DFA_Lane;
+
+// Zustand eines Durchlaufs: wie bei der Pike VM teilen sich alle Startpositionen,
+// die im selben DFA-Zustand stehen, eine Lane.
+struct DFA_Scan {
+    Lazy_DFA *dfa;
+    VLA *current;
+    VLA *building;
+    size_t *lane_of_state;
+    size_t *lane_generation;
+    size_t lane_capacity;
+    size_t generation;
+    Start_Links starts;
+    VLA *matches;
+};
+
+size_t get_state_cost(size_t class_count, size_t node_count);
+void reset_lazy_dfa_cache(Lazy_DFA *dfa);
+void grow_state_storage(Lazy_DFA *dfa);
+void grow_state_slots(Lazy_DFA *dfa);
+uint32_t add_state(Lazy_DFA *dfa, size_t *nodes, size_t node_count);
+uint32_t add_start_state(Lazy_DFA *dfa);
+uint32_t compute_transition(Lazy_DFA *dfa, uint32_t state, uint8_t byte);
+bool clear_cache_keeping_lanes(Lazy_DFA *dfa, DFA_Scan *scan, size_t first_live_lane);
+void add_lane(Lazy_DFA *dfa, DFA_Scan *scan, uint32_t state, size_t starts_head, size_t starts_tail, size_t position);
+void restamp_building_lanes(Lazy_DFA *dfa, DFA_Scan *scan);
+bool start_dies_on(Lazy_DFA *dfa, uint8_t byte);
+Pike_VM *hand_over_lanes(DFA_Scan *scan, size_t first_live_lane, uint8_t byte, size_t offset);
+int compare_state_nodes(const void *a, const void *b);
+
+Lazy_DFA *initialize_lazy_dfa(Compact_NFA *nfa, Epsilon_Closures *closures, size_t cache_size) {
+    Lazy_DFA *dfa = calloc(1, sizeof(Lazy_DFA));
+    dfa->nfa = nfa;
+    dfa->closures = closures;
+    dfa->cache_size = cache_size;
+    compute_byte_classes(nfa, &dfa->classes);
+    dfa->state_capacity = 16;
+    dfa->transitions = malloc(dfa->state_capacity * dfa->classes.class_count * sizeof(uint32_t));
+    dfa->accepting = malloc(dfa->state_capacity * sizeof(bool));
+    dfa->hashes = malloc(dfa->state_capacity * sizeof(uint64_t));
+    dfa->set_offsets = malloc((dfa->state_capacity + 1) * sizeof(size_t));
+    dfa->set_nodes = VLA_initialize(nfa->node_count, sizeof(size_t));
+    dfa->slot_capacity = 32;
+    dfa->slots = malloc(dfa->slot_capacity * sizeof(uint32_t));
+    dfa->node_marks = calloc(nfa->node_count, sizeof(size_t));
+    dfa->scratch_nodes = VLA_initialize(nfa->node_count, sizeof(size_t));
+
+    reset_lazy_dfa_cache(dfa);
+    return dfa;
+}
+
+void free_lazy_dfa(Lazy_DFA *dfa) {
+    free(dfa->transitions);
+    free(dfa->accepting);
+    free(dfa->hashes);
+    free(dfa->set_offsets);
+    VLA_free(dfa->set_nodes);
+    free(dfa->slots);
+    free(dfa->node_marks);
+    VLA_free(dfa->scratch_nodes);
+    free(dfa);
+}
+
+// Eine Zeile der Übergangstabelle plus die Knotenmenge und die Verwaltungsdaten des Zustands.
+size_t get_state_cost(size_t class_count, size_t node_count) {
+    return class_count * sizeof(uint32_t) + node_count * sizeof(size_t) +
+           sizeof(bool) + sizeof(uint64_t) + sizeof(size_t) + 2 * sizeof(uint32_t);
+}
+
+// Leert den Cache. Danach existieren nur noch der tote Zustand (leere Menge) und der Startzustand.
+void reset_lazy_dfa_cache(Lazy_DFA *dfa) {
+    dfa->state_count = 0;
+    dfa->used_size = 0;
+    dfa->set_offsets[0] = 0;
+    VLA_clear(dfa->set_nodes);
+    memset(dfa->slots, 0xFF, dfa->slot_capacity * sizeof(uint32_t));
+
+    add_state(dfa, NULL, 0);
+    dfa->start_state = add_start_state(dfa);
+}
+
+void grow_state_storage(Lazy_DFA *dfa) {
+    dfa->state_capacity *= 2;
+    dfa->transitions = realloc(dfa->transitions, dfa->state_capacity * dfa->classes.class_count * sizeof(uint32_t));
+    dfa->accepting = realloc(dfa->accepting, dfa->state_capacity * sizeof(bool));
+    dfa->hashes = realloc(dfa->hashes, dfa->state_capacity * sizeof(uint64_t));
+    dfa->set_offsets = realloc(dfa->set_offsets, (dfa->state_capacity + 1) * sizeof(size_t));
+    if (dfa->transitions == NULL || dfa->accepting == NULL || dfa->hashes == NULL || dfa->set_offsets == NULL) {
+        panic("Could not grow the lazy DFA to %lu states, aborting.\n", dfa->state_capacity);
+    }
+}
+
+void grow_state_slots(Lazy_DFA *dfa) {
+    free(dfa->slots);
+    dfa->slot_capacity *= 2;
+    dfa->slots = malloc(dfa->slot_capacity * sizeof(uint32_t));
+    memset(dfa->slots, 0xFF, dfa->slot_capacity * sizeof(uint32_t));
+
+    for (uint32_t state = 0; state < dfa->state_count; state++) {
+        size_t index = dfa->hashes[state] & (dfa->slot_capacity - 1);
+        while (dfa->slots[index] != EMPTY_SLOT) index = (index + 1) & (dfa->slot_capacity - 1);
+        dfa->slots[index] = state;
+    }
+}
+
+size_t *get_state_nodes(Lazy_DFA *dfa, uint32_t state, size_t *node_count) {
+    *node_count = dfa->set_offsets[state + 1] - dfa->set_offsets[state];
+    return (size_t *)dfa->set_nodes->data + dfa->set_offsets[state];
+}
+
+// Sucht den Zustand zur (sortierten) Knotenmenge und legt ihn an, falls es ihn noch nicht gibt.
+// Gibt CACHE_FULL zurück, wenn der neue Zustand nicht mehr in das Budget passt.
+uint32_t add_state(Lazy_DFA *dfa, size_t *nodes, size_t node_count) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t index = 0; index < node_count; index++) {
+        hash = (hash ^ nodes[index]) * 1099511628211ULL;
+    }
+
+    size_t slot = hash & (dfa->slot_capacity - 1);
+    while (dfa->slots[slot] != EMPTY_SLOT) {
+        uint32_t candidate = dfa->slots[slot];
+        size_t candidate_count;
+        size_t *candidate_nodes = get_state_nodes(dfa, candidate, &candidate_count);
+        if (dfa->hashes[candidate] == hash && candidate_count == node_count &&
+            !memcmp(candidate_nodes, nodes, node_count * sizeof(size_t))) {
+            return candidate;
+        }
+        slot = (slot + 1) & (dfa->slot_capacity - 1);
+    }
+
+    // Der tote Zustand und der Startzustand müssen immer Platz haben.
+    size_t cost = get_state_cost(dfa->classes.class_count, node_count);
+    if (dfa->state_count >= 2 && dfa->used_size + cost > dfa->cache_size) return CACHE_FULL;
+    if (dfa->state_count == dfa->state_capacity) grow_state_storage(dfa);
+
+    uint32_t state = dfa->state_count++;
+    dfa->used_size += cost;
+    dfa->hashes[state] = hash;
+    dfa->accepting[state] = false;
+    for (size_t index = 0; index < node_count; index++) {
+        if (is_stop_node(dfa->nfa, nodes[index])) dfa->accepting[state] = true;
+    }
+
+    if (node_count > 0) VLA_batch_append(dfa->set_nodes, nodes, node_count);
+    dfa->set_offsets[state + 1] = VLA_get_length(dfa->set_nodes);
+
+    uint32_t *row = dfa->transitions + (size_t)state * dfa->classes.class_count;
+    uint32_t fill = state == DFA_DEAD_STATE ? DFA_DEAD_STATE : DFA_UNKNOWN_STATE;
+    for (size_t byte_class = 0; byte_class < dfa->classes.class_count; byte_class++) row[byte_class] = fill;
+
+    dfa->slots[slot] = state;
+    if (dfa->state_count * 2 > dfa->slot_capacity) grow_state_slots(dfa);
+    return state;
+}
+
+int compare_state_nodes(const void *a, const void *b) {
+    size_t first = *(const size_t *)a;
+    size_t second = *(const size_t *)b;
+    return (first > second) - (first < second);
+}
+
+uint32_t add_start_state(Lazy_DFA *dfa) {
+    size_t member_count;
+    size_t *members = get_closure_members(dfa->closures, dfa->nfa->start_node_index, &member_count);
+    VLA_clear(dfa->scratch_nodes);
+    VLA_batch_append(dfa->scratch_nodes, members, member_count);
+    qsort(dfa->scratch_nodes->data, member_count, sizeof(size_t), compare_state_nodes);
+    return add_state(dfa, (size_t *)dfa->scratch_nodes->data, member_count);
+}
+
+// Alle Bytes einer Klasse führen zum selben Zustand, das Ergebnis gilt also für die ganze Klasse von byte.
+uint32_t compute_transition(Lazy_DFA *dfa, uint32_t state, uint8_t byte) {
+    dfa->mark++;
+    VLA_clear(dfa->scratch_nodes);
+
+    size_t node_count;
+    size_t *nodes = get_state_nodes(dfa, state, &node_count);
+    for (size_t index = 0; index < node_count; index++) {
+        Compact_Node *node = &dfa->nfa->nodes[nodes[index]];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            if (!edge_matches_byte(edge, byte)) continue;
+
+            size_t member_count;
+            size_t *members = get_closure_members(dfa->closures, edge->endpoint, &member_count);
+            for (size_t member_index = 0; member_index < member_count; member_index++) {
+                if (dfa->node_marks[members[member_index]] == dfa->mark) continue;
+                dfa->node_marks[members[member_index]] = dfa->mark;
+                VLA_append(dfa->scratch_nodes, &members[member_index]);
+            }
+        }
+    }
+
+    size_t next_count = VLA_get_length(dfa->scratch_nodes);
+    qsort(dfa->scratch_nodes->data, next_count, sizeof(size_t), compare_state_nodes);
+    uint32_t next = add_state(dfa, (size_t *)dfa->scratch_nodes->data, next_count);
+    if (next != CACHE_FULL) dfa->transitions[(size_t)state * dfa->classes.class_count + dfa->classes.class_of[byte]] = next;
+    return next;
+}
+
+uint32_t lazy_dfa_next_state(Lazy_DFA *dfa, uint32_t state, uint8_t byte) {
+    uint32_t next = dfa->transitions[(size_t)state * dfa->classes.class_count + dfa->classes.class_of[byte]];
+    if (next == DFA_UNKNOWN_STATE) next = compute_transition(dfa, state, byte);
+    return next == CACHE_FULL ? DFA_UNKNOWN_STATE : next;
+}
+
+uint32_t lazy_dfa_clear_cache_keeping_state(Lazy_DFA *dfa, uint32_t state) {
+    size_t node_count;
+    size_t *nodes = get_state_nodes(dfa, state, &node_count);
+    VLA *saved_nodes = VLA_initialize(node_count + 1, sizeof(size_t));
+    if (node_count > 0) VLA_batch_append(saved_nodes, nodes, node_count);
+
+    dfa->clear_count++;
+    dfa->bytes_since_clear = 0;
+    debug("Clearing the lazy DFA cache with %lu states (%lu bytes).\n", dfa->state_count, dfa->used_size);
+    reset_lazy_dfa_cache(dfa);
+    uint32_t kept = add_state(dfa, (size_t *)saved_nodes->data, node_count);
+    VLA_free(saved_nodes);
+    return kept == CACHE_FULL ? DFA_UNKNOWN_STATE : kept;
+}
+
+size_t lazy_dfa_state_cost(size_t node_count) {
+    return get_state_cost(ALPHABET_SIZE, node_count);
+}
+
+void restamp_building_lanes(Lazy_DFA *dfa, DFA_Scan *scan) {
+    if (scan->lane_capacity < dfa->state_capacity) {
+        free(scan->lane_of_state);
+        free(scan->lane_generation);
+        scan->lane_capacity = dfa->state_capacity;
+        scan->lane_of_state = malloc(scan->lane_capacity * sizeof(size_t));
+        scan->lane_generation = calloc(scan->lane_capacity, sizeof(size_t));
+    }
+
+    scan->generation++;
+    for (size_t lane_index = 0; lane_index < VLA_get_length(scan->building); lane_index++) {
+        DFA_Lane *lane = (DFA_Lane *)VLA_get(scan->building, lane_index);
+        scan->lane_of_state[lane->state] = lane_index;
+        scan->lane_generation[lane->state] = scan->generation;
+    }
+}
+
+// Leert den Cache, übernimmt aber die Zustände aller noch lebenden Lanes in den neuen Cache.
+// Gibt false zurück, ohne den Cache anzufassen, wenn sich das Leeren nicht mehr lohnt oder die Zustände nicht hineinpassen.
+bool clear_cache_keeping_lanes(Lazy_DFA *dfa, DFA_Scan *scan, size_t first_live_lane) {
+    dfa->clear_count++;
+    if (dfa->bytes_since_clear < MIN_BYTES_PER_STATE * dfa->state_count) {
+        dfa->thrash_count++;
+    } else {
+        dfa->thrash_count = 0;
+    }
+    dfa->bytes_since_clear = 0;
+    debug("Clearing the lazy DFA cache with %lu states (%lu bytes).\n", dfa->state_count, dfa->used_size);
+    if (dfa->thrash_count >= MAX_THRASH_COUNT) return false;
+
+    VLA *lists[2] = {scan->current, scan->building};
+    size_t firsts[2] = {first_live_lane, 0};
+    VLA *saved_nodes = VLA_initialize(dfa->nfa->node_count, sizeof(size_t));
+    VLA *saved_offsets = VLA_initialize(8, sizeof(size_t));
+    VLA_append(saved_offsets, &(size_t){0});
+    size_t start_count;
+    get_state_nodes(dfa, dfa->start_state, &start_count);
+    size_t needed = get_state_cost(dfa->classes.class_count, 0) + get_state_cost(dfa->classes.class_count, start_count);
+
+    for (size_t list = 0; list < 2; list++) {
+        for (size_t lane_index = firsts[list]; lane_index < VLA_get_length(lists[list]); lane_index++) {
+            DFA_Lane *lane = (DFA_Lane *)VLA_get(lists[list], lane_index);
+            size_t node_count;
+            size_t *nodes = get_state_nodes(dfa, lane->state, &node_count);
+            VLA_batch_append(saved_nodes, nodes, node_count);
+            VLA_append(saved_offsets, &(size_t){VLA_get_length(saved_nodes)});
+            needed += get_state_cost(dfa->classes.class_count, node_count);
+        }
+    }
+
+    bool fits = needed <= dfa->cache_size;
+    if (fits) {
+        reset_lazy_dfa_cache(dfa);
+        size_t saved_index = 0;
+        for (size_t list = 0; list < 2; list++) {
+            for (size_t lane_index = firsts[list]; lane_index < VLA_get_length(lists[list]); lane_index++) {
+                size_t from = *(size_t *)VLA_get(saved_offsets, saved_index);
+                size_t to = *(size_t *)VLA_get(saved_offsets, saved_index + 1);
+                ((DFA_Lane *)VLA_get(lists[list], lane_index))->state = add_state(dfa, (size_t *)saved_nodes->data + from, to - from);
+                saved_index++;
+            }
+        }
+        restamp_building_lanes(dfa, scan);
+    }
+
+    VLA_free(saved_nodes);
+    VLA_free(saved_offsets);
+    return fits;
+}
+
+void add_lane(Lazy_DFA *dfa, DFA_Scan *scan, uint32_t state, size_t starts_head, size_t starts_tail, size_t position) {
+    if (state == DFA_DEAD_STATE) {
+        release_start_links(&scan->starts, starts_head, starts_tail);
+        return;
+    }
+
+    if (dfa->accepting[state]) report_start_links(&scan->starts, starts_head, position, scan->matches);
+    if (drop_outdone_lane(&scan->starts, starts_head, starts_tail)) return;
+
+    if (scan->lane_generation[state] == scan->generation) {
+        DFA_Lane *equal = (DFA_Lane *)VLA_get(scan->building, scan->lane_of_state[state]);
+        merge_start_links(&scan->starts, &equal->starts_head, &equal->starts_tail, starts_head, starts_tail);
+        return;
+    }
+
+    scan->lane_of_state[state] = VLA_get_length(scan->building);
+    scan->lane_generation[state] = scan->generation;
+    DFA_Lane *lane = (DFA_Lane *)VLA_reserve_next_slots(scan->building, 1);
+    lane->state = state;
+    lane->starts_head = starts_head;
+    lane->starts_tail = starts_tail;
+}
+
+// Die meisten Startpositionen sterben schon beim ersten Byte, für die lohnt sich keine eigene Lane.
+bool start_dies_on(Lazy_DFA *dfa, uint8_t byte) {
+    if (dfa->accepting[dfa->start_state]) return false;
+    uint32_t next = dfa->transitions[(size_t)dfa->start_state * dfa->classes.class_count + dfa->classes.class_of[byte]];
+    if (next == DFA_UNKNOWN_STATE) next = compute_transition(dfa, dfa->start_state, byte);
+    return next == DFA_DEAD_STATE;
+}
+
+// Gibt die Lanes an eine neue Pike VM ab. Die Lanes in building stehen schon hinter dem Byte an Position offset,
+// die aus current ab first_live_lane noch davor.
+Pike_VM *hand_over_lanes(DFA_Scan *scan, size_t first_live_lane, uint8_t byte, size_t offset) {
+    Lazy_DFA *dfa = scan->dfa;
+    Pike_VM *vm = initialize_pike_vm(dfa->nfa, dfa->closures);
+    pike_vm_select_matches(vm, scan->starts.selection);
+    for (size_t lane_index = 0; lane_index < VLA_get_length(scan->building); lane_index++) {
+        DFA_Lane *lane = (DFA_Lane *)VLA_get(scan->building, lane_index);
+        size_t node_count;
+        size_t *nodes = get_state_nodes(dfa, lane->state, &node_count);
+        pike_vm_adopt_lane(vm, nodes, node_count, &scan->starts, lane->starts_head, offset + 1);
+    }
+    for (size_t lane_index = first_live_lane; lane_index < VLA_get_length(scan->current); lane_index++) {
+        DFA_Lane *lane = (DFA_Lane *)VLA_get(scan->current, lane_index);
+        size_t node_count;
+        size_t *nodes = get_state_nodes(dfa, lane->state, &node_count);
+        pike_vm_adopt_lane_before(vm, nodes, node_count, &scan->starts, lane->starts_head, byte, offset, scan->matches);
+    }
+    return vm;
+}
+
+DFA_Scan *initialize_dfa_scan(Lazy_DFA *dfa) {
+    DFA_Scan *scan = calloc(1, sizeof(DFA_Scan));
+    scan->dfa = dfa;
+    scan->current = VLA_initialize(4, sizeof(DFA_Lane));
+    scan->building = VLA_initialize(4, sizeof(DFA_Lane));
+    initialize_start_links(&scan->starts);
+    restamp_building_lanes(dfa, scan);
+    dfa->thrash_count = 0;
+    return scan;
+}
+
+size_t dfa_scan_memory(DFA_Scan *scan) {
+    size_t lanes = scan->current->capacity + scan->building->capacity;
+    return lanes + 2 * scan->lane_capacity * sizeof(size_t) + start_links_memory(&scan->starts);
+}
+
+void dfa_scan_select_matches(DFA_Scan *scan, Match_Selection *selection) {
+    scan->starts.selection = selection;
+}
+
+void free_dfa_scan(DFA_Scan *scan) {
+    VLA_free(scan->current);
+    VLA_free(scan->building);
+    free(scan->lane_of_state);
+    free(scan->lane_generation);
+    free_start_links(&scan->starts);
+    free(scan);
+}
+
+bool lazy_dfa_feed(DFA_Scan *scan, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset, bool final_chunk,
+                   size_t start_limit, VLA *matches, Pike_VM **fallback, size_t *consumed) {
+    Lazy_DFA *dfa = scan->dfa;
+    scan->matches = matches;
+    Prefilter_Cursor cursor;
+    initialize_prefilter_cursor(&cursor, !final_chunk, start_limit);
+    size_t candidate = find_next_candidate(prefilter, &cursor, data, length, 0);
+
+    for (size_t position = 0; position < length; position++) {
+        if (VLA_get_length(scan->building) == 0 && selection_settled(&scan->starts, 0)) break;
+        if (VLA_get_length(scan->building) == 0 && candidate > position) {
+            // Übersprungene Bytes zählen mit, sonst sähe der Cache bei seltenen Kandidaten nach Thrashing aus.
+            dfa->bytes_since_clear += candidate - position;
+            position = candidate;
+            if (position == length) break;
+        }
+        if (position == candidate && !has_candidate(&scan->starts)) {
+            if (!start_dies_on(dfa, data[position])) {
+                size_t link = allocate_start_link(&scan->starts, offset + position);
+                add_lane(dfa, scan, dfa->start_state, link, link, offset + position);
+            }
+            candidate = find_next_candidate(prefilter, &cursor, data, length, position + 1);
+        }
+
+        VLA *swap = scan->current;
+        scan->current = scan->building;
+        scan->building = swap;
+        VLA_clear(scan->building);
+        scan->generation++;
+
+        uint8_t byte = data[position];
+        size_t byte_class = dfa->classes.class_of[byte];
+        dfa->bytes_since_clear++;
+        for (size_t lane_index = 0; lane_index < VLA_get_length(scan->current); lane_index++) {
+            DFA_Lane *lane = (DFA_Lane *)scan->current->data + lane_index;
+            uint32_t next = dfa->transitions[(size_t)lane->state * dfa->classes.class_count + byte_class];
+            if (next == DFA_UNKNOWN_STATE) next = compute_transition(dfa, lane->state, byte);
+            if (next == CACHE_FULL) {
+                if (clear_cache_keeping_lanes(dfa, scan, lane_index)) {
+                    next = compute_transition(dfa, lane->state, byte);
+                }
+                if (next == CACHE_FULL) {
+                    debug("Lazy DFA gave up, handing over to the Pike VM at offset %lu.\n", offset + position);
+                    *fallback = hand_over_lanes(scan, lane_index, byte, offset + position);
+                    *consumed = position + 1;
+                    return false;
+                }
+            }
+            // Der neue Zustand kann die Tabellen für die Lanes vergrößert haben.
+            if (scan->lane_capacity < dfa->state_capacity) restamp_building_lanes(dfa, scan);
+            add_lane(dfa, scan, next, lane->starts_head, lane->starts_tail, offset + position + 1);
+        }
+    }
+
+    // Nach dem letzten Stück kann keine Lane mehr matchen, der Durchlauf ist danach frei für eine neue Suche.
+    if (final_chunk) {
+        for (size_t lane_index = 0; lane_index < VLA_get_length(scan->building); lane_index++) {
+            DFA_Lane *lane = (DFA_Lane *)VLA_get(scan->building, lane_index);
+            release_start_links(&scan->starts, lane->starts_head, lane->starts_tail);
+        }
+        VLA_clear(scan->building);
+        scan->generation++;
+    }
+    selection_settled(&scan->starts, VLA_get_length(scan->building));
+    *consumed = length;
+    return true;
+}
\ No newline at end of file
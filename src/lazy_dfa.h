@@ -0,0 +1,76 @@
+#ifndef LAZY_DFA_H
+#define LAZY_DFA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "NFA.h"
+#include "closure.h"
+#include "byte_classes.h"
+#include "prefilter.h"
+#include "pike_vm.h"
+#include "VLA.h"
+
+#define DFA_DEAD_STATE 0
+#define DFA_UNKNOWN_STATE UINT32_MAX
+
+typedef struct Lazy_DFA Lazy_DFA;
+typedef struct DFA_Scan DFA_Scan;
+
+// Determinisiert den Compact_NFA erst während des Matchens. Jeder DFA-Zustand steht für eine sortierte
+// Menge von NFA-Knoten, seine Übergänge werden erst berechnet, wenn sie zum ersten Mal gebraucht werden.
+// Die Übergangstabelle hat eine Spalte pro Byte-Klasse, nicht pro Byte.
+// Der Cache ist veränderlich, eine Lazy_DFA darf also nicht von mehreren Threads gleichzeitig benutzt werden.
+struct Lazy_DFA {
+    Compact_NFA *nfa;
+    Epsilon_Closures *closures;
+    size_t cache_size;
+    size_t used_size;
+
+    Byte_Classes classes;
+    uint32_t *transitions;
+    bool *accepting;
+    uint64_t *hashes;
+    size_t *set_offsets;
+    VLA *set_nodes;
+    size_t state_count;
+    size_t state_capacity;
+    uint32_t start_state;
+
+    uint32_t *slots;
+    size_t slot_capacity;
+
+    size_t *node_marks;
+    size_t mark;
+    VLA *scratch_nodes;
+
+    size_t clear_count;
+    size_t bytes_since_clear;
+    size_t thrash_count;
+};
+
+Lazy_DFA *initialize_lazy_dfa(Compact_NFA *nfa, Epsilon_Closures *closures, size_t cache_size);
+void free_lazy_dfa(Lazy_DFA *dfa);
+// Gibt den Folgezustand zurück und berechnet ihn vorher, falls nötig. Solange der Cache nicht voll ist,
+// haben die Zustände aufsteigende Nummern in der Reihenfolge, in der sie entdeckt wurden.
+uint32_t lazy_dfa_next_state(Lazy_DFA *dfa, uint32_t state, uint8_t byte);
+// Die sortierte Menge von NFA-Knoten, für die der Zustand steht.
+size_t *get_state_nodes(Lazy_DFA *dfa, uint32_t state, size_t *node_count);
+// Leert den Cache bis auf state und gibt dessen neue Nummer zurück (DFA_UNKNOWN_STATE, falls er allein schon nicht passt).
+uint32_t lazy_dfa_clear_cache_keeping_state(Lazy_DFA *dfa, uint32_t state);
+// Wie viele Bytes des Cache-Budgets ein Zustand mit node_count NFA-Knoten höchstens belegt.
+size_t lazy_dfa_state_cost(size_t node_count);
+// Ein Durchlauf über die Eingabe, der auch über mehrere Aufrufe von lazy_dfa_feed gehen kann.
+DFA_Scan *initialize_dfa_scan(Lazy_DFA *dfa);
+void free_dfa_scan(DFA_Scan *scan);
+// Wie pike_vm_select_matches, aber nicht für match_leftmost_first, das die Reihenfolge der NFA-Knoten braucht.
+void dfa_scan_select_matches(DFA_Scan *scan, Match_Selection *selection);
+// Speicher für Lanes und Startpositionen in Bytes, ohne den Zustandscache.
+size_t dfa_scan_memory(DFA_Scan *scan);
+// Wie pike_vm_feed. Gibt false zurück, wenn der Cache so oft geleert werden musste, dass die NFA-Simulation
+// schneller wäre, oder die lebenden Zustände nicht mehr hineinpassen. Dann stehen alle Lanes in einer neuen
+// Pike VM *fallback, die ab Byte *consumed von data weiterlesen muss. Sonst ist *consumed gleich length, auch
+// wenn der Durchlauf mit Auswahl schon vorher beendet war.
+bool lazy_dfa_feed(DFA_Scan *scan, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset, bool final_chunk,
+                   size_t start_limit, VLA *matches, Pike_VM **fallback, size_t *consumed);
+
+#endif
\ No newline at end of file
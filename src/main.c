@@ -1,19 +1,195 @@
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "debug.h"
 #include "matcher.h"
 
-int main(int argc, char** argv) {
-    if (argc != 3) {
-        printf("Benutzung: %s Regex Text\n", argv[0]);
-        return 0;
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+typedef struct {
+    char* buffer;
+    size_t used;
+    bool failed;
+} Buffered_Writer;
+
+// Merkt sich die zuletzt gefragte Position und ihre Zeilennummer, damit nicht jedes Mal von vorne gezählt wird.
+typedef struct {
+    const uint8_t* data;
+    size_t position;
+    size_t line;
+} Line_Counter;
+
+// Alles, was print_match für eine Datei braucht.
+typedef struct {
+    Buffered_Writer* writer;
+    Line_Counter counter;
+    const char* path;
+    bool print_path;
+} File_Search;
+
+void flush_output(Buffered_Writer* writer);
+void write_output(Buffered_Writer* writer, const void* bytes, size_t length);
+void write_number(Buffered_Writer* writer, size_t number);
+size_t get_line_number(Line_Counter* counter, size_t offset);
+Regen_Scan_Action print_match(size_t offset, size_t length, void* user_data);
+int search_file(Compiled_Regex* compiled, char* path, bool print_path, Buffered_Writer* writer);
+int search_files(char* regex, char** paths, size_t path_count);
+int match_text(char* regex, char* text);
+
+void flush_output(Buffered_Writer* writer) {
+    size_t written = 0;
+    while (written < writer->used && !writer->failed) {
+        ssize_t result = write(STDOUT_FILENO, writer->buffer + written, writer->used - written);
+        if (result < 0 && errno == EINTR) continue;
+        if (result < 0) writer->failed = true;
+        else written += result;
+    }
+    writer->used = 0;
+}
+
+void write_output(Buffered_Writer* writer, const void* bytes, size_t length) {
+    if (writer->used + length > OUTPUT_BUFFER_SIZE) flush_output(writer);
+    // Alles, was nicht mehr in den Puffer passt, geht direkt raus.
+    if (length > OUTPUT_BUFFER_SIZE) {
+        char* saved = writer->buffer;
+        writer->buffer = (char*)bytes;
+        writer->used = length;
+        flush_output(writer);
+        writer->buffer = saved;
+        return;
+    }
+    memcpy(writer->buffer + writer->used, bytes, length);
+    writer->used += length;
+}
+
+void write_number(Buffered_Writer* writer, size_t number) {
+    char digits[32];
+    size_t first = sizeof(digits);
+    do {
+        digits[--first] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    write_output(writer, digits + first, sizeof(digits) - first);
+}
+
+// Die Matches kommen nach Offset sortiert, nur zwischen zwei Fenstern des Iterators kann es etwas zurückgehen.
+size_t get_line_number(Line_Counter* counter, size_t offset) {
+    while (counter->position < offset) {
+        const uint8_t* newline = memchr(counter->data + counter->position, '\n', offset - counter->position);
+        if (newline == NULL) {
+            counter->position = offset;
+            break;
+        }
+        counter->line++;
+        counter->position = newline - counter->data + 1;
+    }
+    while (counter->position > offset) {
+        counter->position--;
+        if (counter->data[counter->position] == '\n') counter->line--;
+    }
+    return counter->line;
+}
+
+Regen_Scan_Action print_match(size_t offset, size_t length, void* user_data) {
+    File_Search* search = user_data;
+    Buffered_Writer* writer = search->writer;
+    if (search->print_path) {
+        write_output(writer, search->path, strlen(search->path));
+        write_output(writer, ":", 1);
+    }
+    write_number(writer, get_line_number(&search->counter, offset));
+    write_output(writer, ":", 1);
+    write_number(writer, offset);
+    write_output(writer, ":", 1);
+    write_output(writer, search->counter.data + offset, length);
+    write_output(writer, "\n", 1);
+    // Ist die Ausgabe schon kaputt, muss der Rest der Datei nicht mehr durchsucht werden.
+    return writer->failed ? scan_stop : scan_continue;
+}
+
+// Gibt 0 zurück, wenn etwas gefunden wurde, 1 wenn nicht und 2 bei einem Fehler (wie grep).
+int search_file(Compiled_Regex* compiled, char* path, bool print_path, Buffered_Writer* writer) {
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        fprintf(stderr, "Konnte %s nicht öffnen: %s\n", path, strerror(errno));
+        return 2;
+    }
+
+    struct stat info;
+    if (fstat(descriptor, &info) < 0) {
+        fprintf(stderr, "Konnte %s nicht lesen: %s\n", path, strerror(errno));
+        close(descriptor);
+        return 2;
+    }
+    size_t length = info.st_size;
+    // Eine leere Datei lässt sich nicht mappen, enthält aber auch keinen Match.
+    if (length == 0) {
+        close(descriptor);
+        return 1;
+    }
+
+    const uint8_t* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Konnte %s nicht mappen: %s\n", path, strerror(errno));
+        return 2;
+    }
+    madvise((void*)data, length, MADV_SEQUENTIAL);
+
+    // Die Matches werden direkt aus dem Mapping gelesen und ausgegeben, weder die Datei noch die Matches werden kopiert.
+    File_Search search = {
+        .writer = writer,
+        .counter = {.data = data, .position = 0, .line = 1},
+        .path = path,
+        .print_path = print_path,
+    };
+    bool found = regen_exec_callback(compiled, data, length, print_match, &search) > 0;
+
+    munmap((void*)data, length);
+    return found ? 0 : 1;
+}
+
+int search_files(char* regex, char** paths, size_t path_count) {
+    // Wie bei grep beziehen sich ^ und $ auf die Zeilen der Datei und jede Stelle wird nur einmal gemeldet,
+    // mit dem längsten Match, der dort beginnt, statt mit jedem Teilstring, der auch passt.
+    Regen_Options options = regen_default_options();
+    options.multiline = true;
+    options.match_mode = match_leftmost_longest;
+    Compiled_Regex* compiled = regen_compile_with_options(regex, &options);
+    if (compiled == NULL) {
+        fprintf(stderr, "%s %s.\n", regex, regen_compile_error_message(regen_compile_error()));
+        return 2;
+    }
+
+    Buffered_Writer writer = {.buffer = malloc(OUTPUT_BUFFER_SIZE), .used = 0, .failed = false};
+    int result = 1;
+    for (size_t path_index = 0; path_index < path_count; path_index++) {
+        int file_result = search_file(compiled, paths[path_index], path_count > 1, &writer);
+        if (file_result == 0 && result == 1) result = 0;
+        if (file_result == 2) result = 2;
+    }
+    flush_output(&writer);
+    if (writer.failed) {
+        fprintf(stderr, "Konnte die Ausgabe nicht schreiben: %s\n", strerror(errno));
+        result = 2;
     }
 
-    char* regex = argv[1];
-    char* text = argv[2];
+    free(writer.buffer);
+    regen_free(compiled);
+    return result;
+}
 
+int match_text(char* regex, char* text) {
     size_t matches_count = 0;
     Match* matches = match(text, regex, &matches_count);
+    if (matches == NULL && regen_compile_error() != regen_compile_ok) {
+        fprintf(stderr, "%s %s.\n", regex, regen_compile_error_message(regen_compile_error()));
+        return 2;
+    }
 
     printf("Input: %s\n", text);
     for (size_t match_index = 0; match_index < matches_count; match_index++) {
@@ -23,4 +199,16 @@ int main(int argc, char** argv) {
     free(matches);
 
     return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && !strcmp(argv[1], "-f")) return search_files(argv[2], argv + 3, argc - 3);
+
+    if (argc != 3) {
+        printf("Benutzung: %s Regex Text\n", argv[0]);
+        printf("           %s -f Regex Datei...\n", argv[0]);
+        return 0;
+    }
+
+    return match_text(argv[1], argv[2]);
 }
\ No newline at end of file
@@ -1,139 +1,771 @@
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "NFA.h"
 #include "parser.h"
 #include "generator.h"
 #include "matcher.h"
-#include "stack.h"
+#include "closure.h"
+#include "optimizer.h"
+#include "prefilter.h"
+#include "pike_vm.h"
+#include "lazy_dfa.h"
+#include "full_dfa.h"
+#include "capture_vm.h"
+#include "code_generator.h"
+#include "automaton_file.h"
+#include "regex_cache.h"
+#include "lanes.h"
 #include "debug.h"
 
+#define DEFAULT_DFA_CACHE_SIZE (1 << 20)
+#define DEFAULT_DFA_STATE_LIMIT 4096
+// Kleinere Stücke lohnen den Start eines Threads nicht.
+#define MIN_BYTES_PER_THREAD (1 << 16)
+// Mit Grenzen pro Aufruf wird in Fenstern gelesen und dazwischen geprüft. Bei match_all kann jedes Byte so viele
+// Matches ergeben, wie Startpositionen leben, deshalb bleiben die Fenster klein, solange pro Byte viel passiert.
+// Sonst wachsen sie bis MAX_LIMIT_WINDOW, damit der Prefilter weit springen kann.
+#define MIN_LIMIT_WINDOW (1 << 8)
+#define MAX_LIMIT_WINDOW (1 << 16)
+
+struct Compiled_Regex {
+    Compact_NFA* nfa;
+    Epsilon_Closures* closures;
+    Prefilter* prefilter;
+    Lazy_DFA* lazy_dfa;
+    Full_DFA* full_dfa;
+    // Für jeden zusätzlichen Thread eine eigene Lazy-DFA, der erste Thread benutzt lazy_dfa.
+    Lazy_DFA** worker_dfas;
+    // Nur mit options.captures oder Bedingungen im Regex: der Automat aus dem Generator, bevor remove_empty_edges
+    // die Tags und Bedingungen entfernt.
+    Compact_NFA* tagged_nfa;
+    Capture_VM* capture_vm;
+    // Ohne ihre Bedingungen passt nfa auf mehr als der Regex, dann findet alle Matches die Capture_VM.
+    // Der Prefilter bleibt trotzdem gültig, da jeder echte Match auch einer von nfa ist.
+    bool has_assertions;
+    Regen_Options options;
+    Regen_Status status;
+    // Nur bei regen_load: die eingeblendete Datei, in die nfa, tagged_nfa, closures, prefilter und full_dfa zeigen.
+    void* mapping;
+    size_t mapping_length;
+    // Nur bei Kopien aus share_compiled_regex: das Original, dem alles außer den Caches und der Capture_VM gehört.
+    Compiled_Regex* shared_from;
+};
+
+// Ein Durchlauf mit der Engine, die zum Compiled_Regex passt. Gibt die Lazy-DFA auf, liest die Pike VM weiter.
+// Außer bei match_all ist das eine Folge von Suchen, die jeweils am Ende des vorigen Matches beginnen.
+typedef struct {
+    Compiled_Regex* compiled;
+    Full_DFA_Scan* full_scan;
+    DFA_Scan* lazy_scan;
+    Pike_VM* vm;
+    size_t offset;
+    Match_Selection selection;
+    // Die schon gelesenen Bytes ab carry_offset, an dem die nächste Suche frühestens beginnt. Bleibt bei match_all
+    // NULL und außerhalb von Streams leer.
+    VLA* carry;
+    size_t carry_offset;
+    // Liegen die Daten am Stück vor, zeigt base auf ihren Anfang. Dann muss nichts in carry aufgehoben werden.
+    const uint8_t* base;
+    // Für die Grenzen pro Aufruf: gelesene Bytes und gefundene Matches und die Matches, die schon an den Aufrufer gingen.
+    size_t steps;
+    size_t reported;
+    Regen_Status status;
+} Match_Scan;
+
+struct Regen_Stream {
+    Match_Scan scan;
+    // Jeder Stream hat seine eigene Lazy-DFA, damit regen_exec zwischendurch nicht die Zustände seiner Lanes verwirft.
+    Lazy_DFA* lazy_dfa;
+};
+
+struct Regen_Iterator {
+    Match_Scan scan;
+    const uint8_t* data;
+    size_t length;
+    size_t fed;
+    // Die sortierten Matches des zuletzt gelesenen Fensters, ab next_pending noch nicht abgeholt.
+    VLA* pending;
+    size_t next_pending;
+};
+
+// Ein Thread sucht nur Matches, die in seinem Stück anfangen, liest aber bis zum Ende der Eingabe weiter,
+// damit auch Matches über die Stückgrenze hinaus vollständig gefunden werden.
 typedef struct {
-    size_t node_index;
+    Compiled_Regex* compiled;
+    Lazy_DFA* lazy_dfa;
+    const uint8_t* data;
     size_t length;
-} PartialMatch;
-
-VLA** setup_cycle_guards(Compact_NFA* nfa);
-void clear_cycle_guards(VLA** guards, size_t guard_count);
-bool would_enter_infinite_loop(VLA* cycle_guard, PartialMatch* match, Compact_Edge* edge);
-bool matches_edge(char* position, Compact_Edge* edge);
-PartialMatch* take_matching_edge(PartialMatch* current_match, Compact_Edge* edge);
-
-VLA** setup_cycle_guards(Compact_NFA* nfa) {
-    VLA** cycle_guards = calloc(nfa->node_count, sizeof(VLA*));
-    bool* visited_nodes = calloc(nfa->node_count, sizeof(bool));
-    Stack* node_indices = stack_initialize(nfa->node_count, sizeof(size_t));
-    stack_push(node_indices, &nfa->start_node_index);
-
-    while (VLA_get_length(node_indices) > 0) {
-        size_t current_index = *(size_t*)stack_pop(node_indices);
-        Compact_Node current_node = nfa->nodes[current_index];
-        visited_nodes[current_index] = true;
-
-        for (size_t edge_index = 0; edge_index < current_node.edge_count; edge_index++) {
-            Compact_Edge current_edge = current_node.edges[edge_index];
-            if (current_edge.match_length > 0) continue;
-            if (visited_nodes[current_edge.endpoint]) {
-                cycle_guards[current_edge.endpoint] = VLA_initialize(1, sizeof(size_t));
-            } else {
-                stack_push(node_indices, &current_edge.endpoint);
-            }
+    size_t offset;
+    size_t start_limit;
+    VLA* matches;
+} Chunk_Job;
+
+void record_compile_error(Regen_Compile_Error error, size_t pattern);
+void initialize_lazy_dfas(Compiled_Regex* compiled);
+Compiled_Regex* share_compiled_regex(Compiled_Regex* original);
+void initialize_match_scan(Match_Scan* scan, Compiled_Regex* compiled, Lazy_DFA* lazy_dfa);
+void feed_match_scan(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, size_t start_limit, VLA* matches);
+void feed_unlimited_scan(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, size_t start_limit, VLA* matches);
+bool has_call_limits(Regen_Options* options);
+size_t get_scan_steps(Match_Scan* scan);
+size_t match_scan_memory(Match_Scan* scan, VLA* matches);
+bool check_scan_limits(Match_Scan* scan, VLA* matches, size_t new_matches);
+void keep_allowed_matches(Match_Scan* scan, VLA* matches, size_t first_new_match);
+void feed_engine(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, size_t start_limit, VLA* matches);
+void feed_selecting_scan(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, VLA* matches);
+void keep_unsettled_bytes(Match_Scan* scan, const uint8_t* data, size_t data_offset, size_t length);
+void free_match_scan(Match_Scan* scan);
+void* scan_chunk(void* argument);
+void find_matches_in_parallel(Compiled_Regex* compiled, const uint8_t* data, size_t length, size_t thread_count, VLA* matches);
+void find_matches(Compiled_Regex* compiled, const uint8_t* data, size_t length, VLA* matches);
+
+Regen_Options regen_default_options() {
+    Regen_Options options = {
+        .engine = engine_auto,
+        .dfa_cache_size = DEFAULT_DFA_CACHE_SIZE,
+        .dfa_state_limit = DEFAULT_DFA_STATE_LIMIT,
+        .thread_count = 1,
+        .match_mode = match_all,
+        .captures = false,
+        .multiline = false,
+        .max_states = GENERATED_NODE_LIMIT,
+        .max_matches = 0,
+        .max_steps = 0,
+        .max_memory = 0,
+    };
+    return options;
+}
+
+// Wie errno pro Thread, damit sich gleichzeitige Übersetzungen nicht gegenseitig überschreiben.
+static _Thread_local Regen_Compile_Error last_compile_error = regen_compile_ok;
+static _Thread_local size_t last_error_pattern = 0;
+
+void record_compile_error(Regen_Compile_Error error, size_t pattern) {
+    last_compile_error = error;
+    last_error_pattern = pattern;
+}
+
+Regen_Compile_Error regen_compile_error() {
+    return last_compile_error;
+}
+
+size_t regen_compile_error_pattern() {
+    return last_error_pattern;
+}
+
+const char* regen_compile_error_message(Regen_Compile_Error error) {
+    switch (error) {
+        case regen_compile_ok: return "compiled without errors";
+        case regen_syntax_error: return "is not a syntactically correct regex";
+        case regen_too_many_states: return "needs more than max_states states";
+        case regen_too_many_dfa_states: return "needs more than dfa_state_limit DFA states";
+        case regen_unsupported: return "uses a feature this function doesn't support";
+    }
+    return "failed to compile";
+}
+
+Compiled_Regex* regen_compile(char* regex) {
+    Regen_Options options = regen_default_options();
+    return regen_compile_with_options(regex, &options);
+}
+
+Compiled_Regex* regen_compile_with_options(char* regex, Regen_Options* options) {
+    record_compile_error(regen_compile_ok, 0);
+    ParserState* state = parse_regex(regex);
+    if (state->invalid) {
+        record_compile_error(regen_syntax_error, 0);
+        free_parser_state(state);
+        return NULL;
+    }
+
+    NFA* nfa = generate_nfa_from_parsed_regex(state, options->max_states);
+    if (nfa == NULL) {
+        record_compile_error(regen_too_many_states, 0);
+        return NULL;
+    }
+    // FIXME: Bin mir nicht sicher, ob der kompakte VLA wirklich einen großen Unterschied in der Geschwindigkeit ausmacht.
+    // Und selbst falls es schneller ist, ob es den Aufwand ausgleicht, alles doppelt implementieren zu müssen.
+    Compiled_Regex* compiled = malloc(sizeof(Compiled_Regex));
+    Compact_NFA* generated = compact_generated_NFA(nfa);
+    compiled->tagged_nfa = NULL;
+    compiled->capture_vm = NULL;
+    compiled->has_assertions = has_assertions(generated);
+    if (options->captures || compiled->has_assertions) {
+        compiled->tagged_nfa = copy_compact_nfa(generated);
+        compiled->capture_vm = initialize_capture_vm(compiled->tagged_nfa, options);
+    }
+    compiled->nfa = remove_empty_edges(generated);
+    if (options->match_mode == match_leftmost_first) drop_edges_after_match(compiled->nfa);
+    compiled->closures = compute_epsilon_closures(compiled->nfa);
+    compiled->prefilter = build_prefilter(compiled->nfa, compiled->closures);
+    compiled->options = *options;
+    compiled->status = regen_ok;
+    compiled->mapping = NULL;
+    compiled->shared_from = NULL;
+    if (compiled->options.thread_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        compiled->options.thread_count = cores > 0 ? cores : 1;
+    }
+    compiled->lazy_dfa = NULL;
+    compiled->full_dfa = NULL;
+    compiled->worker_dfas = NULL;
+    // Die DFAs kennen nur Mengen von NFA-Knoten, nicht deren Priorität.
+    if (options->match_mode == match_leftmost_first || compiled->has_assertions) compiled->options.engine = engine_pike_vm;
+    if (compiled->options.engine == engine_full_dfa) {
+        compiled->full_dfa = build_full_dfa(compiled->nfa, compiled->closures, options->dfa_state_limit);
+        if (compiled->full_dfa == NULL) {
+            record_compile_error(regen_too_many_dfa_states, 0);
+            regen_free(compiled);
+            return NULL;
         }
+    } else {
+        initialize_lazy_dfas(compiled);
     }
+    return compiled;
+}
+
+// Die Caches der Lazy-DFAs füllen sich erst beim Matchen, sie werden deshalb auch nie gespeichert.
+void initialize_lazy_dfas(Compiled_Regex* compiled) {
+    Regen_Options* options = &compiled->options;
+    if (options->engine == engine_pike_vm || options->engine == engine_full_dfa) return;
+    compiled->lazy_dfa = initialize_lazy_dfa(compiled->nfa, compiled->closures, options->dfa_cache_size);
+    if (options->thread_count > 1 && options->match_mode == match_all) {
+        compiled->worker_dfas = malloc((options->thread_count - 1) * sizeof(Lazy_DFA*));
+        for (size_t worker = 0; worker < options->thread_count - 1; worker++) {
+            compiled->worker_dfas[worker] = initialize_lazy_dfa(compiled->nfa, compiled->closures, options->dfa_cache_size);
+        }
+    }
+}
+
+// Die Automaten und der Prefilter ändern sich nach dem Übersetzen nicht mehr, nur die Caches der Lazy-DFAs und die
+// Capture_VM schreiben beim Matchen. Die Kopie bekommt davon eigene und darf deshalb gleichzeitig mit original
+// benutzt werden. Sie muss vor original freigegeben werden. Gelesen werden nur Felder, die beim Matchen niemand
+// schreibt, status etwa nicht.
+Compiled_Regex* share_compiled_regex(Compiled_Regex* original) {
+    Compiled_Regex* copy = malloc(sizeof(Compiled_Regex));
+    copy->nfa = original->nfa;
+    copy->closures = original->closures;
+    copy->prefilter = original->prefilter;
+    copy->full_dfa = original->full_dfa;
+    copy->tagged_nfa = original->tagged_nfa;
+    copy->options = original->options;
+    copy->has_assertions = original->has_assertions;
+    copy->status = regen_ok;
+    copy->mapping = NULL;
+    copy->mapping_length = 0;
+    copy->shared_from = original;
+    copy->capture_vm = NULL;
+    if (copy->tagged_nfa != NULL) copy->capture_vm = initialize_capture_vm(copy->tagged_nfa, &copy->options);
+    copy->lazy_dfa = NULL;
+    copy->worker_dfas = NULL;
+    initialize_lazy_dfas(copy);
+    return copy;
+}
 
-    free(visited_nodes);
-    VLA_free(node_indices);
-    return cycle_guards;
+bool regen_save(Compiled_Regex* compiled, const char* path) {
+    Automaton_Parts parts = {
+        .nfa = compiled->nfa,
+        .closures = compiled->closures,
+        .prefilter = compiled->prefilter,
+        .full_dfa = compiled->full_dfa,
+        .tagged_nfa = compiled->tagged_nfa,
+        .options = compiled->options,
+        .has_assertions = compiled->has_assertions,
+    };
+    return save_automaton(&parts, path);
 }
 
-void clear_cycle_guards(VLA** guards, size_t guard_count) {
-    for (size_t index = 0; index < guard_count; index++) {
-        if (guards[index] == NULL) continue;
-        VLA_clear(guards[index]);
+Compiled_Regex* regen_load(const char* path) {
+    Automaton_Parts parts;
+    size_t mapping_length;
+    void* mapping = load_automaton(path, &parts, &mapping_length);
+    if (mapping == NULL) return NULL;
+
+    Compiled_Regex* compiled = malloc(sizeof(Compiled_Regex));
+    compiled->nfa = parts.nfa;
+    compiled->closures = parts.closures;
+    compiled->prefilter = parts.prefilter;
+    compiled->full_dfa = parts.full_dfa;
+    compiled->tagged_nfa = parts.tagged_nfa;
+    compiled->options = parts.options;
+    compiled->has_assertions = parts.has_assertions;
+    compiled->status = regen_ok;
+    compiled->mapping = mapping;
+    compiled->shared_from = NULL;
+    compiled->mapping_length = mapping_length;
+    compiled->capture_vm = NULL;
+    if (compiled->tagged_nfa != NULL) compiled->capture_vm = initialize_capture_vm(compiled->tagged_nfa, &compiled->options);
+    compiled->lazy_dfa = NULL;
+    compiled->worker_dfas = NULL;
+    initialize_lazy_dfas(compiled);
+    return compiled;
+}
+
+void regen_free(Compiled_Regex* compiled) {
+    if (compiled == NULL) return;
+    if (compiled->lazy_dfa != NULL) free_lazy_dfa(compiled->lazy_dfa);
+    if (compiled->worker_dfas != NULL) {
+        for (size_t worker = 0; worker < compiled->options.thread_count - 1; worker++) free_lazy_dfa(compiled->worker_dfas[worker]);
+        free(compiled->worker_dfas);
+    }
+    if (compiled->capture_vm != NULL) free_capture_vm(compiled->capture_vm);
+    if (compiled->shared_from != NULL) {
+        free(compiled);
+        return;
     }
+    if (compiled->mapping != NULL) {
+        Automaton_Parts parts = {
+            .nfa = compiled->nfa,
+            .closures = compiled->closures,
+            .full_dfa = compiled->full_dfa,
+            .tagged_nfa = compiled->tagged_nfa,
+        };
+        free_loaded_automaton(&parts, compiled->mapping, compiled->mapping_length);
+        free(compiled);
+        return;
+    }
+    if (compiled->full_dfa != NULL) free_full_dfa(compiled->full_dfa);
+    if (compiled->tagged_nfa != NULL) free_compact_nfa(compiled->tagged_nfa);
+    free_prefilter(compiled->prefilter);
+    free_epsilon_closures(compiled->closures);
+    free_compact_nfa(compiled->nfa);
+    free(compiled);
 }
 
-bool would_enter_infinite_loop(VLA* cycle_guard, PartialMatch* match, Compact_Edge* edge) {
-    if (cycle_guard == NULL) return false;
-    if (edge->match_length > 0) return false;
+void initialize_match_scan(Match_Scan* scan, Compiled_Regex* compiled, Lazy_DFA* lazy_dfa) {
+    scan->compiled = compiled;
+    scan->full_scan = NULL;
+    scan->lazy_scan = NULL;
+    scan->vm = NULL;
+    scan->offset = 0;
+    scan->carry = NULL;
+    scan->carry_offset = 0;
+    scan->base = NULL;
+    scan->steps = 0;
+    scan->reported = 0;
+    scan->status = regen_ok;
+
+    Regen_Match_Mode mode = compiled->options.match_mode;
+    Match_Selection* selection = mode == match_all ? NULL : &scan->selection;
+    if (selection != NULL) {
+        reset_match_selection(selection, mode);
+        scan->carry = VLA_initialize(16, sizeof(uint8_t));
+    }
 
-    for (size_t cycle_entry_index = 0; cycle_entry_index < VLA_get_length(cycle_guard); cycle_entry_index++) {
-        size_t cycle_entry = *(size_t*)VLA_get(cycle_guard, cycle_entry_index);
-        if (match->length == cycle_entry) return true;
+    if (compiled->full_dfa != NULL) {
+        scan->full_scan = initialize_full_dfa_scan(compiled->full_dfa);
+        full_dfa_scan_select_matches(scan->full_scan, selection);
+    } else if (lazy_dfa != NULL) {
+        scan->lazy_scan = initialize_dfa_scan(lazy_dfa);
+        dfa_scan_select_matches(scan->lazy_scan, selection);
+    } else {
+        scan->vm = initialize_pike_vm(compiled->nfa, compiled->closures);
+        pike_vm_select_matches(scan->vm, selection);
     }
-    return false;
 }
 
-bool matches_edge(char* position, Compact_Edge* edge) {
-    if (strlen(position) < edge->match_length) return false;
-    return !memcmp(edge->matches, position, edge->match_length);
+// Ab data[start_limit] fangen keine Matches mehr an, SIZE_MAX heißt ohne Grenze. Das geht nur bei match_all.
+// Nachdem eine Grenze erreicht wurde, liest der Scan nichts mehr.
+void feed_match_scan(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, size_t start_limit, VLA* matches) {
+    if (scan->status != regen_ok) return;
+    if (!has_call_limits(&scan->compiled->options)) {
+        feed_unlimited_scan(scan, data, length, final_chunk, start_limit, matches);
+        return;
+    }
+
+    // Die Engines selbst kennen keine Grenzen. Zwischen zwei Fenstern kann aber jede Engine aufhören und später
+    // weiterlesen, so wie bei einem Stream.
+    size_t first_new_match = VLA_get_length(matches);
+    size_t window_size = MIN_LIMIT_WINDOW;
+    while (true) {
+        size_t window = length < window_size ? length : window_size;
+        size_t matches_before = VLA_get_length(matches);
+        size_t steps_before = get_scan_steps(scan);
+        feed_unlimited_scan(scan, data, window, final_chunk && window == length, start_limit, matches);
+        scan->steps += window + VLA_get_length(matches) - matches_before;
+        bool cheap = get_scan_steps(scan) - steps_before <= 4 * window;
+        window_size = cheap && window_size < MAX_LIMIT_WINDOW ? 2 * window_size : cheap ? window_size : MIN_LIMIT_WINDOW;
+        data += window;
+        length -= window;
+        if (start_limit != SIZE_MAX) start_limit = start_limit > window ? start_limit - window : 0;
+        if (check_scan_limits(scan, matches, VLA_get_length(matches) - first_new_match) || length == 0) break;
+    }
 }
 
-PartialMatch* take_matching_edge(PartialMatch* current_match, Compact_Edge* edge) {
-    PartialMatch* advanced = calloc(1, sizeof(PartialMatch));
-    advanced->length = current_match->length + edge->match_length;
-    advanced->node_index = edge->endpoint;
+void feed_unlimited_scan(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, size_t start_limit, VLA* matches) {
+    if (scan->compiled->options.match_mode != match_all) {
+        feed_selecting_scan(scan, data, length, final_chunk, matches);
+        return;
+    }
+    feed_engine(scan, data, length, final_chunk, start_limit, matches);
+}
+
+void feed_engine(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, size_t start_limit, VLA* matches) {
+    Prefilter* prefilter = scan->compiled->prefilter;
+    size_t offset = scan->offset;
+    scan->offset += length;
+
+    if (scan->full_scan != NULL) {
+        full_dfa_feed(scan->full_scan, prefilter, data, length, offset, final_chunk, start_limit, matches);
+        return;
+    }
+
+    if (scan->lazy_scan != NULL) {
+        size_t consumed;
+        if (lazy_dfa_feed(scan->lazy_scan, prefilter, data, length, offset, final_chunk, start_limit, matches, &scan->vm, &consumed)) {
+            return;
+        }
+
+        // Die Pike VM hat alle Lanes der Lazy-DFA übernommen und liest ab dem nächsten Byte weiter.
+        free_dfa_scan(scan->lazy_scan);
+        scan->lazy_scan = NULL;
+        data += consumed;
+        length -= consumed;
+        offset += consumed;
+        start_limit = start_limit > consumed ? start_limit - consumed : 0;
+    }
 
-    return advanced;
+    pike_vm_feed(scan->vm, prefilter, data, length, offset, final_chunk, start_limit, matches);
 }
 
-Match* match(char* to_match, char* regex, size_t* matches_count) {
-    ParserState* state = parse_regex(regex);
-    if (state->invalid) {
-        printf("%s is not a syntactically correct regex.\n", regex);
-        return 0;
+// Jede Engine beendet die Suche, sobald der beste Match feststeht. Dann wird er gemeldet und die nächste Suche
+// beginnt an seinem Ende, auch wenn das in Bytes liegt, die schon ein früherer Aufruf gelesen hat.
+void feed_selecting_scan(Match_Scan* scan, const uint8_t* data, size_t length, bool final_chunk, VLA* matches) {
+    Match_Selection* selection = &scan->selection;
+    size_t data_offset = scan->offset;
+    size_t restart = data_offset;
+
+    while (true) {
+        if (restart < data_offset && scan->base != NULL) {
+            feed_engine(scan, scan->base + restart, data_offset + length - restart, final_chunk, SIZE_MAX, matches);
+        } else if (restart < data_offset) {
+            feed_engine(scan, VLA_get(scan->carry, restart - scan->carry_offset), data_offset - restart, false, SIZE_MAX, matches);
+            if (!selection->finished) feed_engine(scan, data, length, final_chunk, SIZE_MAX, matches);
+        } else {
+            feed_engine(scan, data + (restart - data_offset), length - (restart - data_offset), final_chunk, SIZE_MAX, matches);
+        }
+        if (!selection->finished) break;
+
+        Match* match = (Match*)VLA_reserve_next_slots(matches, 1);
+        match->offset = selection->best_start;
+        match->length = selection->best_end - selection->best_start;
+        // Nach einem leeren Match geht es ein Byte weiter, sonst würde er immer wieder gefunden.
+        restart = selection->best_end > selection->best_start ? selection->best_end : selection->best_start + 1;
+        reset_match_selection(selection, selection->mode);
+        scan->offset = restart;
     }
 
-    NFA* nfa = generate_nfa_from_parsed_regex(state);
-    // FIXME: Bin mir nicht sicher, ob der kompakte VLA wirklich einen großen Unterschied in der Geschwindigkeit ausmacht.
-    // Und selbst falls es schneller ist, ob es den Aufwand ausgleicht, alles doppelt implementieren zu müssen.
-    Compact_NFA* compacted = compact_generated_NFA(nfa);
+    if (!final_chunk && scan->base == NULL) keep_unsettled_bytes(scan, data, data_offset, length);
+}
+
+bool has_call_limits(Regen_Options* options) {
+    return options->max_matches > 0 || options->max_steps > 0 || options->max_memory > 0;
+}
+
+size_t get_scan_steps(Match_Scan* scan) {
+    return scan->steps + (scan->vm != NULL ? pike_vm_steps(scan->vm) : 0);
+}
+
+// Was während der Suche wächst, die Automaten und der Cache der Lazy-DFA zählen nicht.
+size_t match_scan_memory(Match_Scan* scan, VLA* matches) {
+    size_t memory = matches->capacity;
+    if (scan->carry != NULL) memory += scan->carry->capacity;
+    if (scan->full_scan != NULL) memory += full_dfa_scan_memory(scan->full_scan);
+    if (scan->lazy_scan != NULL) memory += dfa_scan_memory(scan->lazy_scan);
+    if (scan->vm != NULL) memory += pike_vm_memory(scan->vm);
+    return memory;
+}
+
+// Merkt sich den Grund und gibt true zurück, sobald eine der Grenzen erreicht ist. Erst bei einem Match zu viel
+// steht fest, dass es mehr als max_matches gibt.
+bool check_scan_limits(Match_Scan* scan, VLA* matches, size_t new_matches) {
+    Regen_Options* options = &scan->compiled->options;
+    size_t steps = get_scan_steps(scan);
+    if (options->max_matches > 0 && scan->reported + new_matches > options->max_matches) {
+        scan->status = regen_match_limit;
+    } else if (options->max_steps > 0 && steps > options->max_steps) {
+        scan->status = regen_step_limit;
+    } else if (options->max_memory > 0 && match_scan_memory(scan, matches) > options->max_memory) {
+        scan->status = regen_memory_limit;
+    }
+    return scan->status != regen_ok;
+}
 
-    Stack* partial_matches = stack_initialize(5, sizeof(PartialMatch*));
+// Nach dem Sortieren bleiben von den neuen Matches höchstens so viele, wie max_matches noch zulässt.
+void keep_allowed_matches(Match_Scan* scan, VLA* matches, size_t first_new_match) {
+    size_t max_matches = scan->compiled->options.max_matches;
+    if (max_matches > 0) VLA_truncate(matches, first_new_match + (max_matches - scan->reported));
+    scan->reported += VLA_get_length(matches) - first_new_match;
+    scan->compiled->status = scan->status;
+}
+
+// Ohne Kandidaten beginnt die nächste Suche erst hinter den gelesenen Bytes, dann muss nichts aufgehoben werden.
+void keep_unsettled_bytes(Match_Scan* scan, const uint8_t* data, size_t data_offset, size_t length) {
+    size_t end = data_offset + length;
+    size_t keep_from = scan->selection.best_start != NO_MATCH ? scan->selection.best_end : end;
+
+    VLA* kept = VLA_initialize(end - keep_from + 1, sizeof(uint8_t));
+    if (keep_from < data_offset) {
+        // Der Kandidat endet schon in einem früheren Stück, dessen Bytes noch in carry liegen.
+        VLA_batch_append(kept, VLA_get(scan->carry, keep_from - scan->carry_offset), data_offset - keep_from);
+        VLA_batch_append(kept, (void*)data, length);
+    } else {
+        VLA_batch_append(kept, (void*)(data + (keep_from - data_offset)), end - keep_from);
+    }
+    VLA_free(scan->carry);
+    scan->carry = kept;
+    scan->carry_offset = keep_from;
+}
+
+void free_match_scan(Match_Scan* scan) {
+    if (scan->full_scan != NULL) free_full_dfa_scan(scan->full_scan);
+    if (scan->lazy_scan != NULL) free_dfa_scan(scan->lazy_scan);
+    if (scan->vm != NULL) free_pike_vm(scan->vm);
+    if (scan->carry != NULL) VLA_free(scan->carry);
+}
+
+void* scan_chunk(void* argument) {
+    Chunk_Job* job = argument;
+    Match_Scan scan;
+    initialize_match_scan(&scan, job->compiled, job->lazy_dfa);
+    scan.offset = job->offset;
+    feed_match_scan(&scan, job->data, job->length, true, job->start_limit, job->matches);
+    free_match_scan(&scan);
+    sort_matches(job->matches, 0);
+    return NULL;
+}
+
+// Jedes Stück hat nur Matches, die in ihm anfangen. Sortiert man sie einzeln und hängt sie in der Reihenfolge
+// der Stücke aneinander, kommt also dasselbe heraus wie mit einem Thread.
+void find_matches_in_parallel(Compiled_Regex* compiled, const uint8_t* data, size_t length, size_t thread_count, VLA* matches) {
+    Chunk_Job jobs[thread_count];
+    pthread_t threads[thread_count];
+    bool started[thread_count];
+    size_t chunk_length = (length + thread_count - 1) / thread_count;
+    for (size_t chunk = 0; chunk < thread_count; chunk++) {
+        size_t begin = chunk * chunk_length < length ? chunk * chunk_length : length;
+        jobs[chunk] = (Chunk_Job){
+            .compiled = compiled,
+            .lazy_dfa = chunk == 0 ? compiled->lazy_dfa : (compiled->worker_dfas != NULL ? compiled->worker_dfas[chunk - 1] : NULL),
+            .data = data + begin,
+            .length = length - begin,
+            .offset = begin,
+            .start_limit = chunk_length,
+            .matches = VLA_initialize(5, sizeof(Match)),
+        };
+        started[chunk] = false;
+    }
+
+    // Den ersten Chunk übernimmt der aufrufende Thread selbst. Startet ein Thread nicht, wird sein Stück danach hier durchsucht.
+    for (size_t chunk = 1; chunk < thread_count; chunk++) {
+        started[chunk] = pthread_create(&threads[chunk], NULL, scan_chunk, &jobs[chunk]) == 0;
+    }
+    scan_chunk(&jobs[0]);
+    for (size_t chunk = 1; chunk < thread_count; chunk++) {
+        if (started[chunk]) pthread_join(threads[chunk], NULL);
+        else scan_chunk(&jobs[chunk]);
+    }
+
+    for (size_t chunk = 0; chunk < thread_count; chunk++) {
+        size_t count = VLA_get_length(jobs[chunk].matches);
+        if (count > 0) memcpy(VLA_reserve_next_slots(matches, count), jobs[chunk].matches->data, count * sizeof(Match));
+        VLA_free(jobs[chunk].matches);
+    }
+}
+
+void find_matches(Compiled_Regex* compiled, const uint8_t* data, size_t length, VLA* matches) {
+    compiled->status = regen_ok;
+    if (compiled->has_assertions) {
+        compiled->status = capture_vm_find_matches(compiled->capture_vm, compiled->prefilter, data, length, false, matches);
+        return;
+    }
+
+    size_t thread_count = compiled->options.thread_count;
+    bool parallel = compiled->options.match_mode == match_all && !has_call_limits(&compiled->options);
+    if (thread_count > 1 && parallel && length >= thread_count * MIN_BYTES_PER_THREAD) {
+        find_matches_in_parallel(compiled, data, length, thread_count, matches);
+        return;
+    }
+
+    Match_Scan scan;
+    size_t first_new_match = VLA_get_length(matches);
+    initialize_match_scan(&scan, compiled, compiled->lazy_dfa);
+    scan.base = data;
+    feed_match_scan(&scan, data, length, true, SIZE_MAX, matches);
+    // Die Matches werden nach ihrem Ende gefunden, der Aufrufer erwartet sie aber nach Offset sortiert.
+    sort_matches(matches, first_new_match);
+    keep_allowed_matches(&scan, matches, first_new_match);
+    free_match_scan(&scan);
+}
+
+Match* regen_exec(Compiled_Regex* compiled, char* to_match, size_t* matches_count) {
+    return regen_exec_bytes(compiled, (const uint8_t*)to_match, strlen(to_match), matches_count);
+}
+
+Match* regen_exec_bytes(Compiled_Regex* compiled, const uint8_t* data, size_t length, size_t* matches_count) {
     VLA* matches = VLA_initialize(5, sizeof(Match));
-    VLA** cycle_guards = setup_cycle_guards(compacted);
-
-    for (size_t offset = 0; offset < strlen(to_match); offset++) {
-        PartialMatch* start = calloc(1, sizeof(PartialMatch));
-        start->length = 0;
-        start->node_index = compacted->start_node_index;
-        stack_push(partial_matches, &start);
-
-        while (VLA_get_length(partial_matches) > 0) {
-            PartialMatch* current_match = *(PartialMatch**)stack_pop(partial_matches);
-
-            if (current_match->node_index == compacted->stop_node_index) {
-                Match* match = (Match*)VLA_reserve_next_slots(matches, 1);
-                match->offset = offset;
-                match->length = current_match->length;
-            }
-
-            if (offset + current_match->length > strlen(to_match)) continue;
-            char* matching_position = to_match + offset + current_match->length;
-
-            for (size_t edge_index = 0; edge_index < compacted->nodes[current_match->node_index].edge_count; edge_index++) {
-                Compact_Edge* current_edge = &compacted->nodes[current_match->node_index].edges[edge_index];
-                if (matches_edge(matching_position, current_edge)) {
-                    VLA* responsible_guard = cycle_guards[current_edge->endpoint];
-                    if (would_enter_infinite_loop(responsible_guard, current_match, current_edge)) continue;
-                    PartialMatch* advanced_match = take_matching_edge(current_match, current_edge);
-                    if (cycle_guards[advanced_match->node_index] != NULL) VLA_append(cycle_guards[advanced_match->node_index], &advanced_match->length);
-                    stack_push(partial_matches, &advanced_match);
-                }
-            }
-            free(current_match);
-        }
+    find_matches(compiled, data, length, matches);
+
+    *matches_count = VLA_get_length(matches);
+    return (Match*)VLA_extract(matches);
+}
+
+Regen_Status regen_status(Compiled_Regex* compiled) {
+    return compiled->status;
+}
+
+size_t regen_group_count(Compiled_Regex* compiled) {
+    return compiled->nfa->group_count;
+}
+
+Match* regen_exec_captures(Compiled_Regex* compiled, const uint8_t* data, size_t length, size_t* matches_count) {
+    *matches_count = 0;
+    if (!compiled->options.captures) {
+        warn("regen_exec_captures needs a regex compiled with the captures option.\n");
+        return NULL;
+    }
+
+    size_t entries_per_match = regen_group_count(compiled) + 1;
+    VLA* matches = VLA_initialize(5 * entries_per_match, sizeof(Match));
+    compiled->status = capture_vm_find_matches(compiled->capture_vm, compiled->prefilter, data, length, true, matches);
 
-        clear_cycle_guards(cycle_guards, compacted->node_count);
+    *matches_count = VLA_get_length(matches) / entries_per_match;
+    return (Match*)VLA_extract(matches);
+}
+
+Match* match(char* to_match, char* regex, size_t* matches_count) {
+    return match_bytes((const uint8_t*)to_match, strlen(to_match), regex, matches_count);
+}
+
+Match* match_bytes(const uint8_t* data, size_t length, char* regex, size_t* matches_count) {
+    // Bei einem Treffer im Cache wird nicht übersetzt, der Fehler eines früheren Aufrufs darf aber nicht stehen bleiben.
+    record_compile_error(regen_compile_ok, 0);
+    Cache_Entry* entry;
+    Compiled_Regex* compiled = acquire_cached_regex(regex, &entry);
+    if (compiled == NULL) {
+        *matches_count = 0;
+        return NULL;
     }
 
-    VLA_free(partial_matches);
-    for (size_t delete_index = 0; delete_index < compacted->node_count; delete_index++) {
-        if (cycle_guards[delete_index] == NULL) continue;
-        VLA_free(cycle_guards[delete_index]);
+    Match* matches = regen_exec_bytes(compiled, data, length, matches_count);
+    release_cached_regex(compiled, entry);
+    return matches;
+}
+
+Regen_Stream* regen_stream_open(Compiled_Regex* compiled) {
+    // $ am Ende eines Stücks hängt davon ab, ob noch eines kommt, und die Capture_VM braucht die ganze Eingabe.
+    if (compiled->has_assertions) {
+        warn("Streams don't support regexes with assertions.\n");
+        return NULL;
     }
-    free(cycle_guards);
-    free_compact_nfa(compacted);
+    Regen_Stream* stream = malloc(sizeof(Regen_Stream));
+    stream->lazy_dfa = NULL;
+    if (compiled->lazy_dfa != NULL) {
+        stream->lazy_dfa = initialize_lazy_dfa(compiled->nfa, compiled->closures, compiled->options.dfa_cache_size);
+    }
+    initialize_match_scan(&stream->scan, compiled, stream->lazy_dfa);
+    return stream;
+}
+
+Match* regen_stream_feed(Regen_Stream* stream, const uint8_t* chunk, size_t length, size_t* matches_count) {
+    VLA* matches = VLA_initialize(5, sizeof(Match));
+    feed_match_scan(&stream->scan, chunk, length, false, SIZE_MAX, matches);
+    sort_matches(matches, 0);
+    keep_allowed_matches(&stream->scan, matches, 0);
 
     *matches_count = VLA_get_length(matches);
     return (Match*)VLA_extract(matches);
+}
+
+Match* regen_stream_end(Regen_Stream* stream, size_t* matches_count) {
+    VLA* matches = VLA_initialize(5, sizeof(Match));
+    feed_match_scan(&stream->scan, (const uint8_t*)"", 0, true, SIZE_MAX, matches);
+    sort_matches(matches, 0);
+    keep_allowed_matches(&stream->scan, matches, 0);
+
+    *matches_count = VLA_get_length(matches);
+    return (Match*)VLA_extract(matches);
+}
+
+void regen_stream_finish(Regen_Stream* stream) {
+    free_match_scan(&stream->scan);
+    if (stream->lazy_dfa != NULL) free_lazy_dfa(stream->lazy_dfa);
+    free(stream);
+}
+
+Regen_Iterator* regen_iterator_open(Compiled_Regex* compiled, const uint8_t* data, size_t length) {
+    Regen_Iterator* iterator = malloc(sizeof(Regen_Iterator));
+    initialize_match_scan(&iterator->scan, compiled, compiled->lazy_dfa);
+    iterator->scan.base = data;
+    iterator->data = data;
+    iterator->length = length;
+    iterator->fed = 0;
+    iterator->pending = VLA_initialize(64, sizeof(Match));
+    iterator->next_pending = 0;
+    // Die Capture_VM liest die Daten nicht in Fenstern, dann gibt es nur ein einziges.
+    compiled->status = regen_ok;
+    if (compiled->has_assertions) {
+        iterator->scan.status = capture_vm_find_matches(compiled->capture_vm, compiled->prefilter, data, length, false, iterator->pending);
+        compiled->status = iterator->scan.status;
+        iterator->fed = length;
+    }
+    return iterator;
+}
+
+bool regen_next(Regen_Iterator* iterator, Match* match) {
+    // Ein Fenster kann ohne Matches bleiben, dann geht es mit dem nächsten weiter.
+    while (iterator->next_pending == VLA_get_length(iterator->pending)) {
+        if (iterator->fed == iterator->length || iterator->scan.status != regen_ok) return false;
+        VLA_clear(iterator->pending);
+        iterator->next_pending = 0;
+
+        size_t window = iterator->length - iterator->fed < REGEN_ITERATOR_WINDOW ? iterator->length - iterator->fed : REGEN_ITERATOR_WINDOW;
+        bool final_window = iterator->fed + window == iterator->length;
+        feed_match_scan(&iterator->scan, iterator->data + iterator->fed, window, final_window, SIZE_MAX, iterator->pending);
+        iterator->fed += window;
+        sort_matches(iterator->pending, 0);
+        keep_allowed_matches(&iterator->scan, iterator->pending, 0);
+    }
+
+    *match = *(Match*)VLA_get(iterator->pending, iterator->next_pending++);
+    return true;
+}
+
+void regen_iterator_finish(Regen_Iterator* iterator) {
+    free_match_scan(&iterator->scan);
+    VLA_free(iterator->pending);
+    free(iterator);
+}
+
+size_t regen_exec_callback(Compiled_Regex* compiled, const uint8_t* data, size_t length, Regen_Match_Callback on_match, void* user_data) {
+    Regen_Iterator* iterator = regen_iterator_open(compiled, data, length);
+    size_t reported = 0;
+    Match current;
+    while (regen_next(iterator, &current)) {
+        reported++;
+        if (on_match(current.offset, current.length, user_data) == scan_stop) break;
+    }
+    regen_iterator_finish(iterator);
+    return reported;
+}
+
+bool regen_generate_c(Compiled_Regex* compiled, const char* function_name, FILE* output) {
+    // Wie bei engine_full_dfa kennt der DFA weder die Reihenfolge der Kanten noch die Bytes um eine Position.
+    record_compile_error(regen_compile_ok, 0);
+    if (compiled->options.match_mode == match_leftmost_first || compiled->has_assertions) {
+        record_compile_error(regen_unsupported, 0);
+        return false;
+    }
+    Full_DFA* dfa = compiled->full_dfa;
+    if (dfa == NULL) dfa = build_full_dfa(compiled->nfa, compiled->closures, compiled->options.dfa_state_limit);
+    if (dfa == NULL) {
+        record_compile_error(regen_too_many_dfa_states, 0);
+        return false;
+    }
+
+    write_c_matcher(dfa, compiled->options.match_mode, function_name, output);
+    if (dfa != compiled->full_dfa) free_full_dfa(dfa);
+    return true;
 }
\ No newline at end of file
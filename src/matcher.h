@@ -1,8 +1,228 @@
+#ifndef MATCHER_H
+#define MATCHER_H
+
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
 
 typedef struct {
     size_t offset;
     size_t length;
 } Match;
 
-Match* match(char* to_match, char* regex, size_t* matches_count);
\ No newline at end of file
+// Ein einmal übersetzter Regex, der beliebig oft zum Matchen benutzt werden kann.
+// Ein Compiled_Regex darf nicht von mehreren Threads gleichzeitig benutzt werden.
+typedef struct Compiled_Regex Compiled_Regex;
+
+typedef enum {
+    engine_auto = 0,
+    engine_pike_vm = 1,
+    engine_lazy_dfa = 2,
+    engine_full_dfa = 3,
+} Regen_Engine;
+
+// Welche Matches gemeldet werden. Außer bei match_all überlappen sich die Matches nie: Jede Suche meldet den Match,
+// der am weitesten links anfängt, die nächste beginnt an seinem Ende (nach einem leeren Match ein Byte dahinter).
+typedef enum {
+    // Jede (Offset, Länge)-Kombination, die auf den Regex passt.
+    match_all = 0,
+    // Von den Matches mit dem kleinsten Offset der längste, wie bei POSIX.
+    match_leftmost_longest = 1,
+    // Von den Matches mit dem kleinsten Offset der, den ein Backtracking-Matcher wie Perl zuerst findet, mit einer
+    // Ausnahme: Perl bricht eine Schleife nach einem Durchlauf ab, der nichts verbraucht hat, hier wird so ein
+    // Durchlauf wie bei RE2 nur übersprungen. (a*|b)* auf "abab" ergibt deshalb (0, 4), bei Perl (0, 1).
+    // Dafür zählt die Reihenfolge der Kanten, deshalb läuft dieser Modus immer auf der Pike VM.
+    match_leftmost_first = 2,
+    // Von den Matches mit dem kleinsten Offset der kürzeste.
+    match_shortest = 3,
+} Regen_Match_Mode;
+
+// Warum der letzte Aufruf aufgehört hat. Ist eine Grenze aus Regen_Options erreicht, enthält das Ergebnis nur die
+// Matches, die bis dahin gefunden wurden.
+typedef enum {
+    regen_ok = 0,
+    regen_match_limit = 1,
+    regen_step_limit = 2,
+    regen_memory_limit = 3,
+} Regen_Status;
+
+typedef struct {
+    Regen_Engine engine;
+    // Maximale Größe des Zustandscaches der Lazy-DFA in Bytes. Läuft der Cache zu oft voll,
+    // wird für den Rest der Eingabe auf die Pike VM zurückgegriffen.
+    size_t dfa_cache_size;
+    // Mit engine_full_dfa wird der komplette minimierte DFA schon beim Übersetzen gebaut.
+    // Bräuchte er mehr Zustände als dfa_state_limit, schlägt regen_compile_with_options fehl.
+    size_t dfa_state_limit;
+    // Große Eingaben werden in so viele Stücke geteilt und parallel durchsucht, 0 heißt ein Thread pro Kern.
+    // Das Ergebnis ist dasselbe wie mit einem Thread.
+    size_t thread_count;
+    // Nicht überlappende Matches werden immer mit einem Thread gesucht, da jede Suche am Ende der vorigen beginnt.
+    Regen_Match_Mode match_mode;
+    // Nur dann behält der Compiled_Regex den Automaten mit den Gruppen, den regen_exec_captures braucht.
+    // Alle anderen Funktionen kümmern sich nie um Gruppen, ihnen kostet das also nichts.
+    bool captures;
+    // ^ und $ passen dann auch nach bzw. vor jedem \n, nicht nur am Anfang und Ende der Eingabe.
+    bool multiline;
+    // Grenzen für Regexe und Eingaben aus nicht vertrauenswürdigen Quellen. Braucht der generierte Automat mehr
+    // Zustände als max_states, schlägt regen_compile_with_options fehl.
+    size_t max_states;
+    // Die übrigen gelten pro Aufruf, 0 heißt jeweils ohne Grenze. Ein Schritt ist ein gelesenes Byte, ein
+    // gefundener Match oder ein Zustand, den die NFA-Simulation über ein Byte weiterschaltet. max_memory zählt,
+    // was während des Matchens wächst: die Matches, die Startpositionen und Threads der Engines und die
+    // aufgehobenen Bytes. Die Lazy-DFA begrenzt dfa_cache_size. Mit einer dieser Grenzen wird immer mit einem
+    // Thread gesucht.
+    size_t max_matches;
+    size_t max_steps;
+    size_t max_memory;
+} Regen_Options;
+
+// Warum das letzte regen_compile, regen_compile_with_options, regen_set_compile, match oder regen_generate_c des
+// aufrufenden Threads fehlgeschlagen ist. regen selbst schreibt dabei nichts aus, die Meldung ist Sache des Aufrufers.
+typedef enum {
+    regen_compile_ok = 0,
+    regen_syntax_error = 1,
+    // Der NFA bräuchte mehr als max_states Zustände.
+    regen_too_many_states = 2,
+    // Der DFA von engine_full_dfa oder regen_generate_c bräuchte mehr als dfa_state_limit Zustände.
+    regen_too_many_dfa_states = 3,
+    // ^, $ oder \b in regen_set_compile, bzw. zusätzlich match_leftmost_first in regen_generate_c.
+    regen_unsupported = 4,
+} Regen_Compile_Error;
+
+Regen_Options regen_default_options();
+// Übersetzt den Regex in einen Automaten. Gibt NULL zurück, falls der Regex syntaktisch falsch ist oder eine Grenze
+// aus den Optionen überschreitet, den Grund kennt dann regen_compile_error.
+Compiled_Regex* regen_compile(char* regex);
+Compiled_Regex* regen_compile_with_options(char* regex, Regen_Options* options);
+Match* regen_exec(Compiled_Regex* compiled, char* to_match, size_t* matches_count);
+// Wie regen_exec, aber für beliebige Bytes mit bekannter Länge, die auch Null-Bytes enthalten dürfen.
+Match* regen_exec_bytes(Compiled_Regex* compiled, const uint8_t* data, size_t length, size_t* matches_count);
+void regen_free(Compiled_Regex* compiled);
+// Speichert den übersetzten Automaten mit seinen Optionen in path. Gibt false zurück, falls das nicht geht.
+bool regen_save(Compiled_Regex* compiled, const char* path);
+// Blendet eine Datei von regen_save mit mmap ein und matcht direkt auf ihren Tabellen, ohne den Regex zu übersetzen.
+// Alle Prozesse, die dieselbe Datei laden, teilen sich deren Seiten im Page-Cache. Gibt NULL zurück, falls die
+// Datei fehlt, beschädigt ist oder von einer anderen Version von regen oder einer anderen Plattform stammt.
+Compiled_Regex* regen_load(const char* path);
+Regen_Compile_Error regen_compile_error();
+// Nach einem fehlgeschlagenen regen_set_compile der Index des Regex, an dem es lag.
+size_t regen_compile_error_pattern();
+// Eine kurze englische Beschreibung für Fehlermeldungen, z.B. "is not a syntactically correct regex".
+const char* regen_compile_error_message(Regen_Compile_Error error);
+// Warum der letzte Aufruf von regen_exec, regen_exec_bytes, regen_exec_captures, regen_next, regen_exec_callback
+// oder einer der Stream-Funktionen mit compiled aufgehört hat.
+Regen_Status regen_status(Compiled_Regex* compiled);
+
+// Offset einer Gruppe, die nicht am Match beteiligt war, wie (b) in (a)|(b) auf "a".
+#define REGEN_NO_GROUP SIZE_MAX
+
+// Anzahl der Gruppen (...) im Regex. Sie werden in der Reihenfolge ihrer öffnenden Klammern ab 1 gezählt.
+size_t regen_group_count(Compiled_Regex* compiled);
+// Wie regen_exec_bytes, aber jeder Match belegt regen_group_count + 1 Einträge: zuerst der ganze Match, dann jede
+// Gruppe mit ihrem Offset und ihrer Länge. Wiederholte Gruppen enthalten ihre letzte Wiederholung. Unter mehreren
+// Wegen zum selben Match zählt der, den ein Backtracking-Matcher wie Perl zuerst nimmt, außer dass leere Durchläufe
+// einer Schleife wie bei match_leftmost_first übersprungen werden, statt sie zu beenden. Der Regex muss mit
+// captures übersetzt worden sein, sonst gibt es NULL zurück. thread_count und engine spielen keine Rolle.
+Match* regen_exec_captures(Compiled_Regex* compiled, const uint8_t* data, size_t length, size_t* matches_count);
+
+// Matcht Daten, die stückweise ankommen, z.B. von einem Socket. Zwischen den Stücken bleibt nur der Zustand
+// des Automaten erhalten, die Stücke selbst werden nicht aufgehoben. Der Speicher wächst also nicht mit der Länge
+// des Streams, sondern nur mit der Anzahl der Startpositionen, aus denen noch ein Match werden kann.
+typedef struct Regen_Stream Regen_Stream;
+
+// Der Compiled_Regex muss geöffnet bleiben, bis der Stream beendet ist.
+// Gibt NULL zurück, falls der Regex Bedingungen wie ^, $ oder \b enthält.
+Regen_Stream* regen_stream_open(Compiled_Regex* compiled);
+// Gibt alle Matches zurück, die im übergebenen Stück enden, auch wenn sie in einem früheren Stück angefangen haben.
+// Die Offsets zählen ab dem Anfang des Streams, sortiert wird nur innerhalb eines Aufrufs.
+// Außer bei match_all steht ein Match erst fest, wenn kein längerer oder früherer mehr möglich ist, er kann also
+// auch erst von einem späteren Aufruf gemeldet werden. Dafür hebt der Stream die Bytes ab dem Ende des besten
+// Kandidaten auf, an dem die nächste Suche beginnt.
+Match* regen_stream_feed(Regen_Stream* stream, const uint8_t* chunk, size_t length, size_t* matches_count);
+// Sagt dem Stream, dass keine Bytes mehr kommen, und gibt die Matches zurück, die erst dadurch feststehen.
+// Bei match_all ist das nie einer. Danach darf nur noch regen_stream_finish aufgerufen werden.
+Match* regen_stream_end(Regen_Stream* stream, size_t* matches_count);
+// Beendet den Stream und gibt ihn frei. Bei match_all wird jeder Match schon von dem regen_stream_feed gemeldet,
+// in dessen Stück er endet.
+void regen_stream_finish(Regen_Stream* stream);
+
+// Liefert die Matches einzeln, statt sie alle in einem Array zu sammeln. Die Daten werden in Fenstern von
+// REGEN_ITERATOR_WINDOW Bytes gelesen, gespeichert werden also nur die Matches, die im aktuellen Fenster enden.
+// Wie bei regen_stream_feed sind die Matches nur innerhalb eines Fensters nach Offset und Länge sortiert,
+// außer bei match_all kommen sie aber immer in der Reihenfolge ihrer Offsets. thread_count spielt keine Rolle.
+typedef struct Regen_Iterator Regen_Iterator;
+
+#define REGEN_ITERATOR_WINDOW (64 << 10)
+
+// Die Daten und der Compiled_Regex müssen gültig bleiben, bis der Iterator beendet ist. Solange er offen ist,
+// darf mit dem Compiled_Regex nichts anderes gematcht werden, da er sich dessen Lazy-DFA teilt.
+Regen_Iterator* regen_iterator_open(Compiled_Regex* compiled, const uint8_t* data, size_t length);
+// Schreibt den nächsten Match nach *match. Gibt false zurück, wenn es keinen mehr gibt.
+bool regen_next(Regen_Iterator* iterator, Match* match);
+// Darf auch aufgerufen werden, bevor alle Matches abgeholt wurden. Die restlichen Daten werden dann nicht mehr gelesen.
+void regen_iterator_finish(Regen_Iterator* iterator);
+
+typedef enum {
+    scan_continue = 0,
+    scan_stop = 1,
+} Regen_Scan_Action;
+
+typedef Regen_Scan_Action (*Regen_Match_Callback)(size_t offset, size_t length, void* user_data);
+
+// Ruft on_match für jeden Match in der Reihenfolge von regen_next auf, bis es scan_stop zurückgibt.
+// Gibt zurück, wie oft on_match aufgerufen wurde.
+size_t regen_exec_callback(Compiled_Regex* compiled, const uint8_t* data, size_t length, Regen_Match_Callback on_match, void* user_data);
+
+// Schreibt den Quelltext einer eigenständigen C-Funktion function_name nach output, die wie regen_exec_callback
+// ohne den Compiled_Regex aufgerufen wird und dieselben Matches in der Reihenfolge von regen_exec meldet. Sie braucht
+// weder regen noch den Heap. Gibt false zurück bei match_leftmost_first, bei Bedingungen wie ^, $ und \b und
+// wenn der DFA mehr als dfa_state_limit Zustände bräuchte.
+bool regen_generate_c(Compiled_Regex* compiled, const char* function_name, FILE* output);
+
+// Viele Regexe, die zu einem einzigen Automaten zusammengefasst sind, damit die Eingabe
+// unabhängig von der Anzahl der Patterns nur einmal gelesen wird. Die Patterns werden über
+// ihren Index im Array nummeriert, das regen_set_compile übergeben wurde.
+// Wie ein Compiled_Regex darf ein Pattern_Set nicht von mehreren Threads gleichzeitig benutzt werden.
+typedef struct Pattern_Set Pattern_Set;
+
+typedef struct {
+    size_t pattern;
+    size_t offset;
+    size_t length;
+} Set_Match;
+
+// Gibt NULL zurück, falls einer der Regexe nicht übersetzt werden kann. Welcher und warum, sagen
+// regen_compile_error_pattern und regen_compile_error.
+Pattern_Set* regen_set_compile(char** regexes, size_t regex_count);
+// Setzt matched[pattern] für jedes Pattern, das irgendwo in den Daten passt, und gibt deren Anzahl zurück.
+// matched muss Platz für regex_count Einträge haben.
+size_t regen_set_exec(Pattern_Set* set, const uint8_t* data, size_t length, bool* matched);
+// Alle Matches aller Patterns, sortiert nach Offset, Länge und Pattern.
+Set_Match* regen_set_exec_matches(Pattern_Set* set, const uint8_t* data, size_t length, size_t* matches_count);
+void regen_set_free(Pattern_Set* set);
+
+// Übersetzen den Regex mit den Standardoptionen und matchen ihn einmal. Die zuletzt benutzten Regexe bleiben dabei
+// übersetzt in einem Cache, den sich alle Threads teilen, ein wiederholter Aufruf mit demselben Regex übersetzt
+// ihn also nicht noch einmal. Gibt NULL zurück, falls der Regex syntaktisch falsch ist.
+Match* match(char* to_match, char* regex, size_t* matches_count);
+Match* match_bytes(const uint8_t* data, size_t length, char* regex, size_t* matches_count);
+
+#define REGEN_DEFAULT_CACHE_CAPACITY 32
+
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} Regen_Cache_Stats;
+
+// Wie viele Regexe der Cache von match höchstens behält, 0 schaltet ihn ab. Überzählige Einträge werden sofort
+// freigegeben, am längsten unbenutzte zuerst. Matchen mehrere Threads gleichzeitig mit demselben Regex, teilen sie
+// sich dessen Automaten, jeder hat aber einen eigenen Lazy-DFA-Cache von bis zu dfa_cache_size Bytes. Bis zu 8 davon
+// behält der Eintrag für später.
+void regen_set_cache_capacity(size_t capacity);
+// Ein Miss ist jeder Aufruf, der den Regex übersetzen musste, weil er nicht im Cache war.
+Regen_Cache_Stats regen_cache_stats();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include <string.h>
+#include "optimizer.h"
+#include "stack.h"
+#include "debug.h"
+
+typedef struct {
+    uint64_t hash;
+    size_t node_index;
+} Node_Signature;
+
+// Wo die Tiefensuche in den Kanten eines Knotens gerade steht.
+typedef struct {
+    size_t node_index;
+    size_t edge_index;
+} Edge_Cursor;
+
+bool edges_equal(Compact_Edge *first, Compact_Edge *second);
+void add_unique_edge(VLA *edges, Compact_Edge *edge);
+void collect_ordered_edges(Compact_NFA *nfa, size_t node_index, size_t *visited_at, Stack *pending, VLA *edges);
+VLA **collect_direct_edges(Compact_NFA *nfa, bool *kept);
+void redirect_edges(VLA *edges, size_t *representative);
+uint64_t hash_node(Compact_NFA *nfa, size_t node_index, VLA *edges);
+bool nodes_equal(Compact_NFA *nfa, size_t first, size_t second, VLA **edges);
+bool merge_equal_nodes(Compact_NFA *nfa, VLA **edges, bool *kept, size_t *representative);
+int compare_signatures(const void *first, const void *second);
+Compact_NFA *build_reachable_nfa(Compact_NFA *nfa, VLA **edges, size_t *representative);
+
+bool edges_equal(Compact_Edge *first, Compact_Edge *second) {
+    if (first->endpoint != second->endpoint || first->match_length != second->match_length) return false;
+    if ((first->byte_set == NULL) != (second->byte_set == NULL)) return false;
+    if (first->byte_set != NULL) return memcmp(first->byte_set, second->byte_set, sizeof(Byte_Set)) == 0;
+    return first->match_length == 0 || memcmp(first->matches, second->matches, first->match_length) == 0;
+}
+
+// Die Reihenfolge der Kanten bleibt erhalten, nur Wiederholungen fallen weg.
+void add_unique_edge(VLA *edges, Compact_Edge *edge) {
+    for (size_t edge_index = 0; edge_index < VLA_get_length(edges); edge_index++) {
+        if (edges_equal((Compact_Edge *)edges->data + edge_index, edge)) return;
+    }
+    VLA_append(edges, edge);
+}
+
+// Tiefensuche über die leeren Kanten ab node_index, die die Kanten in der Reihenfolge einsammelt, in der ein
+// Backtracking-Matcher sie ausprobieren würde. So bleibt die Priorität der Pfade für leftmost-first erhalten.
+// visited_at funktioniert wie beim Berechnen der Epsilon-Hüllen.
+void collect_ordered_edges(Compact_NFA *nfa, size_t node_index, size_t *visited_at, Stack *pending, VLA *edges) {
+    visited_at[node_index] = node_index + 1;
+    stack_push(pending, &(Edge_Cursor){node_index, 0});
+
+    while (VLA_get_length(pending) > 0) {
+        Edge_Cursor *cursor = (Edge_Cursor *)VLA_get(pending, -1);
+        Compact_Node *current = &nfa->nodes[cursor->node_index];
+        if (cursor->edge_index == current->edge_count) {
+            stack_pop(pending);
+            continue;
+        }
+
+        Compact_Edge *edge = &current->edges[cursor->edge_index++];
+        if (edge->match_length > 0) {
+            add_unique_edge(edges, edge);
+            continue;
+        }
+        if (visited_at[edge->endpoint] == node_index + 1) continue;
+        visited_at[edge->endpoint] = node_index + 1;
+        if (is_stop_node(nfa, edge->endpoint)) {
+            add_unique_edge(edges, &(Compact_Edge){.matches = NULL, .match_length = 0, .byte_set = NULL, .endpoint = edge->endpoint});
+        }
+        stack_push(pending, &(Edge_Cursor){edge->endpoint, 0});
+    }
+}
+
+// Nach einem verbrauchten Byte steht der Automat immer auf dem Endpunkt einer Kante. Nur diese Knoten, der Start
+// und die Stop-Knoten werden also noch gebraucht. Jeder von ihnen bekommt die Kanten seines ganzen Abschlusses.
+VLA **collect_direct_edges(Compact_NFA *nfa, bool *kept) {
+    kept[nfa->start_node_index] = true;
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (is_stop_node(nfa, node_index)) kept[node_index] = true;
+        Compact_Node *node = &nfa->nodes[node_index];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            if (node->edges[edge_index].match_length > 0) kept[node->edges[edge_index].endpoint] = true;
+        }
+    }
+
+    VLA **edges = calloc(nfa->node_count, sizeof(VLA *));
+    size_t *visited_at = calloc(nfa->node_count, sizeof(size_t));
+    Stack *pending = stack_initialize(16, sizeof(Edge_Cursor));
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (!kept[node_index]) continue;
+        edges[node_index] = VLA_initialize(1, sizeof(Compact_Edge));
+        collect_ordered_edges(nfa, node_index, visited_at, pending, edges[node_index]);
+    }
+    VLA_free(pending);
+    free(visited_at);
+    return edges;
+}
+
+void redirect_edges(VLA *edges, size_t *representative) {
+    size_t length = VLA_get_length(edges);
+    Compact_Edge *redirected = malloc(length * sizeof(Compact_Edge));
+    memcpy(redirected, edges->data, length * sizeof(Compact_Edge));
+    VLA_clear(edges);
+    for (size_t edge_index = 0; edge_index < length; edge_index++) {
+        redirected[edge_index].endpoint = representative[redirected[edge_index].endpoint];
+        add_unique_edge(edges, &redirected[edge_index]);
+    }
+    free(redirected);
+}
+
+uint64_t hash_node(Compact_NFA *nfa, size_t node_index, VLA *edges) {
+    uint64_t hash = 14695981039346656037ULL;
+    size_t pattern = nfa->pattern_ids != NULL ? nfa->pattern_ids[node_index] : NO_PATTERN;
+    hash = (hash ^ is_stop_node(nfa, node_index)) * 1099511628211ULL;
+    hash = (hash ^ pattern) * 1099511628211ULL;
+    for (size_t edge_index = 0; edge_index < VLA_get_length(edges); edge_index++) {
+        Compact_Edge *edge = (Compact_Edge *)edges->data + edge_index;
+        hash = (hash ^ edge->endpoint) * 1099511628211ULL;
+        hash = (hash ^ edge->match_length) * 1099511628211ULL;
+        if (edge->byte_set != NULL) {
+            for (size_t word = 0; word < 4; word++) hash = (hash ^ edge->byte_set->bits[word]) * 1099511628211ULL;
+            continue;
+        }
+        for (size_t byte_index = 0; byte_index < edge->match_length; byte_index++) {
+            hash = (hash ^ edge->matches[byte_index]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+// Zwei Knoten sind gleichwertig, wenn sie gleich akzeptieren und dieselben Kanten in derselben Reihenfolge haben.
+bool nodes_equal(Compact_NFA *nfa, size_t first, size_t second, VLA **edges) {
+    if (is_stop_node(nfa, first) != is_stop_node(nfa, second)) return false;
+    if (nfa->pattern_ids != NULL && nfa->pattern_ids[first] != nfa->pattern_ids[second]) return false;
+    if (VLA_get_length(edges[first]) != VLA_get_length(edges[second])) return false;
+    for (size_t edge_index = 0; edge_index < VLA_get_length(edges[first]); edge_index++) {
+        if (!edges_equal((Compact_Edge *)edges[first]->data + edge_index, (Compact_Edge *)edges[second]->data + edge_index)) return false;
+    }
+    return true;
+}
+
+int compare_signatures(const void *first, const void *second) {
+    const Node_Signature *left = first;
+    const Node_Signature *right = second;
+    if (left->hash != right->hash) return left->hash < right->hash ? -1 : 1;
+    if (left->node_index != right->node_index) return left->node_index < right->node_index ? -1 : 1;
+    return 0;
+}
+
+// Legt gleichwertige Knoten auf den mit der kleinsten Nummer zusammen. Ein Knoten, dessen einzige Kante
+// leer in einen Stop-Knoten führt, verhält sich genau wie dieser und wird auch auf ihn gelegt.
+bool merge_equal_nodes(Compact_NFA *nfa, VLA **edges, bool *kept, size_t *representative) {
+    bool merged = false;
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (!kept[node_index] || representative[node_index] != node_index || is_stop_node(nfa, node_index)) continue;
+        if (VLA_get_length(edges[node_index]) != 1) continue;
+        Compact_Edge *only = (Compact_Edge *)edges[node_index]->data;
+        if (only->match_length == 0) {
+            representative[node_index] = only->endpoint;
+            merged = true;
+        }
+    }
+
+    Node_Signature *signatures = malloc(nfa->node_count * sizeof(Node_Signature));
+    size_t signature_count = 0;
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (!kept[node_index] || representative[node_index] != node_index) continue;
+        redirect_edges(edges[node_index], representative);
+        signatures[signature_count++] = (Node_Signature){hash_node(nfa, node_index, edges[node_index]), node_index};
+    }
+    qsort(signatures, signature_count, sizeof(Node_Signature), compare_signatures);
+
+    for (size_t first = 0; first < signature_count; first++) {
+        size_t leader = signatures[first].node_index;
+        if (representative[leader] != leader) continue;
+        for (size_t second = first + 1; second < signature_count && signatures[second].hash == signatures[first].hash; second++) {
+            size_t other = signatures[second].node_index;
+            if (representative[other] != other || !nodes_equal(nfa, leader, other, edges)) continue;
+            representative[other] = leader;
+            merged = true;
+        }
+    }
+    free(signatures);
+    return merged;
+}
+
+// Nummeriert die erreichbaren Repräsentanten in ihrer alten Reihenfolge neu und kopiert ihre Kanten.
+Compact_NFA *build_reachable_nfa(Compact_NFA *nfa, VLA **edges, size_t *representative) {
+    size_t start = representative[nfa->start_node_index];
+    size_t *new_index = malloc(nfa->node_count * sizeof(size_t));
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) new_index[node_index] = SIZE_MAX;
+
+    // Stop-Knoten bleiben auch dann, wenn sie nicht erreichbar sind, damit stop_node_index gültig ist.
+    bool *reachable = calloc(nfa->node_count, sizeof(bool));
+    Stack *pending = stack_initialize(nfa->node_count, sizeof(size_t));
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (node_index != start && !(is_stop_node(nfa, node_index) && representative[node_index] == node_index)) continue;
+        reachable[node_index] = true;
+        stack_push(pending, &node_index);
+    }
+    while (VLA_get_length(pending) > 0) {
+        size_t current = *(size_t *)stack_pop(pending);
+        for (size_t edge_index = 0; edge_index < VLA_get_length(edges[current]); edge_index++) {
+            size_t endpoint = ((Compact_Edge *)edges[current]->data + edge_index)->endpoint;
+            if (reachable[endpoint]) continue;
+            reachable[endpoint] = true;
+            stack_push(pending, &endpoint);
+        }
+    }
+
+    size_t node_count = 0;
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (reachable[node_index]) new_index[node_index] = node_count++;
+    }
+
+    Compact_NFA *optimized = initialize_compact_nfa(node_count);
+    optimized->group_count = nfa->group_count;
+    optimized->start_node_index = new_index[start];
+    optimized->stop_node_index = new_index[representative[nfa->stop_node_index]];
+    if (nfa->pattern_ids != NULL) optimized->pattern_ids = arena_allocate(optimized->arena, node_count * sizeof(size_t));
+
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (!reachable[node_index]) continue;
+        Compact_Node *node = &optimized->nodes[new_index[node_index]];
+        node->edge_count = VLA_get_length(edges[node_index]);
+        node->edges = arena_allocate(optimized->arena, node->edge_count * sizeof(Compact_Edge));
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = (Compact_Edge *)edges[node_index]->data + edge_index;
+            node->edges[edge_index].match_length = edge->match_length;
+            node->edges[edge_index].endpoint = new_index[edge->endpoint];
+            node->edges[edge_index].matches = NULL;
+            node->edges[edge_index].byte_set = NULL;
+            if (edge->byte_set != NULL) {
+                node->edges[edge_index].byte_set = arena_allocate(optimized->arena, sizeof(Byte_Set));
+                *node->edges[edge_index].byte_set = *edge->byte_set;
+            } else {
+                node->edges[edge_index].matches = arena_allocate(optimized->arena, edge->match_length);
+                if (edge->match_length > 0) memcpy(node->edges[edge_index].matches, edge->matches, edge->match_length);
+            }
+        }
+        if (nfa->pattern_ids != NULL) optimized->pattern_ids[new_index[node_index]] = nfa->pattern_ids[node_index];
+    }
+
+    VLA_free(pending);
+    free(reachable);
+    free(new_index);
+    return optimized;
+}
+
+Compact_NFA *remove_empty_edges(Compact_NFA *nfa) {
+    bool *kept = calloc(nfa->node_count, sizeof(bool));
+    VLA **edges = collect_direct_edges(nfa, kept);
+
+    size_t *representative = malloc(nfa->node_count * sizeof(size_t));
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) representative[node_index] = node_index;
+    while (merge_equal_nodes(nfa, edges, kept, representative)) {
+        // Ketten wie a -> b -> c auf den letzten Repräsentanten verkürzen, bevor die Kanten umgebogen werden.
+        for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+            size_t target = representative[node_index];
+            while (representative[target] != target) target = representative[target];
+            representative[node_index] = target;
+        }
+    }
+
+    Compact_NFA *optimized = build_reachable_nfa(nfa, edges, representative);
+    debug("Removed empty edges, %lu of %lu NFA nodes are left.\n", optimized->node_count, nfa->node_count);
+
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        if (edges[node_index] != NULL) VLA_free(edges[node_index]);
+    }
+    free(edges);
+    free(representative);
+    free(kept);
+    free_compact_nfa(nfa);
+    return optimized;
+}
+
+void drop_edges_after_match(Compact_NFA *nfa) {
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+        Compact_Node *node = &nfa->nodes[node_index];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            if (node->edges[edge_index].match_length == 0 && is_stop_node(nfa, node->edges[edge_index].endpoint)) {
+                node->edge_count = edge_index + 1;
+                break;
+            }
+        }
+    }
+}
\ No newline at end of file
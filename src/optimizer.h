@@ -0,0 +1,16 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "NFA.h"
+
+// Baut einen gleichwertigen Automaten ohne leere Kanten. Übrig bleiben nur Kanten, die Bytes verbrauchen,
+// und leere Kanten direkt in einen Stop-Knoten, über die akzeptierende Knoten markiert sind. Unerreichbare
+// Knoten fallen weg und Knoten mit denselben ausgehenden Kanten werden zusammengelegt.
+// Gibt nfa frei und den neuen Automaten zurück.
+// Die Kanten jedes Knotens stehen danach in der Reihenfolge, in der ein Backtracking-Matcher sie ausprobieren würde.
+Compact_NFA *remove_empty_edges(Compact_NFA *nfa);
+// Für leftmost-first auf einem Automaten von remove_empty_edges: Die Kanten hinter der leeren Kante in den Stop-Knoten
+// haben weniger Priorität als der Match, den sie schon liefert, und werden abgeschnitten.
+void drop_edges_after_match(Compact_NFA *nfa);
+
+#endif
\ No newline at end of file
@@ -11,6 +11,8 @@ ParserState *initialize_parser_state();
 // dann muss man einfach nur die Vergleiche in dieser Funktion umschreiben,
 // da alle anderen Funktionen nur mit den Enums arbeiten.
 Token get_token_type(char character, ParseMode mode);
+// Wie get_token_type für das Zeichen hinter einem \, das sonst immer für sich selbst steht.
+Token get_escaped_token_type(char character, ParseMode mode);
 
 bool grammar_blocklist[TOKEN_COUNT][TOKEN_COUNT] = {
     [block_open][block_close] = true,
@@ -18,20 +20,38 @@ bool grammar_blocklist[TOKEN_COUNT][TOKEN_COUNT] = {
     [block_open][mod_any] = true,
     [block_open][mod_multiple] = true,
     [block_open][mod_choice] = true,
+    [block_open][repetition_range_start] = true,
     [mod_optional][mod_optional] = true,
     [mod_optional][mod_any] = true,
     [mod_optional][mod_multiple] = true,
+    [mod_optional][repetition_range_start] = true,
     [mod_any][mod_optional] = true,
     [mod_any][mod_any] = true,
     [mod_any][mod_multiple] = true,
+    [mod_any][repetition_range_start] = true,
     [mod_multiple][mod_optional] = true,
     [mod_multiple][mod_any] = true,
     [mod_multiple][mod_multiple] = true,
+    [mod_multiple][repetition_range_start] = true,
     [mod_choice][block_close] = true,
     [mod_choice][mod_optional] = true,
     [mod_choice][mod_any] = true,
     [mod_choice][mod_multiple] = true,
+    [mod_choice][repetition_range_start] = true,
     [mod_choice][mod_choice] = true,
+    // Eine Bedingung verbraucht nichts, sie zu wiederholen ergibt keinen Sinn.
+    [anchor_start][mod_optional] = true,
+    [anchor_start][mod_any] = true,
+    [anchor_start][mod_multiple] = true,
+    [anchor_start][repetition_range_start] = true,
+    [anchor_end][mod_optional] = true,
+    [anchor_end][mod_any] = true,
+    [anchor_end][mod_multiple] = true,
+    [anchor_end][repetition_range_start] = true,
+    [word_boundary][mod_optional] = true,
+    [word_boundary][mod_any] = true,
+    [word_boundary][mod_multiple] = true,
+    [word_boundary][repetition_range_start] = true,
 };
 
 Token VLA_binding_get_token(VLA *v, signed long index) {
@@ -48,7 +68,9 @@ void token_formatter(VLA *output, void *item) {
 ParserState *initialize_parser_state(char *regex) {
     ParserState *state = malloc(sizeof(ParserState));
     state->tokens = NULL;
+    state->token_offsets = NULL;
     state->regex = NULL;
+    state->regex_length = 0;
     state->open_blocks = 0;
     state->parse_mode = Default;
     state->escape_active = false;
@@ -58,6 +80,7 @@ ParserState *initialize_parser_state(char *regex) {
 
 void free_parser_state(ParserState *state) {
     free(state->tokens);
+    free(state->token_offsets);
     free(state->regex);
     free(state);
 }
@@ -75,6 +98,13 @@ Token get_token_type(char value, ParseMode mode) {
     if (value == ']') return value_range_stop;
     if (value == '{') return repetition_range_start;
     if (value == '}') return repetition_range_stop;
+    if (mode == Default && value == '^') return anchor_start;
+    if (mode == Default && value == '$') return anchor_end;
+    return utf8_codepoint;
+}
+
+Token get_escaped_token_type(char value, ParseMode mode) {
+    if (mode == Default && value == 'b') return word_boundary;
     return utf8_codepoint;
 }
 
@@ -93,6 +123,9 @@ char *get_token_description(Token token) {
     if (token == repetition_range_start) return "RepetitionRange::start";
     if (token == repetition_range_stop) return "RepetitionRange::stop";
     if (token == range_separator) return "Range::separator";
+    if (token == anchor_start) return "Anchor::start";
+    if (token == anchor_end) return "Anchor::end";
+    if (token == word_boundary) return "Anchor::word_boundary";
 }
 
 bool is_whitespace(char character) {
@@ -100,7 +133,7 @@ bool is_whitespace(char character) {
 }
 
 bool encodes_special_character(char c) {
-    return (c == '0' || c == 'a' || c == 'b' || c == 't' ||
+    return (c == '0' || c == 'a' || c == 't' ||
             c == 'n' || c == 'v' || c == 'f' || c == 'r');
 }
 
@@ -114,8 +147,6 @@ char get_replacement_for_special_character(char special) {
             return '\0';
         case 'a':
             return '\a';
-        case 'b':
-            return '\b';
         case 't':
             return '\t';
         case 'n':
@@ -133,15 +164,17 @@ char get_replacement_for_special_character(char special) {
 #pragma GCC diagnostic pop
 
 // FIXME: Ekelhaft zu verstehende Konditionen vereinfachen
-char *remove_whitespace_and_encodings_from_regex(char *regex) {
-    char *cleaned = calloc(strlen(regex) + 1, sizeof(char));
+// Da \0 zu einem Null-Byte wird, kann die Länge des Ergebnisses nicht mit strlen bestimmt werden.
+char *remove_whitespace_and_encodings_from_regex(char *regex, size_t *cleaned_length) {
+    size_t regex_length = strlen(regex);
+    char *cleaned = calloc(regex_length + 1, sizeof(char));
     size_t dest_index = 0;
     bool detected_special_character = false;
 
-    for (size_t src_index = 0; src_index < strlen(regex); src_index++) {
+    for (size_t src_index = 0; src_index < regex_length; src_index++) {
         if ((src_index == 0 || regex[src_index - 1] != '\\') && is_whitespace(regex[src_index])) continue;
         if (!detected_special_character && regex[src_index] == '\\' &&
-            src_index < strlen(regex) - 1 && encodes_special_character(regex[src_index + 1])) {
+            src_index + 1 < regex_length && encodes_special_character(regex[src_index + 1])) {
             detected_special_character = true;
             continue;
         }
@@ -156,6 +189,7 @@ char *remove_whitespace_and_encodings_from_regex(char *regex) {
         dest_index++;
     }
 
+    *cleaned_length = dest_index;
     return cleaned;
 }
 
@@ -168,57 +202,91 @@ uint8_t get_valid_utf8_codepoint_size(uint8_t *at, size_t remaining_length) {
     return 0;
 }
 
-void advance_to_next_token(char *regex, size_t *index) {
-    if (*index >= strlen(regex)) {
-        panic("Index %lu is out of bounds for string at %p (length=%lu)\n", index, regex, strlen(regex));
+// Gibt false zurück und lässt index stehen, falls dort kein gültiger UTF-8-Codepoint beginnt. Der Regex kommt vom
+// Aufrufer, das ist also ein Syntaxfehler und kein Grund, den Prozess zu beenden.
+bool advance_to_next_token(char *regex, size_t regex_length, size_t *index) {
+    if (*index >= regex_length) {
+        panic("Index %lu is out of bounds for string at %p (length=%lu)\n", *index, regex, regex_length);
     }
 
-    uint8_t current_token_size = get_valid_utf8_codepoint_size(regex + *index, strlen(regex) - *index);
-    if (current_token_size == 0) {
-        panic("Encountered invalid unicode codepoint %lu bytes in at %p, aborting.\n", *index, regex + *index);
-    }
+    uint8_t current_token_size = get_valid_utf8_codepoint_size((uint8_t *)regex + *index, regex_length - *index);
+    if (current_token_size == 0) return false;
 
     *index += current_token_size;
+    return true;
 }
 
+// Bei [a], [] oder [a, ] stehen weniger als vier Tokens im Bereich, die dürfen also nicht gelesen werden.
 bool parsed_correct_value_range(VLA *tokens) {
+    if (VLA_get_length(tokens) < 4) return false;
     return VLA_binding_get_token(tokens, -4) == value_range_start &&
            VLA_binding_get_token(tokens, -3) == utf8_codepoint &&
            VLA_binding_get_token(tokens, -2) == range_separator &&
            VLA_binding_get_token(tokens, -1) == utf8_codepoint;
 }
 
+// Die Grenzen eines Bereichs sind einzelne Bytes, die untere darf nicht größer als die obere sein.
+bool parsed_valid_range_bounds(VLA *regex, VLA *token_offsets) {
+    size_t low_offset = *(size_t *)VLA_get(token_offsets, -3);
+    size_t high_offset = *(size_t *)VLA_get(token_offsets, -1);
+    size_t low_size = *(size_t *)VLA_get(token_offsets, -2) - low_offset;
+    size_t high_size = VLA_get_length(regex) - high_offset;
+    if (low_size != 1 || high_size != 1) return false;
+    return (uint8_t)regex->data[low_offset] <= (uint8_t)regex->data[high_offset];
+}
+
+// Bei Kurzformen wie a{1} oder a{} stehen noch keine vier Tokens im Bereich, die dürfen also nicht gelesen werden.
 bool parsed_correct_repetition_range(VLA *tokens) {
+    if (VLA_get_length(tokens) < 4) return false;
     return VLA_binding_get_token(tokens, -4) == repetition_range_start &&
            VLA_binding_get_token(tokens, -3) == unsigned_long &&
            VLA_binding_get_token(tokens, -2) == range_separator &&
            VLA_binding_get_token(tokens, -1) == unsigned_long;
 }
 
+// Die Zahlen stehen roh im Regex, die untere darf nicht größer als die obere sein.
+bool parsed_valid_repetition_bounds(VLA *regex, VLA *token_offsets) {
+    unsigned long minimum, maximum;
+    memcpy(&minimum, regex->data + *(size_t *)VLA_get(token_offsets, -3), sizeof(unsigned long));
+    memcpy(&maximum, regex->data + *(size_t *)VLA_get(token_offsets, -1), sizeof(unsigned long));
+    return minimum <= maximum;
+}
+
+// Gibt alles frei, was parse_regex bis zum Fehler angelegt hat. Der Aufrufer gibt nur state selbst frei.
+ParserState *reject_regex(ParserState *state, char *cleaned_input, VLA *regex, VLA *tokens, VLA *token_offsets) {
+    state->invalid = true;
+    free(cleaned_input);
+    VLA_free(regex);
+    VLA_free(tokens);
+    VLA_free(token_offsets);
+    return state;
+}
+
 ParserState *parse_regex(char *input) {
-    char *cleaned_input = remove_whitespace_and_encodings_from_regex(input);
+    size_t cleaned_length;
+    char *cleaned_input = remove_whitespace_and_encodings_from_regex(input, &cleaned_length);
     ParserState *state = initialize_parser_state(cleaned_input);
-    VLA *regex = VLA_initialize(strlen(cleaned_input), sizeof(char));
-    VLA *tokens = VLA_initialize(strlen(cleaned_input), sizeof(Token));
+    VLA *regex = VLA_initialize(cleaned_length, sizeof(char));
+    VLA *tokens = VLA_initialize(cleaned_length, sizeof(Token));
+    VLA *token_offsets = VLA_initialize(cleaned_length, sizeof(size_t));
 
     // Dummy-Element, damit man auch am Anfang auf grammar_table zugreifen kann.
     // Es ist block_open, weil es am Anfang genau einen globalen Block gibt.
     Token previous = block_open;
     size_t byte_offset = 0;
-    while (byte_offset < strlen(cleaned_input)) {
+    while (byte_offset < cleaned_length) {
         if (VLA_get_length(tokens) > 0) previous = VLA_binding_get_token(tokens, -1);
-        Token current = state->escape_active ? utf8_codepoint : get_token_type(cleaned_input[byte_offset], state->parse_mode);
+        Token current = state->escape_active ? get_escaped_token_type(cleaned_input[byte_offset], state->parse_mode)
+                                             : get_token_type(cleaned_input[byte_offset], state->parse_mode);
 
         if (grammar_blocklist[previous][current]) {
-            warn("A %s followed by a %s is not supported by the regen syntax.\n", get_token_description(previous), get_token_description(current));
-            state->invalid = true;
-            return state;
+            debug("A %s followed by a %s is not supported by the regen syntax.\n", get_token_description(previous), get_token_description(current));
+            return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
         }
 
         if (current == block_close && state->open_blocks == 0) {
-            warn("Trying to close a block that doesn't exist is not allowed.\n");
-            state->invalid = true;
-            return state;
+            debug("Trying to close a block that doesn't exist is not allowed.\n");
+            return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
         }
 
         if (current == block_open) state->open_blocks++;
@@ -226,25 +294,28 @@ ParserState *parse_regex(char *input) {
 
         if (current == mod_escape) {
             state->escape_active = true;
-            advance_to_next_token(cleaned_input, &byte_offset);
+            byte_offset++;
             continue;
         }
 
         if (current == value_range_start) {
             if (state->parse_mode != Default) {
-                warn("Trying to start a range while already being inside another range is not allowed.\n");
-                state->invalid = true;
-                return state;
+                debug("Trying to start a range while already being inside another range is not allowed.\n");
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
             }
             state->parse_mode = InValueRange;
         }
 
         if (current == value_range_stop) {
             if (!parsed_correct_value_range(tokens)) {
-                warn("Value range ending at offset %lu is formatted incorrectly.\n", VLA_get_length(tokens));
+                debug("Value range ending at offset %zu is formatted incorrectly.\n", VLA_get_length(tokens));
                 VLA_print(tokens, token_formatter);
-                state->invalid = true;
-                return state;
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
+            }
+
+            if (!parsed_valid_range_bounds(regex, token_offsets)) {
+                debug("Value range ending at offset %zu needs two single-byte bounds in ascending order.\n", VLA_get_length(tokens));
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
             }
 
             state->parse_mode = Default;
@@ -252,19 +323,22 @@ ParserState *parse_regex(char *input) {
 
         if (current == repetition_range_start) {
             if (state->parse_mode != Default) {
-                warn("Trying to start a range while already being inside another range is not allowed.\n");
-                state->invalid = true;
-                return state;
+                debug("Trying to start a range while already being inside another range is not allowed.\n");
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
             }
             state->parse_mode = InRepetitionRange;
         }
 
         if (current == repetition_range_stop) {
             if (!parsed_correct_repetition_range(tokens)) {
-                warn("Repetition range ending at offset %lu is formatted incorrectly.\n", VLA_get_length(tokens));
+                debug("Repetition range ending at offset %zu is formatted incorrectly.\n", VLA_get_length(tokens));
                 VLA_print(tokens, token_formatter);
-                state->invalid = true;
-                return state;
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
+            }
+
+            if (!parsed_valid_repetition_bounds(regex, token_offsets)) {
+                debug("Repetition range ending at offset %zu needs a lower bound that isn't larger than the upper bound.\n", VLA_get_length(tokens));
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
             }
 
             state->parse_mode = Default;
@@ -275,41 +349,51 @@ ParserState *parse_regex(char *input) {
             errno = 0;
             unsigned long converted = strtoul(cleaned_input + byte_offset, &parse_end, 0);
             if (errno != 0) {
-                warn("%s\n", strerror(errno));
-                state->invalid = true;
-                return state;
+                debug("%s\n", strerror(errno));
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
             }
 
             if (parse_end == cleaned_input + byte_offset) {
-                warn("Could not convert number inside repetition range.\n");
-                state->invalid = true;
-                return state;
+                debug("Could not convert number inside repetition range.\n");
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
             }
 
+            VLA_append(token_offsets, &(size_t){VLA_get_length(regex)});
             VLA_batch_append(regex, &converted, sizeof(unsigned long));
             VLA_append(tokens, &(Token){unsigned_long});
             byte_offset += parse_end - (cleaned_input + byte_offset);
         } else {
-            VLA_batch_append(regex, cleaned_input + byte_offset, get_valid_utf8_codepoint_size(cleaned_input + byte_offset, strlen(cleaned_input) - byte_offset));
+            size_t token_start = byte_offset;
+            if (!advance_to_next_token(cleaned_input, cleaned_length, &byte_offset)) {
+                debug("Encountered an invalid UTF-8 codepoint at offset %zu.\n", token_start);
+                return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
+            }
+            VLA_append(token_offsets, &(size_t){VLA_get_length(regex)});
+            VLA_batch_append(regex, cleaned_input + token_start, byte_offset - token_start);
             VLA_append(tokens, &current);
-            advance_to_next_token(cleaned_input, &byte_offset);
         }
 
         state->escape_active = false;
     }
 
     // prüft, ob am Ende Gruppen neu angefangen oder nicht geschlossen wurden
+    // Ein leerer Regex oder ein einzelnes \ haben gar kein Token.
+    if (VLA_get_length(tokens) == 0) {
+        debug("A regex needs at least one token.\n");
+        return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
+    }
     Token last = VLA_binding_get_token(tokens, -1);
     if (state->parse_mode != Default || state->open_blocks > 0 || state->escape_active || last == mod_choice) {
-        warn("Leaving a started group open is not allowed. Please close it explicitly.\n");
-        state->invalid = true;
-        return state;
+        debug("Leaving a started group open is not allowed. Please close it explicitly.\n");
+        return reject_regex(state, cleaned_input, regex, tokens, token_offsets);
     }
 
+    state->regex_length = VLA_get_length(regex);
     VLA_append(regex, &(char){'\0'});
     state->regex = (char *)VLA_extract(regex);
     state->number_of_tokens = VLA_get_length(tokens);
     state->tokens = (Token *)VLA_extract(tokens);
+    state->token_offsets = (size_t *)VLA_extract(token_offsets);
     free(cleaned_input);
     return state;
 }
\ No newline at end of file
@@ -20,6 +20,9 @@ typedef enum {
     repetition_range_start = 11,
     repetition_range_stop = 12,
     range_separator = 13,
+    anchor_start = 14,
+    anchor_end = 15,
+    word_boundary = 16,
 } Token;
 
 typedef enum {
@@ -28,13 +31,17 @@ typedef enum {
     InRepetitionRange = 2,
 } ParseMode;
 
-#define TOKEN_COUNT 14
+#define TOKEN_COUNT 17
 #define RANGE_SEPARATOR ','
 
 typedef struct {
     Token* tokens;
     size_t number_of_tokens;
+    // Die Bytes des i-ten Tokens beginnen bei regex[token_offsets[i]], ein Token kann mehrere Bytes lang sein.
+    size_t* token_offsets;
     char* regex;
+    // Ohne das abschließende Null-Byte. Der Regex kann durch \0 selbst Null-Bytes enthalten.
+    size_t regex_length;
     size_t open_blocks;
     ParseMode parse_mode;
     bool escape_active;
@@ -0,0 +1,215 @@
+#include <string.h>
+#include "NFA.h"
+#include "parser.h"
+#include "generator.h"
+#include "matcher.h"
+#include "closure.h"
+#include "optimizer.h"
+#include "prefilter.h"
+#include "pike_vm.h"
+#include "lazy_dfa.h"
+#include "debug.h"
+
+#define SET_DFA_CACHE_SIZE (16 << 20)
+// Feste Knoten am Anfang des kombinierten NFA, danach folgen die Knoten der einzelnen Patterns.
+#define ANCHORED_START 0
+#define UNUSED_STOP 1
+#define UNANCHORED_START 2
+#define FIRST_PATTERN_NODE 3
+
+// Der kombinierte NFA hat zwei Starts: ANCHORED_START verzweigt über leere Kanten in die Starts aller Patterns,
+// UNANCHORED_START bleibt zusätzlich auf jedem Byte bei sich selbst. Von dort aus läuft die DFA einmal über
+// die Eingabe, ohne sich Startpositionen zu merken, und kennt in jedem Zustand die Patterns, die gerade enden.
+struct Pattern_Set {
+    Compact_NFA* nfa;
+    Epsilon_Closures* closures;
+    Prefilter* prefilter;
+    Lazy_DFA* dfa;
+    size_t pattern_count;
+    // Für welchen Durchlauf die Patterns eines DFA-Zustands schon eingetragen wurden.
+    size_t* reported_generation;
+    size_t reported_capacity;
+    size_t generation;
+};
+
+// Aus matcher.c, damit regen_compile_error auch für Sets den Grund kennt.
+void record_compile_error(Regen_Compile_Error error, size_t pattern);
+Compact_NFA* combine_pattern_nfas(Compact_NFA** nfas, size_t count);
+Compact_NFA get_anchored_view(Pattern_Set* set);
+void record_state_patterns(Pattern_Set* set, uint32_t state, bool* matched, size_t* matched_count);
+
+// Übernimmt die Knoten und Kanten der einzelnen NFAs, die danach nicht mehr benutzt werden dürfen.
+Compact_NFA* combine_pattern_nfas(Compact_NFA** nfas, size_t count) {
+    size_t node_count = FIRST_PATTERN_NODE;
+    for (size_t pattern = 0; pattern < count; pattern++) node_count += nfas[pattern]->node_count;
+
+    Compact_NFA* combined = initialize_compact_nfa(node_count);
+    combined->start_node_index = UNANCHORED_START;
+    combined->stop_node_index = UNUSED_STOP;
+    combined->pattern_ids = arena_allocate(combined->arena, node_count * sizeof(size_t));
+    for (size_t node_index = 0; node_index < node_count; node_index++) combined->pattern_ids[node_index] = NO_PATTERN;
+
+    Compact_Node* unanchored = &combined->nodes[UNANCHORED_START];
+    unanchored->edge_count = 2;
+    unanchored->edges = arena_allocate(combined->arena, unanchored->edge_count * sizeof(Compact_Edge));
+    unanchored->edges[0].byte_set = arena_allocate(combined->arena, sizeof(Byte_Set));
+    memset(unanchored->edges[0].byte_set, 0xFF, sizeof(Byte_Set));
+    unanchored->edges[0].match_length = 1;
+    unanchored->edges[0].endpoint = UNANCHORED_START;
+    unanchored->edges[1].endpoint = ANCHORED_START;
+
+    Compact_Node* anchored = &combined->nodes[ANCHORED_START];
+    anchored->edge_count = count;
+    anchored->edges = arena_allocate(combined->arena, count * sizeof(Compact_Edge));
+
+    size_t base = FIRST_PATTERN_NODE;
+    for (size_t pattern = 0; pattern < count; pattern++) {
+        Compact_NFA* part = nfas[pattern];
+        for (size_t node_index = 0; node_index < part->node_count; node_index++) {
+            Compact_Node* node = &combined->nodes[base + node_index];
+            *node = part->nodes[node_index];
+            for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) node->edges[edge_index].endpoint += base;
+        }
+        anchored->edges[pattern].endpoint = base + part->start_node_index;
+        combined->pattern_ids[base + part->stop_node_index] = pattern;
+        base += part->node_count;
+
+        // Die Kanten und Labels bleiben, wo sie sind, ihr Speicher gehört ab jetzt zum kombinierten NFA.
+        arena_adopt(combined->arena, part->arena);
+    }
+
+    return combined;
+}
+
+// Derselbe NFA, aber mit ANCHORED_START als Start. Teilt sich die Knoten mit set->nfa.
+Compact_NFA get_anchored_view(Pattern_Set* set) {
+    Compact_NFA anchored = *set->nfa;
+    anchored.start_node_index = ANCHORED_START;
+    return anchored;
+}
+
+Pattern_Set* regen_set_compile(char** regexes, size_t regex_count) {
+    record_compile_error(regen_compile_ok, 0);
+    Compact_NFA** nfas = malloc((regex_count + 1) * sizeof(Compact_NFA*));
+    for (size_t pattern = 0; pattern < regex_count; pattern++) {
+        ParserState* state = parse_regex(regexes[pattern]);
+        if (state->invalid) {
+            record_compile_error(regen_syntax_error, pattern);
+            free_parser_state(state);
+            for (size_t compiled = 0; compiled < pattern; compiled++) free_compact_nfa(nfas[compiled]);
+            free(nfas);
+            return NULL;
+        }
+        NFA* nfa = generate_nfa_from_parsed_regex(state, GENERATED_NODE_LIMIT);
+        if (nfa == NULL) {
+            record_compile_error(regen_too_many_states, pattern);
+            for (size_t compiled = 0; compiled < pattern; compiled++) free_compact_nfa(nfas[compiled]);
+            free(nfas);
+            return NULL;
+        }
+        Compact_NFA* generated = compact_generated_NFA(nfa);
+        // Die Lazy-DFA des Sets kennt nur Mengen von Knoten, nicht die Bytes um die aktuelle Position.
+        if (has_assertions(generated)) {
+            record_compile_error(regen_unsupported, pattern);
+            free_compact_nfa(generated);
+            for (size_t compiled = 0; compiled < pattern; compiled++) free_compact_nfa(nfas[compiled]);
+            free(nfas);
+            return NULL;
+        }
+        nfas[pattern] = remove_empty_edges(generated);
+    }
+
+    Pattern_Set* set = calloc(1, sizeof(Pattern_Set));
+    set->pattern_count = regex_count;
+    set->nfa = combine_pattern_nfas(nfas, regex_count);
+    free(nfas);
+    set->closures = compute_epsilon_closures(set->nfa);
+    Compact_NFA anchored = get_anchored_view(set);
+    set->prefilter = build_prefilter(&anchored, set->closures);
+
+    // Nach dem Leeren müssen der tote Zustand, der Start, der behaltene und der nächste Zustand auf jeden Fall passen.
+    size_t cache_size = SET_DFA_CACHE_SIZE;
+    if (cache_size < 4 * lazy_dfa_state_cost(set->nfa->node_count)) cache_size = 4 * lazy_dfa_state_cost(set->nfa->node_count);
+    set->dfa = initialize_lazy_dfa(set->nfa, set->closures, cache_size);
+    debug("Compiled a set of %lu patterns into %lu NFA nodes.\n", regex_count, set->nfa->node_count);
+    return set;
+}
+
+void regen_set_free(Pattern_Set* set) {
+    if (set == NULL) return;
+    free_lazy_dfa(set->dfa);
+    free_prefilter(set->prefilter);
+    free_epsilon_closures(set->closures);
+    free_compact_nfa(set->nfa);
+    free(set->reported_generation);
+    free(set);
+}
+
+// Trägt alle Patterns ein, deren Stop-Knoten im Zustand liegt. Jeder Zustand wird pro Durchlauf nur einmal angesehen.
+void record_state_patterns(Pattern_Set* set, uint32_t state, bool* matched, size_t* matched_count) {
+    if (state >= set->reported_capacity) {
+        size_t capacity = set->dfa->state_capacity > state ? set->dfa->state_capacity : state + 1;
+        set->reported_generation = realloc(set->reported_generation, capacity * sizeof(size_t));
+        memset(set->reported_generation + set->reported_capacity, 0, (capacity - set->reported_capacity) * sizeof(size_t));
+        set->reported_capacity = capacity;
+    }
+    if (set->reported_generation[state] == set->generation) return;
+    set->reported_generation[state] = set->generation;
+
+    size_t node_count;
+    size_t* nodes = get_state_nodes(set->dfa, state, &node_count);
+    for (size_t index = 0; index < node_count; index++) {
+        size_t pattern = set->nfa->pattern_ids[nodes[index]];
+        if (pattern == NO_PATTERN || matched[pattern]) continue;
+        matched[pattern] = true;
+        (*matched_count)++;
+    }
+}
+
+size_t regen_set_exec(Pattern_Set* set, const uint8_t* data, size_t length, bool* matched) {
+    memset(matched, 0, set->pattern_count * sizeof(bool));
+    // Wie bei regen_exec gibt es in leeren Daten auch keinen leeren Match.
+    if (length == 0) return 0;
+
+    Lazy_DFA* dfa = set->dfa;
+    Prefilter_Cursor cursor;
+    initialize_prefilter_cursor(&cursor, false, SIZE_MAX);
+    size_t matched_count = 0;
+    set->generation++;
+
+    uint32_t state = dfa->start_state;
+    for (size_t position = 0;; position++) {
+        // Ein leerer Match am Ende der Daten zählt nicht, aber dasselbe Pattern hat dann schon bei Offset 0 gepasst.
+        if (dfa->accepting[state]) {
+            record_state_patterns(set, state, matched, &matched_count);
+            if (matched_count == set->pattern_count) break;
+        }
+        if (position == length) break;
+
+        // Im Startzustand ist gerade kein Match angefangen, also direkt zur nächsten Position, an der einer anfangen kann.
+        if (state == dfa->start_state) {
+            position = find_next_candidate(set->prefilter, &cursor, data, length, position);
+            if (position == length) break;
+        }
+
+        uint32_t next = lazy_dfa_next_state(dfa, state, data[position]);
+        if (next == DFA_UNKNOWN_STATE) {
+            state = lazy_dfa_clear_cache_keeping_state(dfa, state);
+            set->generation++;
+            next = lazy_dfa_next_state(dfa, state, data[position]);
+            if (next == DFA_UNKNOWN_STATE) panic("The pattern set DFA does not fit into %lu bytes, aborting.\n", dfa->cache_size);
+        }
+        state = next;
+    }
+
+    return matched_count;
+}
+
+Set_Match* regen_set_exec_matches(Pattern_Set* set, const uint8_t* data, size_t length, size_t* matches_count) {
+    VLA* matches = VLA_initialize(5, sizeof(Set_Match));
+    Compact_NFA anchored = get_anchored_view(set);
+    pike_vm_find_matches(&anchored, set->closures, set->prefilter, data, length, matches);
+
+    *matches_count = VLA_get_length(matches);
+    return (Set_Match*)VLA_extract(matches);
+}
\ No newline at end of file
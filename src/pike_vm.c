@@ -0,0 +1,338 @@
+#include <string.h>
+#include "pike_vm.h"
+#include "lanes.h"
+#include "debug.h"
+
+// Alle Startpositionen, deren Threads gerade in genau derselben Knotenmenge stehen, verhalten sich ab jetzt
+// gleich und werden deshalb zu einer Lane zusammengefasst. Pro Schritt wird so jede Knotenmenge nur einmal
+// weitergeschaltet, egal wie viele Startpositionen noch leben.
+typedef struct {
+    size_t first_node;
+    size_t node_count;
+    uint64_t hash;
+    size_t starts_head;
+    size_t starts_tail;
+} Lane;
+
+typedef struct {
+    Lane *lanes;
+    size_t lane_count;
+    size_t lane_capacity;
+    size_t *nodes;
+    size_t node_count;
+    size_t node_capacity;
+} Lane_List;
+
+struct Pike_VM {
+    Compact_NFA *nfa;
+    Epsilon_Closures *closures;
+    Lane_List current;
+    Lane_List building;
+    // Hashtabelle über die Lanes in building, slot_generation macht das Leeren pro Schritt überflüssig.
+    size_t *slots;
+    size_t *slot_generation;
+    size_t slot_capacity;
+    size_t generation;
+    Start_Links starts;
+    size_t *node_marks;
+    size_t mark;
+    size_t lane_begin;
+    VLA *matches;
+    // Bei leftmost-first stehen die Knoten einer Lane in der Reihenfolge ihrer Priorität und werden nicht sortiert.
+    bool ordered;
+    // Wie viele Knoten insgesamt über ein Byte weitergeschaltet wurden.
+    size_t steps;
+};
+
+void initialize_lane_list(Lane_List *list, size_t node_capacity);
+void free_lane_list(Lane_List *list);
+void begin_lane(Pike_VM *vm);
+void add_nodes_to_lane(Pike_VM *vm, size_t *nodes, size_t node_count);
+void add_closure_to_lane(Pike_VM *vm, size_t node_index);
+void step_lane(Pike_VM *vm, size_t *nodes, size_t node_count, uint8_t byte);
+void finish_lane(Pike_VM *vm, size_t position, size_t starts_head, size_t starts_tail, bool report);
+void report_lane(Pike_VM *vm, size_t *nodes, size_t node_count, size_t starts_head, size_t position);
+Lane *find_equal_lane(Pike_VM *vm, uint64_t hash, size_t *nodes, size_t node_count, size_t *slot);
+void grow_lane_table(Pike_VM *vm);
+void drop_remaining_lanes(Pike_VM *vm);
+int compare_node_indices(const void *a, const void *b);
+
+void initialize_lane_list(Lane_List *list, size_t node_capacity) {
+    list->lane_capacity = 4;
+    list->lanes = malloc(list->lane_capacity * sizeof(Lane));
+    list->lane_count = 0;
+    list->node_capacity = node_capacity;
+    list->nodes = malloc(list->node_capacity * sizeof(size_t));
+    list->node_count = 0;
+}
+
+void free_lane_list(Lane_List *list) {
+    free(list->lanes);
+    free(list->nodes);
+}
+
+void begin_lane(Pike_VM *vm) {
+    vm->mark++;
+    vm->lane_begin = vm->building.node_count;
+}
+
+void add_nodes_to_lane(Pike_VM *vm, size_t *nodes, size_t node_count) {
+    Lane_List *building = &vm->building;
+    // Hinter dem Stop-Knoten kommen nur noch Threads, die weniger Priorität als der Match haben.
+    if (vm->ordered && vm->node_marks[vm->nfa->stop_node_index] == vm->mark) return;
+
+    for (size_t index = 0; index < node_count; index++) {
+        size_t node = nodes[index];
+        if (vm->node_marks[node] == vm->mark) continue;
+        vm->node_marks[node] = vm->mark;
+
+        if (building->node_count == building->node_capacity) {
+            building->node_capacity *= 2;
+            building->nodes = realloc(building->nodes, building->node_capacity * sizeof(size_t));
+        }
+        building->nodes[building->node_count++] = node;
+        if (vm->ordered && node == vm->nfa->stop_node_index) return;
+    }
+}
+
+void add_closure_to_lane(Pike_VM *vm, size_t node_index) {
+    size_t member_count;
+    size_t *members = get_closure_members(vm->closures, node_index, &member_count);
+    add_nodes_to_lane(vm, members, member_count);
+}
+
+void step_lane(Pike_VM *vm, size_t *nodes, size_t node_count, uint8_t byte) {
+    for (size_t index = 0; index < node_count; index++) {
+        Compact_Node *node = &vm->nfa->nodes[nodes[index]];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            Compact_Edge *edge = &node->edges[edge_index];
+            // Der Generator erzeugt nur leere Kanten und Kanten, die genau ein Byte matchen.
+            if (!edge_matches_byte(edge, byte)) continue;
+            add_closure_to_lane(vm, edge->endpoint);
+        }
+    }
+}
+
+int compare_node_indices(const void *a, const void *b) {
+    size_t first = *(const size_t *)a;
+    size_t second = *(const size_t *)b;
+    return (first > second) - (first < second);
+}
+
+Lane *find_equal_lane(Pike_VM *vm, uint64_t hash, size_t *nodes, size_t node_count, size_t *slot) {
+    size_t index = hash & (vm->slot_capacity - 1);
+    while (vm->slot_generation[index] == vm->generation) {
+        Lane *candidate = &vm->building.lanes[vm->slots[index]];
+        if (candidate->hash == hash && candidate->node_count == node_count &&
+            !memcmp(vm->building.nodes + candidate->first_node, nodes, node_count * sizeof(size_t))) {
+            return candidate;
+        }
+        index = (index + 1) & (vm->slot_capacity - 1);
+    }
+
+    *slot = index;
+    return NULL;
+}
+
+void grow_lane_table(Pike_VM *vm) {
+    free(vm->slots);
+    free(vm->slot_generation);
+    vm->slot_capacity *= 2;
+    vm->slots = malloc(vm->slot_capacity * sizeof(size_t));
+    vm->slot_generation = calloc(vm->slot_capacity, sizeof(size_t));
+
+    for (size_t lane_index = 0; lane_index < vm->building.lane_count; lane_index++) {
+        size_t index = vm->building.lanes[lane_index].hash & (vm->slot_capacity - 1);
+        while (vm->slot_generation[index] == vm->generation) index = (index + 1) & (vm->slot_capacity - 1);
+        vm->slot_generation[index] = vm->generation;
+        vm->slots[index] = lane_index;
+    }
+}
+
+// Bei Pattern-Sets kann eine Lane die Stop-Knoten mehrerer Patterns enthalten, dann wird für jedes davon gemeldet.
+void report_lane(Pike_VM *vm, size_t *nodes, size_t node_count, size_t starts_head, size_t position) {
+    Compact_NFA *nfa = vm->nfa;
+    if (nfa->pattern_ids == NULL) {
+        if (vm->node_marks[nfa->stop_node_index] == vm->mark) report_start_links(&vm->starts, starts_head, position, vm->matches);
+        return;
+    }
+
+    for (size_t index = 0; index < node_count; index++) {
+        size_t pattern = nfa->pattern_ids[nodes[index]];
+        if (pattern != NO_PATTERN) report_pattern_start_links(&vm->starts, starts_head, position, pattern, vm->matches);
+    }
+}
+
+// Schließt die gerade aufgebaute Knotenmenge ab. Leere Mengen sterben, gleiche Mengen werden verschmolzen.
+// report ist nur false, wenn die Lane von einer anderen Engine kommt, die ihre Matches schon gemeldet hat.
+void finish_lane(Pike_VM *vm, size_t position, size_t starts_head, size_t starts_tail, bool report) {
+    Lane_List *building = &vm->building;
+    size_t *nodes = building->nodes + vm->lane_begin;
+    size_t node_count = building->node_count - vm->lane_begin;
+
+    if (node_count == 0) {
+        release_start_links(&vm->starts, starts_head, starts_tail);
+        return;
+    }
+
+    if (report) report_lane(vm, nodes, node_count, starts_head, position);
+    if (drop_outdone_lane(&vm->starts, starts_head, starts_tail)) {
+        building->node_count = vm->lane_begin;
+        return;
+    }
+
+    if (!vm->ordered) qsort(nodes, node_count, sizeof(size_t), compare_node_indices);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t index = 0; index < node_count; index++) {
+        hash = (hash ^ nodes[index]) * 1099511628211ULL;
+    }
+
+    size_t slot;
+    Lane *equal = find_equal_lane(vm, hash, nodes, node_count, &slot);
+    if (equal != NULL) {
+        merge_start_links(&vm->starts, &equal->starts_head, &equal->starts_tail, starts_head, starts_tail);
+        building->node_count = vm->lane_begin;
+        return;
+    }
+
+    if (building->lane_count == building->lane_capacity) {
+        building->lane_capacity *= 2;
+        building->lanes = realloc(building->lanes, building->lane_capacity * sizeof(Lane));
+    }
+    building->lanes[building->lane_count] = (Lane){
+        .first_node = vm->lane_begin,
+        .node_count = node_count,
+        .hash = hash,
+        .starts_head = starts_head,
+        .starts_tail = starts_tail,
+    };
+    vm->slot_generation[slot] = vm->generation;
+    vm->slots[slot] = building->lane_count;
+    building->lane_count++;
+
+    if (building->lane_count * 2 > vm->slot_capacity) grow_lane_table(vm);
+}
+
+Pike_VM *initialize_pike_vm(Compact_NFA *nfa, Epsilon_Closures *closures) {
+    Pike_VM *vm = calloc(1, sizeof(Pike_VM));
+    vm->nfa = nfa;
+    vm->closures = closures;
+    vm->slot_capacity = 16;
+    vm->generation = 1;
+    vm->node_marks = calloc(nfa->node_count, sizeof(size_t));
+    vm->slots = malloc(vm->slot_capacity * sizeof(size_t));
+    vm->slot_generation = calloc(vm->slot_capacity, sizeof(size_t));
+    initialize_start_links(&vm->starts);
+    initialize_lane_list(&vm->current, nfa->node_count);
+    initialize_lane_list(&vm->building, nfa->node_count);
+    return vm;
+}
+
+void free_pike_vm(Pike_VM *vm) {
+    free_lane_list(&vm->current);
+    free_lane_list(&vm->building);
+    free(vm->slots);
+    free(vm->slot_generation);
+    free(vm->node_marks);
+    free_start_links(&vm->starts);
+    free(vm);
+}
+
+size_t pike_vm_steps(Pike_VM *vm) {
+    return vm->steps;
+}
+
+size_t pike_vm_memory(Pike_VM *vm) {
+    size_t lanes = (vm->current.lane_capacity + vm->building.lane_capacity) * sizeof(Lane);
+    size_t nodes = (vm->current.node_capacity + vm->building.node_capacity) * sizeof(size_t);
+    return lanes + nodes + 2 * vm->slot_capacity * sizeof(size_t) + start_links_memory(&vm->starts);
+}
+
+void pike_vm_select_matches(Pike_VM *vm, Match_Selection *selection) {
+    vm->starts.selection = selection;
+    vm->ordered = selection != NULL && selection->mode == match_leftmost_first;
+}
+
+// Nach dem letzten Stück kann keine Lane mehr matchen. Danach ist die VM frei für eine neue Suche.
+void drop_remaining_lanes(Pike_VM *vm) {
+    for (size_t lane_index = 0; lane_index < vm->building.lane_count; lane_index++) {
+        Lane *lane = &vm->building.lanes[lane_index];
+        release_start_links(&vm->starts, lane->starts_head, lane->starts_tail);
+    }
+    vm->building.lane_count = 0;
+    vm->building.node_count = 0;
+    vm->generation++;
+}
+
+void pike_vm_adopt_lane(Pike_VM *vm, size_t *nodes, size_t node_count, Start_Links *starts, size_t starts_head, size_t offset) {
+    size_t head, tail;
+    copy_start_links(starts, starts_head, &vm->starts, &head, &tail);
+    begin_lane(vm);
+    add_nodes_to_lane(vm, nodes, node_count);
+    finish_lane(vm, offset, head, tail, false);
+}
+
+void pike_vm_adopt_lane_before(Pike_VM *vm, size_t *nodes, size_t node_count, Start_Links *starts, size_t starts_head, uint8_t byte, size_t offset, VLA *matches) {
+    size_t head, tail;
+    copy_start_links(starts, starts_head, &vm->starts, &head, &tail);
+    vm->matches = matches;
+    begin_lane(vm);
+    step_lane(vm, nodes, node_count, byte);
+    finish_lane(vm, offset + 1, head, tail, true);
+}
+
+void pike_vm_feed(Pike_VM *vm, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset, bool final_chunk, size_t start_limit, VLA *matches) {
+    vm->matches = matches;
+    Prefilter_Cursor cursor;
+    initialize_prefilter_cursor(&cursor, !final_chunk, start_limit);
+    size_t candidate = find_next_candidate(prefilter, &cursor, data, length, 0);
+
+    for (size_t position = 0; position < length; position++) {
+        if (vm->building.lane_count == 0 && selection_settled(&vm->starts, 0)) break;
+        // Lebt keine Lane mehr, kann direkt zur nächsten Position gesprungen werden, an der ein Match anfangen könnte.
+        if (vm->building.lane_count == 0 && candidate > position) {
+            position = candidate;
+            if (position == length) break;
+        }
+        if (position == candidate && !has_candidate(&vm->starts)) {
+            size_t link = allocate_start_link(&vm->starts, offset + position);
+            begin_lane(vm);
+            add_closure_to_lane(vm, vm->nfa->start_node_index);
+            finish_lane(vm, offset + position, link, link, true);
+            candidate = find_next_candidate(prefilter, &cursor, data, length, position + 1);
+        }
+
+        Lane_List swap = vm->current;
+        vm->current = vm->building;
+        vm->building = swap;
+        vm->building.lane_count = 0;
+        vm->building.node_count = 0;
+        vm->generation++;
+
+        uint8_t byte = data[position];
+        vm->steps += vm->current.node_count;
+        for (size_t lane_index = 0; lane_index < vm->current.lane_count; lane_index++) {
+            Lane *lane = &vm->current.lanes[lane_index];
+            begin_lane(vm);
+            step_lane(vm, vm->current.nodes + lane->first_node, lane->node_count, byte);
+            finish_lane(vm, offset + position + 1, lane->starts_head, lane->starts_tail, true);
+        }
+    }
+
+    if (final_chunk) drop_remaining_lanes(vm);
+    selection_settled(&vm->starts, vm->building.lane_count);
+}
+
+void pike_vm_find_matches(Compact_NFA *nfa, Epsilon_Closures *closures, Prefilter *prefilter, const uint8_t *data, size_t length, VLA *matches) {
+    Pike_VM *vm = initialize_pike_vm(nfa, closures);
+    size_t first_new_match = VLA_get_length(matches);
+    pike_vm_feed(vm, prefilter, data, length, 0, true, SIZE_MAX, matches);
+
+    // Die Matches werden nach ihrem Ende gefunden, der Aufrufer erwartet sie aber nach Offset sortiert.
+    if (nfa->pattern_ids == NULL) {
+        sort_matches(matches, first_new_match);
+    } else {
+        sort_set_matches(matches, first_new_match);
+    }
+    free_pike_vm(vm);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef PIKE_VM_H
+#define PIKE_VM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "NFA.h"
+#include "closure.h"
+#include "prefilter.h"
+#include "lanes.h"
+#include "VLA.h"
+
+// Simuliert den Automaten im Gleichschritt für alle Startpositionen auf einmal (Thompson/Pike).
+// Jede (Offset, Länge)-Kombination, die den Stop-Knoten erreicht, wird genau einmal in matches eingetragen.
+// Bei Pattern-Sets (pattern_ids gesetzt) enthält matches stattdessen Set_Match-Einträge.
+typedef struct Pike_VM Pike_VM;
+
+Pike_VM *initialize_pike_vm(Compact_NFA *nfa, Epsilon_Closures *closures);
+void free_pike_vm(Pike_VM *vm);
+// Sucht statt aller Matches nur den besten nach selection->mode, NULL schaltet wieder auf alle Matches um.
+void pike_vm_select_matches(Pike_VM *vm, Match_Selection *selection);
+// Wie viele Knoten die VM bisher über ein Byte weitergeschaltet hat, ein Maß für die Arbeit unabhängig von der Eingabelänge.
+size_t pike_vm_steps(Pike_VM *vm);
+// Speicher für Lanes und Startpositionen in Bytes, ohne den Automaten selbst.
+size_t pike_vm_memory(Pike_VM *vm);
+// Liest die nächsten length Bytes, data[0] liegt an Position offset der gesamten Eingabe. Matches, die in diesen
+// Bytes enden, werden unsortiert an matches angehängt. Ist final_chunk false, können noch weitere Bytes folgen.
+// Ab data[start_limit] beginnen keine neuen Matches mehr, der Durchlauf endet, sobald keine Lane mehr lebt.
+// Nach dem letzten Stück sterben alle Lanes, die VM kann dann für eine neue Suche weiterbenutzt werden.
+// Mit Auswahl endet der Durchlauf schon, sobald der beste Match feststeht.
+void pike_vm_feed(Pike_VM *vm, Prefilter *prefilter, const uint8_t *data, size_t length, size_t offset, bool final_chunk, size_t start_limit, VLA *matches);
+// Übernimmt die Lane einer anderen Engine, deren Knotenmenge schon an Position offset steht.
+void pike_vm_adopt_lane(Pike_VM *vm, size_t *nodes, size_t node_count, Start_Links *starts, size_t starts_head, size_t offset);
+// Wie pike_vm_adopt_lane, aber die Lane steht noch vor dem Byte an Position offset und wird erst darüber weitergeschaltet.
+void pike_vm_adopt_lane_before(Pike_VM *vm, size_t *nodes, size_t node_count, Start_Links *starts, size_t starts_head, uint8_t byte, size_t offset, VLA *matches);
+// Liest die komplette Eingabe und sortiert die neuen Matches.
+void pike_vm_find_matches(Compact_NFA *nfa, Epsilon_Closures *closures, Prefilter *prefilter, const uint8_t *data, size_t length, VLA *matches);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include <string.h>
+#include "prefilter.h"
+#include "debug.h"
+
+#define NO_BYTE 256
+
+void extract_required_prefix(Prefilter *prefilter, Compact_NFA *nfa, Epsilon_Closures *closures);
+void extract_required_suffix(Prefilter *prefilter, Compact_NFA *nfa);
+void extract_first_bytes(Prefilter *prefilter, Compact_NFA *nfa, Epsilon_Closures *closures);
+void mark_reverse_empty_closure(Compact_NFA *nfa, bool *marked);
+size_t compute_max_match_length(Compact_NFA *nfa);
+void compute_skip_table(const uint8_t *literal, size_t literal_length, size_t *skip);
+size_t find_unlimited_candidate(Prefilter *prefilter, Prefilter_Cursor *cursor, const uint8_t *data, size_t length, size_t from);
+
+// Solange alle Kanten, die aus der aktuellen Knotenmenge herausführen, dasselbe Byte matchen
+// und der Stop-Knoten noch nicht erreicht ist, muss jeder Match mit genau diesem Byte weitergehen.
+void extract_required_prefix(Prefilter *prefilter, Compact_NFA *nfa, Epsilon_Closures *closures) {
+    size_t *marks = calloc(nfa->node_count, sizeof(size_t));
+    VLA *current = VLA_initialize(nfa->node_count, sizeof(size_t));
+    VLA *next = VLA_initialize(nfa->node_count, sizeof(size_t));
+    size_t member_count;
+    size_t *members = get_closure_members(closures, nfa->start_node_index, &member_count);
+    VLA_batch_append(current, members, member_count);
+
+    for (size_t mark = 1; prefilter->prefix_length < MAX_LITERAL_LENGTH; mark++) {
+        size_t required = NO_BYTE;
+        bool unique = true;
+        for (size_t index = 0; index < VLA_get_length(current) && unique; index++) {
+            size_t node_index = *(size_t *)VLA_get(current, index);
+            if (is_stop_node(nfa, node_index)) unique = false;
+            Compact_Node *node = &nfa->nodes[node_index];
+            for (size_t edge_index = 0; edge_index < node->edge_count && unique; edge_index++) {
+                Compact_Edge *edge = &node->edges[edge_index];
+                if (edge->match_length == 0) continue;
+                uint8_t byte;
+                if (!get_single_edge_byte(edge, &byte) || (required != NO_BYTE && required != byte)) unique = false;
+                required = byte;
+            }
+        }
+        if (!unique || required == NO_BYTE) break;
+
+        prefilter->prefix[prefilter->prefix_length++] = required;
+        VLA_clear(next);
+        for (size_t index = 0; index < VLA_get_length(current); index++) {
+            Compact_Node *node = &nfa->nodes[*(size_t *)VLA_get(current, index)];
+            for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+                if (node->edges[edge_index].match_length == 0) continue;
+                members = get_closure_members(closures, node->edges[edge_index].endpoint, &member_count);
+                for (size_t member_index = 0; member_index < member_count; member_index++) {
+                    if (marks[members[member_index]] == mark) continue;
+                    marks[members[member_index]] = mark;
+                    VLA_append(next, &members[member_index]);
+                }
+            }
+        }
+
+        VLA *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    VLA_free(current);
+    VLA_free(next);
+    free(marks);
+}
+
+// Sammelt die Bytes aller Kanten, die aus dem Abschluss des Start-Knotens herausführen.
+void extract_first_bytes(Prefilter *prefilter, Compact_NFA *nfa, Epsilon_Closures *closures) {
+    Byte_Set first_bytes = {0};
+    size_t member_count;
+    size_t *members = get_closure_members(closures, nfa->start_node_index, &member_count);
+
+    for (size_t member_index = 0; member_index < member_count; member_index++) {
+        // Der leere Match passt überall, dann kann keine Position übersprungen werden.
+        if (is_stop_node(nfa, members[member_index])) return;
+        Compact_Node *node = &nfa->nodes[members[member_index]];
+        for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+            add_edge_bytes(&first_bytes, &node->edges[edge_index]);
+        }
+    }
+
+    if (byte_set_count(&first_bytes) == 256) return;
+    initialize_byte_scanner(&prefilter->first_bytes, &first_bytes);
+    prefilter->has_first_bytes = true;
+}
+
+// Markiert alle Knoten, von denen aus einer der schon markierten Knoten nur über leere Kanten erreichbar ist.
+void mark_reverse_empty_closure(Compact_NFA *nfa, bool *marked) {
+    // Die Kanten sind nur vorwärts gespeichert, deshalb wird so lange über alle Knoten gelaufen, bis sich nichts mehr ändert.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+            if (marked[node_index]) continue;
+            Compact_Node *node = &nfa->nodes[node_index];
+            for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+                if (node->edges[edge_index].match_length > 0 || !marked[node->edges[edge_index].endpoint]) continue;
+                marked[node_index] = true;
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+// Spiegelbildlich zum Präfix: alle Kanten, nach denen der Stop-Knoten nur noch über leere Kanten
+// erreichbar ist, müssen dasselbe Byte matchen, und das leere Wort darf nicht passen.
+void extract_required_suffix(Prefilter *prefilter, Compact_NFA *nfa) {
+    bool *current = calloc(nfa->node_count, sizeof(bool));
+    bool *next = calloc(nfa->node_count, sizeof(bool));
+    uint8_t reversed[MAX_LITERAL_LENGTH];
+    size_t reversed_length = 0;
+
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) current[node_index] = is_stop_node(nfa, node_index);
+    mark_reverse_empty_closure(nfa, current);
+
+    while (reversed_length < MAX_LITERAL_LENGTH && !current[nfa->start_node_index]) {
+        size_t required = NO_BYTE;
+        bool unique = true;
+        memset(next, 0, nfa->node_count * sizeof(bool));
+
+        for (size_t node_index = 0; node_index < nfa->node_count && unique; node_index++) {
+            Compact_Node *node = &nfa->nodes[node_index];
+            for (size_t edge_index = 0; edge_index < node->edge_count && unique; edge_index++) {
+                Compact_Edge *edge = &node->edges[edge_index];
+                if (edge->match_length == 0 || !current[edge->endpoint]) continue;
+                uint8_t byte;
+                if (!get_single_edge_byte(edge, &byte) || (required != NO_BYTE && required != byte)) unique = false;
+                required = byte;
+                next[node_index] = true;
+            }
+        }
+        if (!unique || required == NO_BYTE) break;
+
+        reversed[reversed_length++] = required;
+        mark_reverse_empty_closure(nfa, next);
+        bool *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    for (size_t index = 0; index < reversed_length; index++) {
+        prefilter->suffix[index] = reversed[reversed_length - 1 - index];
+    }
+    prefilter->suffix_length = reversed_length;
+
+    free(current);
+    free(next);
+}
+
+// Längster Pfad (gezählt in Bytes) vom Start aus nach Bellman-Ford. Verbessert sich nach node_count
+// Runden immer noch etwas, dann gibt es einen Zyklus, der Bytes verbraucht, und die Länge ist unbegrenzt.
+size_t compute_max_match_length(Compact_NFA *nfa) {
+    size_t *longest = malloc(nfa->node_count * sizeof(size_t));
+    for (size_t node_index = 0; node_index < nfa->node_count; node_index++) longest[node_index] = UNBOUNDED_LENGTH;
+    longest[nfa->start_node_index] = 0;
+
+    bool changed = true;
+    for (size_t round = 0; round <= nfa->node_count && changed; round++) {
+        changed = false;
+        for (size_t node_index = 0; node_index < nfa->node_count; node_index++) {
+            if (longest[node_index] == UNBOUNDED_LENGTH) continue;
+            Compact_Node *node = &nfa->nodes[node_index];
+            for (size_t edge_index = 0; edge_index < node->edge_count; edge_index++) {
+                Compact_Edge *edge = &node->edges[edge_index];
+                size_t candidate = longest[node_index] + edge->match_length;
+                if (longest[edge->endpoint] != UNBOUNDED_LENGTH && longest[edge->endpoint] >= candidate) continue;
+                longest[edge->endpoint] = candidate;
+                changed = true;
+            }
+        }
+    }
+
+    size_t result = 0;
+    for (size_t node_index = 0; node_index < nfa->node_count && !changed; node_index++) {
+        if (is_stop_node(nfa, node_index) && longest[node_index] != UNBOUNDED_LENGTH && longest[node_index] > result) result = longest[node_index];
+    }
+    if (changed) result = UNBOUNDED_LENGTH;
+    free(longest);
+    return result;
+}
+
+void compute_skip_table(const uint8_t *literal, size_t literal_length, size_t *skip) {
+    for (size_t byte = 0; byte < 256; byte++) skip[byte] = literal_length;
+    for (size_t index = 0; index + 1 < literal_length; index++) {
+        skip[literal[index]] = literal_length - 1 - index;
+    }
+}
+
+Prefilter *build_prefilter(Compact_NFA *nfa, Epsilon_Closures *closures) {
+    Prefilter *prefilter = calloc(1, sizeof(Prefilter));
+    extract_required_prefix(prefilter, nfa, closures);
+    extract_required_suffix(prefilter, nfa);
+    if (prefilter->prefix_length == 0) extract_first_bytes(prefilter, nfa, closures);
+    prefilter->max_match_length = compute_max_match_length(nfa);
+    compute_skip_table(prefilter->prefix, prefilter->prefix_length, prefilter->prefix_skip);
+    compute_skip_table(prefilter->suffix, prefilter->suffix_length, prefilter->suffix_skip);
+
+    debug("Prefilter with prefix \"%.*s\", suffix \"%.*s\" and max match length %ld.\n",
+          (int)prefilter->prefix_length, prefilter->prefix, (int)prefilter->suffix_length, prefilter->suffix,
+          prefilter->max_match_length == UNBOUNDED_LENGTH ? -1L : (long)prefilter->max_match_length);
+    return prefilter;
+}
+
+void free_prefilter(Prefilter *prefilter) {
+    free(prefilter);
+}
+
+void initialize_prefilter_cursor(Prefilter_Cursor *cursor, bool partial, size_t start_limit) {
+    cursor->suffix_position = 0;
+    cursor->suffix_known = false;
+    cursor->partial = partial;
+    cursor->start_limit = start_limit;
+}
+
+// Horspool-Suche, einzelne Bytes werden direkt mit memchr gesucht.
+size_t find_literal(const uint8_t *data, size_t length, size_t from, const uint8_t *literal, size_t literal_length, const size_t *skip) {
+    if (literal_length == 1) {
+        const uint8_t *found = from < length ? memchr(data + from, literal[0], length - from) : NULL;
+        return found == NULL ? length : (size_t)(found - data);
+    }
+
+    size_t last = literal_length - 1;
+    for (size_t position = from; position + literal_length <= length; position += skip[data[position + last]]) {
+        if (data[position + last] == literal[last] && !memcmp(data + position, literal, last)) return position;
+    }
+    return length;
+}
+
+size_t find_next_candidate(Prefilter *prefilter, Prefilter_Cursor *cursor, const uint8_t *data, size_t length, size_t from) {
+    size_t candidate = find_unlimited_candidate(prefilter, cursor, data, length, from);
+    return candidate >= cursor->start_limit ? length : candidate;
+}
+
+size_t find_unlimited_candidate(Prefilter *prefilter, Prefilter_Cursor *cursor, const uint8_t *data, size_t length, size_t from) {
+    if (prefilter == NULL || from >= length) return from;
+
+    if (prefilter->prefix_length > 0) {
+        size_t found = find_literal(data, length, from, prefilter->prefix, prefilter->prefix_length, prefilter->prefix_skip);
+        // Ein Präfix, das über das Ende der Daten hinausgeht, kann erst die Engine mit den nächsten Bytes prüfen.
+        if (found == length && cursor->partial) {
+            size_t cut_off = prefilter->prefix_length <= length ? length - prefilter->prefix_length + 1 : 0;
+            return from > cut_off ? from : cut_off;
+        }
+        return found;
+    }
+
+    // Suffix und erstes Byte schränken die Position unabhängig voneinander ein, also so lange abwechselnd
+    // anwenden, bis sich die Position nicht mehr ändert.
+    for (;;) {
+        size_t candidate = from;
+        if (prefilter->suffix_length > 0 && !cursor->partial) {
+            if (!cursor->suffix_known || cursor->suffix_position < candidate) {
+                cursor->suffix_position = find_literal(data, length, candidate, prefilter->suffix, prefilter->suffix_length, prefilter->suffix_skip);
+                cursor->suffix_known = true;
+            }
+            if (cursor->suffix_position == length) return length;
+
+            // Der Match muss spätestens am gefundenen Suffix enden, darf also nicht länger als der längste mögliche Match sein.
+            size_t match_end = cursor->suffix_position + prefilter->suffix_length;
+            if (prefilter->max_match_length != UNBOUNDED_LENGTH && match_end - candidate > prefilter->max_match_length) {
+                candidate = match_end - prefilter->max_match_length;
+            }
+        }
+
+        if (prefilter->has_first_bytes) candidate = find_byte_in_set(&prefilter->first_bytes, data, length, candidate);
+        if (candidate == from || candidate >= length) return candidate;
+        from = candidate;
+    }
+}
\ No newline at end of file
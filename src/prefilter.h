@@ -0,0 +1,49 @@
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "NFA.h"
+#include "closure.h"
+#include "byte_scanner.h"
+
+#define MAX_LITERAL_LENGTH 64
+#define UNBOUNDED_LENGTH SIZE_MAX
+
+typedef struct Prefilter Prefilter;
+typedef struct Prefilter_Cursor Prefilter_Cursor;
+
+// Literale, mit denen jeder Match anfangen bzw. aufhören muss. Damit kann man Startpositionen,
+// an denen sowieso kein Match beginnen kann, überspringen, ohne den Automaten anzufassen.
+struct Prefilter {
+    uint8_t prefix[MAX_LITERAL_LENGTH];
+    size_t prefix_length;
+    size_t prefix_skip[256];
+    uint8_t suffix[MAX_LITERAL_LENGTH];
+    size_t suffix_length;
+    size_t suffix_skip[256];
+    // Bytes, mit denen ein Match anfangen kann. Nur gesetzt, wenn es kein Präfix gibt und nicht jedes Byte passt.
+    Byte_Scanner first_bytes;
+    bool has_first_bytes;
+    // Anzahl der Bytes des längsten möglichen Matches oder UNBOUNDED_LENGTH.
+    size_t max_match_length;
+};
+
+// Merkt sich während eines Durchlaufs, wo das Suffix zuletzt gefunden wurde. Bei partial können hinter
+// den Daten noch weitere folgen: dann hilft das Suffix nicht und ein abgeschnittenes Präfix am Ende zählt als Kandidat.
+// Ab start_limit fängt kein Match mehr an, z.B. weil ein anderer Thread die Startpositionen dahinter übernimmt.
+struct Prefilter_Cursor {
+    size_t suffix_position;
+    bool suffix_known;
+    bool partial;
+    size_t start_limit;
+};
+
+Prefilter *build_prefilter(Compact_NFA *nfa, Epsilon_Closures *closures);
+void free_prefilter(Prefilter *prefilter);
+void initialize_prefilter_cursor(Prefilter_Cursor *cursor, bool partial, size_t start_limit);
+// Gibt die kleinste Position >= from zurück, an der ein Match anfangen könnte, oder length, falls es keine gibt.
+size_t find_next_candidate(Prefilter *prefilter, Prefilter_Cursor *cursor, const uint8_t *data, size_t length, size_t from);
+size_t find_literal(const uint8_t *data, size_t length, size_t from, const uint8_t *literal, size_t literal_length, const size_t *skip);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include <string.h>
+#include <pthread.h>
+#include "regex_cache.h"
+#include "debug.h"
+
+#define MIN_BUCKET_COUNT 16
+// Mehr Kopien als Threads, die denselben Regex gleichzeitig benutzen, braucht es nie. Darüber hinaus werden sie
+// wieder freigegeben, damit ein kurzer Ansturm nicht dauerhaft Speicher für ihre Caches belegt.
+#define MAX_IDLE_COPIES 8
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+struct Cache_Entry {
+    char* regex;
+    uint64_t hash;
+    Compiled_Regex* compiled;
+    // Ein Compiled_Regex darf nur von einem Thread zur Zeit benutzt werden. Ist compiled vergeben, bekommen weitere
+    // Aufrufer Kopien aus share_compiled_regex, die sich die Automaten mit compiled teilen.
+    bool compiled_in_use;
+    Compiled_Regex* idle_copies[MAX_IDLE_COPIES];
+    size_t idle_copy_count;
+    // Wie viele Aufrufer gerade mit compiled oder einer Kopie matchen. Solange es welche gibt, wird nicht verdrängt.
+    size_t users;
+    Cache_Entry* newer;
+    Cache_Entry* older;
+    Cache_Entry* next_in_bucket;
+};
+
+// Ein Cache für den ganzen Prozess. Die Einträge liegen in einer Hashtabelle und zusätzlich in einer Liste vom
+// zuletzt bis zum am längsten nicht mehr benutzten, von deren Ende verdrängt wird. lock schützt alles außer den
+// vergebenen Compiled_Regex, mit denen gematcht wird, ohne den Lock zu halten.
+typedef struct {
+    pthread_mutex_t lock;
+    size_t capacity;
+    size_t count;
+    Cache_Entry** buckets;
+    size_t bucket_count;
+    Cache_Entry* newest;
+    Cache_Entry* oldest;
+    Regen_Cache_Stats stats;
+} Regex_Cache;
+
+static Regex_Cache cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .capacity = REGEN_DEFAULT_CACHE_CAPACITY,
+};
+
+uint64_t hash_regex(const char* regex);
+Cache_Entry* find_entry(uint64_t hash, const char* regex);
+void unlink_entry(Cache_Entry* entry);
+void push_newest(Cache_Entry* entry);
+void resize_buckets(size_t capacity);
+void insert_entry(char* regex, uint64_t hash, Compiled_Regex* compiled);
+void remove_entry(Cache_Entry* entry);
+bool evict_oldest_unused();
+void trim_cache(size_t capacity);
+
+uint64_t hash_regex(const char* regex) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const char* current = regex; *current != '\0'; current++) {
+        hash ^= (uint8_t)*current;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+Cache_Entry* find_entry(uint64_t hash, const char* regex) {
+    if (cache.bucket_count == 0) return NULL;
+    Cache_Entry* entry = cache.buckets[hash & (cache.bucket_count - 1)];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->regex, regex) != 0)) entry = entry->next_in_bucket;
+    return entry;
+}
+
+void unlink_entry(Cache_Entry* entry) {
+    if (entry->newer != NULL) entry->newer->older = entry->older;
+    else cache.newest = entry->older;
+    if (entry->older != NULL) entry->older->newer = entry->newer;
+    else cache.oldest = entry->newer;
+}
+
+void push_newest(Cache_Entry* entry) {
+    entry->newer = NULL;
+    entry->older = cache.newest;
+    if (cache.newest != NULL) cache.newest->newer = entry;
+    else cache.oldest = entry;
+    cache.newest = entry;
+}
+
+// Die Anzahl der Buckets ist eine Zweierpotenz, die mindestens so groß wie die Kapazität ist.
+void resize_buckets(size_t capacity) {
+    size_t bucket_count = MIN_BUCKET_COUNT;
+    while (bucket_count < capacity) bucket_count *= 2;
+    if (bucket_count <= cache.bucket_count) return;
+
+    free(cache.buckets);
+    cache.buckets = calloc(bucket_count, sizeof(Cache_Entry*));
+    cache.bucket_count = bucket_count;
+    for (Cache_Entry* entry = cache.newest; entry != NULL; entry = entry->older) {
+        Cache_Entry** bucket = &cache.buckets[entry->hash & (bucket_count - 1)];
+        entry->next_in_bucket = *bucket;
+        *bucket = entry;
+    }
+}
+
+void insert_entry(char* regex, uint64_t hash, Compiled_Regex* compiled) {
+    resize_buckets(cache.capacity);
+    Cache_Entry* entry = malloc(sizeof(Cache_Entry));
+    entry->regex = strdup(regex);
+    entry->hash = hash;
+    entry->compiled = compiled;
+    entry->compiled_in_use = true;
+    entry->idle_copy_count = 0;
+    entry->users = 1;
+    Cache_Entry** bucket = &cache.buckets[hash & (cache.bucket_count - 1)];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    push_newest(entry);
+    cache.count++;
+}
+
+void remove_entry(Cache_Entry* entry) {
+    Cache_Entry** link = &cache.buckets[entry->hash & (cache.bucket_count - 1)];
+    while (*link != entry) link = &(*link)->next_in_bucket;
+    *link = entry->next_in_bucket;
+    unlink_entry(entry);
+    cache.count--;
+
+    // Die Kopien teilen sich die Automaten von compiled und müssen deshalb vorher weg.
+    for (size_t copy = 0; copy < entry->idle_copy_count; copy++) regen_free(entry->idle_copies[copy]);
+    regen_free(entry->compiled);
+    free(entry->regex);
+    free(entry);
+}
+
+// Einträge, mit denen gerade gematcht wird, werden übersprungen. Gibt false zurück, falls es keinen anderen gibt.
+bool evict_oldest_unused() {
+    Cache_Entry* entry = cache.oldest;
+    while (entry != NULL && entry->users > 0) entry = entry->newer;
+    if (entry == NULL) return false;
+
+    remove_entry(entry);
+    cache.stats.evictions++;
+    return true;
+}
+
+void trim_cache(size_t capacity) {
+    while (cache.count > capacity && evict_oldest_unused()) {
+    }
+}
+
+Compiled_Regex* acquire_cached_regex(char* regex, Cache_Entry** entry) {
+    uint64_t hash = hash_regex(regex);
+    pthread_mutex_lock(&cache.lock);
+    Cache_Entry* found = find_entry(hash, regex);
+    if (found != NULL) {
+        Compiled_Regex* compiled = NULL;
+        if (!found->compiled_in_use) {
+            found->compiled_in_use = true;
+            compiled = found->compiled;
+        } else if (found->idle_copy_count > 0) {
+            compiled = found->idle_copies[--found->idle_copy_count];
+        }
+        found->users++;
+        unlink_entry(found);
+        push_newest(found);
+        cache.stats.hits++;
+        pthread_mutex_unlock(&cache.lock);
+
+        // Eine Kopie braucht nur leere Caches, übersetzt wird dafür nichts. Solange users nicht 0 ist, bleibt
+        // found->compiled erhalten, es darf also ohne den Lock gelesen werden.
+        if (compiled == NULL) compiled = share_compiled_regex(found->compiled);
+        *entry = found;
+        return compiled;
+    }
+    cache.stats.misses++;
+    pthread_mutex_unlock(&cache.lock);
+
+    // Übersetzt wird ohne den Lock, damit andere Threads währenddessen ihre Treffer bekommen.
+    *entry = NULL;
+    Compiled_Regex* compiled = regen_compile(regex);
+    if (compiled == NULL) return compiled;
+
+    pthread_mutex_lock(&cache.lock);
+    // Derselbe Regex kann inzwischen von einem anderen Thread eingetragen worden sein.
+    if (cache.capacity > 0 && find_entry(hash, regex) == NULL) {
+        trim_cache(cache.capacity - 1);
+        if (cache.count < cache.capacity) {
+            insert_entry(regex, hash, compiled);
+            *entry = cache.newest;
+        }
+    }
+    pthread_mutex_unlock(&cache.lock);
+    return compiled;
+}
+
+void release_cached_regex(Compiled_Regex* compiled, Cache_Entry* entry) {
+    if (entry == NULL) {
+        regen_free(compiled);
+        return;
+    }
+
+    Compiled_Regex* surplus = NULL;
+    pthread_mutex_lock(&cache.lock);
+    entry->users--;
+    if (compiled == entry->compiled) entry->compiled_in_use = false;
+    else if (entry->idle_copy_count < MAX_IDLE_COPIES) entry->idle_copies[entry->idle_copy_count++] = compiled;
+    else surplus = compiled;
+    // Wurde die Kapazität verkleinert, während mit dem Eintrag gematcht wurde, kann er erst jetzt weichen.
+    trim_cache(cache.capacity);
+    pthread_mutex_unlock(&cache.lock);
+    regen_free(surplus);
+}
+
+void regen_set_cache_capacity(size_t capacity) {
+    pthread_mutex_lock(&cache.lock);
+    cache.capacity = capacity;
+    trim_cache(capacity);
+    pthread_mutex_unlock(&cache.lock);
+}
+
+Regen_Cache_Stats regen_cache_stats() {
+    pthread_mutex_lock(&cache.lock);
+    Regen_Cache_Stats stats = cache.stats;
+    pthread_mutex_unlock(&cache.lock);
+    return stats;
+}
\ No newline at end of file
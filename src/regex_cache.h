@@ -0,0 +1,16 @@
+#ifndef REGEX_CACHE_H
+#define REGEX_CACHE_H
+
+#include "matcher.h"
+
+typedef struct Cache_Entry Cache_Entry;
+
+// Gibt den übersetzten Regex mit den Standardoptionen zurück, bis release_cached_regex gehört er nur dem Aufrufer.
+// Benutzen mehrere Threads denselben Eintrag, bekommt jeder eine Kopie mit eigenen Caches, die sich die Automaten
+// teilen. Gibt NULL zurück, falls der Regex nicht übersetzt werden kann.
+Compiled_Regex* acquire_cached_regex(char* regex, Cache_Entry** entry);
+void release_cached_regex(Compiled_Regex* compiled, Cache_Entry* entry);
+// Aus matcher.c.
+Compiled_Regex* share_compiled_regex(Compiled_Regex* original);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#!/bin/sh
+# Ruft bin/regen mit festen Regexen auf und vergleicht die Ausgabe. Wird von make test aufgerufen.
+REGEN=${REGEN:-bin/regen}
+failures=0
+
+fail() {
+    echo "FAIL: $1"
+    failures=$((failures + 1))
+}
+
+# expect_matches Beschreibung Erwartet Regex Text
+# Vergleicht alle Zeilen nach der Zeile mit der Eingabe.
+expect_matches() {
+    actual=$("$REGEN" "$3" "$4" 2>&1 | tail -n +2)
+    [ "$actual" = "$2" ] || fail "$1: expected '$2', got '$actual'"
+}
+
+# expect_line_count Beschreibung Anzahl Argumente...
+expect_line_count() {
+    description=$1
+    expected=$2
+    shift 2
+    actual=$("$REGEN" "$@" 2>&1 | wc -l)
+    [ "$actual" -eq "$expected" ] || fail "$description: expected $expected lines, got $actual"
+}
+
+# expect_syntax_error Beschreibung Regex
+# regen muss den Regex mit einer Fehlermeldung und Exit-Code 2 ablehnen, statt abzustürzen.
+expect_syntax_error() {
+    actual=$("$REGEN" "$2" x 2>&1)
+    status=$?
+    expected="$2 is not a syntactically correct regex."
+    [ "$status" -eq 2 ] && [ "$actual" = "$expected" ] || fail "$1: expected '$expected' with exit code 2, got '$actual' with $status"
+}
+
+expect_matches "multibyte codepoint" 'Habe "é" gefunden (Offset=3, Länge=2)' 'é' 'café à'
+expect_matches "multibyte literal" 'Habe "Größe" gefunden (Offset=3, Länge=7)' 'Größe' 'xx Größe'
+expect_matches "repeated multibyte codepoint" 'Habe "éé" gefunden (Offset=1, Länge=4)' 'é{2, 2}' 'aéé'
+expect_syntax_error "repetition range with one bound" 'a{1}'
+expect_syntax_error "empty repetition range" 'a{}'
+expect_syntax_error "value range with one bound" '[a]'
+expect_syntax_error "empty value range" '[]'
+expect_syntax_error "value range without upper bound" '[a, ]'
+expect_syntax_error "value range without lower bound" '[, a]'
+expect_syntax_error "invalid UTF-8 byte" "$(printf '\377')"
+expect_syntax_error "truncated UTF-8 codepoint" "$(printf 'a\303')"
+expect_syntax_error "trailing backslash" 'a\'
+expect_syntax_error "lone backslash" '\'
+
+input=$(mktemp)
+printf 'hello world\nfoo bar\nbaz\n' > "$input"
+expect_line_count "search reports the longest match per position" 5 -f '[a, z]+' "$input"
+expect_line_count "search without matches" 0 -f 'xyz' "$input"
+rm -f "$input"
+
+if [ "$failures" -gt 0 ]; then
+    echo "$failures test(s) failed."
+    exit 1
+fi
+echo "All tests passed."
\ No newline at end of file
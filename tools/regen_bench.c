@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "matcher.h"
+
+#define DEFAULT_CORPUS_MEGABYTES 8
+#define DEFAULT_RUN_COUNT 3
+#define PATHOLOGICAL_RUN_LENGTH 4095
+// Exit-Codes der Kindprozesse außer 0. Alles andere zählt als Absturz.
+#define CASE_NOT_COMPILED 2
+#define CASE_FOUND_NOTHING 3
+
+typedef enum {
+    corpus_ascii_log,
+    corpus_random_bytes,
+    corpus_utf8_text,
+    corpus_pathological,
+} Corpus_Kind;
+
+typedef struct {
+    const char* name;
+    Corpus_Kind corpus;
+    const char* regex;
+    Regen_Match_Mode mode;
+    // Falls nicht 0, wird die Eingabe darauf gekürzt. Sonst bräuchten die Fälle, die auf die Pike VM zurückfallen,
+    // bei der Standardgröße Minuten.
+    size_t input_limit;
+    // Nur bei Fällen, deren Korpus den Regex nie enthält. Findet ein anderer Fall nichts, ist das ein Fehler in regen.
+    bool may_find_nothing;
+} Bench_Case;
+
+// Die Matrix bleibt fest, damit sich Ergebnisse verschiedener Versionen Zeile für Zeile vergleichen lassen.
+// Neue Fälle kommen deshalb nur ans Ende.
+static const Bench_Case bench_cases[] = {
+    {"log_literal", corpus_ascii_log, "ERROR", match_all},
+    {"log_literal_long", corpus_ascii_log, "connection\\ refused", match_all},
+    {"log_alternation", corpus_ascii_log, "GET|POST|PUT|DELETE|PATCH", match_all},
+    {"log_status_5xx", corpus_ascii_log, "status=5[0, 9][0, 9]", match_all},
+    {"log_ip_address", corpus_ascii_log, "[0, 9]{1, 3}.[0, 9]{1, 3}.[0, 9]{1, 3}.[0, 9]{1, 3}", match_leftmost_longest},
+    {"log_email", corpus_ascii_log, "[a, z]+@[a, z]+.com", match_leftmost_longest},
+    {"log_words", corpus_ascii_log, "[a, z]{1, 64}", match_leftmost_longest},
+    {"random_literal", corpus_random_bytes, "regen", match_all, 0, true},
+    {"random_alternation", corpus_random_bytes, "abc|xyz|0123|\\n\\n", match_all},
+    {"random_class_repeat", corpus_random_bytes, "[a, z]{4, 8}", match_leftmost_longest},
+    {"random_nested_stars", corpus_random_bytes, "(a*b*)*c", match_leftmost_longest},
+    {"utf8_literal", corpus_utf8_text, "Größe", match_all},
+    {"utf8_alternation", corpus_utf8_text, "Straße|東京|αβγ|Привет", match_all},
+    {"utf8_words", corpus_utf8_text, "[a, z]+(ä|ö|ü)[a, z]*", match_leftmost_longest},
+    {"pathological_nested_stars", corpus_pathological, "(a*)*b", match_all, 0, true},
+    {"pathological_nested_groups", corpus_pathological, "((a|aa)+)+b", match_leftmost_longest, 0, true},
+    {"pathological_bounded_repeat", corpus_pathological, "a{50, 100}b", match_all, 1 << 20, true},
+    {"pathological_long_repeat", corpus_pathological, "a{1000, 1000}x", match_leftmost_longest, 64 << 10},
+    {"pathological_long_alternation", corpus_pathological, "(a|b){200, 400}x", match_shortest, 256 << 10},
+};
+
+static const char* corpus_names[] = {"ascii_log", "random_bytes", "utf8_text", "pathological"};
+static const char* mode_names[] = {"all", "longest", "first", "shortest"};
+static const char* engine_names[] = {"auto", "pike", "lazy", "full"};
+
+static const char* log_levels[] = {"DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR"};
+static const char* log_methods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE", "PATCH"};
+static const char* log_resources[] = {"users", "orders", "invoices", "sessions", "search", "health"};
+static const char* log_names[] = {"anna", "jonas", "mia", "elias", "lea", "noah", "emilia", "paul"};
+static const char* log_domains[] = {"example", "mail", "firma", "regen"};
+static const char* utf8_words[] = {
+    "Größe", "Straße", "Übermut", "schön", "können", "Bücher", "Käse", "über", "und", "der", "die", "das",
+    "regen", "Wetter", "αβγ", "λόγος", "東京", "日本語", "文字列", "Привет", "мир", "naïve", "café", "😀",
+};
+static const char* utf8_separators[] = {" ", " ", " ", ", ", ". ", "\n"};
+
+typedef struct {
+    uint64_t state;
+} Random;
+
+uint64_t next_random(Random* random);
+const char* pick(Random* random, const char** words, size_t word_count);
+uint8_t* generate_corpus(Corpus_Kind kind, size_t length);
+double seconds_since(struct timespec* start);
+Regen_Scan_Action count_match(size_t offset, size_t length, void* user_data);
+int run_case(const Bench_Case* bench_case, Regen_Engine engine, size_t length, size_t run_count);
+bool parse_engine(const char* name, Regen_Engine* engine);
+int print_usage(const char* program);
+
+#define PICK(random, words) pick(random, words, sizeof(words) / sizeof(words[0]))
+
+// xorshift64*, derselbe Startwert ergibt auf jeder Plattform dieselben Korpora.
+uint64_t next_random(Random* random) {
+    random->state ^= random->state >> 12;
+    random->state ^= random->state << 25;
+    random->state ^= random->state >> 27;
+    return random->state * 2685821657736338717ULL;
+}
+
+const char* pick(Random* random, const char** words, size_t word_count) {
+    return words[next_random(random) % word_count];
+}
+
+uint8_t* generate_corpus(Corpus_Kind kind, size_t length) {
+    uint8_t* data = malloc(length + 256);
+    Random random = {0x9e3779b97f4a7c15ULL + kind};
+    size_t filled = 0;
+    while (filled < length) {
+        char* line = (char*)data + filled;
+        switch (kind) {
+            case corpus_ascii_log: {
+                uint64_t value = next_random(&random);
+                const char* level = PICK(&random, log_levels);
+                if (value % 50 == 0) {
+                    filled += sprintf(line, "2026-10-18T%02u:%02u:%02u.%03uZ %s [worker-%u] upstream 10.%u.%u.%u:8080 "
+                                      "connection refused\n", (unsigned)(value % 24), (unsigned)(value >> 8) % 60,
+                                      (unsigned)(value >> 16) % 60, (unsigned)(value >> 24) % 1000, "ERROR",
+                                      (unsigned)(value >> 34) % 16, (unsigned)(value >> 38) % 256,
+                                      (unsigned)(value >> 46) % 256, (unsigned)(value >> 54) % 256);
+                    break;
+                }
+                filled += sprintf(line, "2026-10-18T%02u:%02u:%02u.%03uZ %s [worker-%u] %s /api/v1/%s/%u status=%u "
+                                  "user=%s@%s.com latency=%ums\n", (unsigned)(value % 24), (unsigned)(value >> 8) % 60,
+                                  (unsigned)(value >> 16) % 60, (unsigned)(value >> 24) % 1000, level,
+                                  (unsigned)(value >> 34) % 16, PICK(&random, log_methods),
+                                  PICK(&random, log_resources), (unsigned)(value >> 38) % 100000,
+                                  value % 97 == 0 ? 500 + (unsigned)(value >> 56) % 4 : 200,
+                                  PICK(&random, log_names), PICK(&random, log_domains), (unsigned)(value >> 20) % 2000);
+                break;
+            }
+            case corpus_random_bytes: {
+                uint64_t value = next_random(&random);
+                memcpy(line, &value, sizeof(value));
+                filled += sizeof(value);
+                break;
+            }
+            case corpus_utf8_text:
+                filled += sprintf(line, "%s%s", PICK(&random, utf8_words), PICK(&random, utf8_separators));
+                break;
+            // Lange Folgen von a, auf die kein b folgt. Jede Startposition läuft also bis zum Ende der Folge.
+            case corpus_pathological:
+                *line = filled % (PATHOLOGICAL_RUN_LENGTH + 1) == PATHOLOGICAL_RUN_LENGTH ? 'x' : 'a';
+                filled++;
+                break;
+        }
+    }
+    return data;
+}
+
+double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+Regen_Scan_Action count_match(size_t offset, size_t length, void* user_data) {
+    (void)offset;
+    (void)length;
+    (*(size_t*)user_data)++;
+    return scan_continue;
+}
+
+// Läuft in einem eigenen Prozess, damit ru_maxrss nur diesen Fall misst. Von jeder Zeit zählt der schnellste Lauf.
+// Gibt den Exit-Code des Kindprozesses zurück.
+int run_case(const Bench_Case* bench_case, Regen_Engine engine, size_t length, size_t run_count) {
+    uint8_t* data = generate_corpus(bench_case->corpus, length);
+    Regen_Options options = regen_default_options();
+    options.engine = engine;
+    options.match_mode = bench_case->mode;
+
+    double compile_seconds = 0;
+    Compiled_Regex* compiled = NULL;
+    for (size_t run = 0; run < run_count; run++) {
+        if (compiled != NULL) regen_free(compiled);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        compiled = regen_compile_with_options((char*)bench_case->regex, &options);
+        double seconds = seconds_since(&start);
+        if (compiled == NULL) {
+            fprintf(stderr, "%s %s.\n", bench_case->regex, regen_compile_error_message(regen_compile_error()));
+            break;
+        }
+        if (run == 0 || seconds < compile_seconds) compile_seconds = seconds;
+    }
+
+    double match_seconds = 0;
+    size_t matches = 0;
+    for (size_t run = 0; compiled != NULL && run < run_count; run++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        matches = 0;
+        regen_exec_callback(compiled, data, length, count_match, &matches);
+        double seconds = seconds_since(&start);
+        if (run == 0 || seconds < match_seconds) match_seconds = seconds;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%s\t%s\t%s\t%s\t%zu\t", bench_case->name, corpus_names[bench_case->corpus],
+           mode_names[bench_case->mode], engine_names[engine], length);
+    if (compiled == NULL) {
+        printf("-\t-\t-\t-\t%ld\n", usage.ru_maxrss);
+    } else {
+        printf("%.3f\t%.3f\t%zu\t%.0f\t%ld\n", compile_seconds * 1e3, (double)length / 1e6 / match_seconds, matches,
+               (double)matches / match_seconds, usage.ru_maxrss);
+        regen_free(compiled);
+    }
+    free(data);
+    if (compiled == NULL) return CASE_NOT_COMPILED;
+    if (matches == 0 && !bench_case->may_find_nothing) {
+        fprintf(stderr, "Case %s found no matches.\n", bench_case->name);
+        return CASE_FOUND_NOTHING;
+    }
+    return 0;
+}
+
+bool parse_engine(const char* name, Regen_Engine* engine) {
+    for (size_t index = 0; index < sizeof(engine_names) / sizeof(engine_names[0]); index++) {
+        if (!strcmp(name, engine_names[index])) {
+            *engine = (Regen_Engine)index;
+            return true;
+        }
+    }
+    return false;
+}
+
+int print_usage(const char* program) {
+    printf("Benutzung: %s [-s Megabytes] [-r Läufe] [-e auto|pike|lazy|full] [-f Filter]\n", program);
+    printf("Misst jeden Fall, dessen Name Filter enthält, und schreibt eine Zeile pro Fall als TSV auf die Standardausgabe.\n");
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = DEFAULT_CORPUS_MEGABYTES;
+    size_t run_count = DEFAULT_RUN_COUNT;
+    Regen_Engine engine = engine_auto;
+    const char* filter = "";
+
+    for (int argument = 1; argument < argc; argument += 2) {
+        if (argument + 1 >= argc) return print_usage(argv[0]);
+        const char* value = argv[argument + 1];
+        if (!strcmp(argv[argument], "-s")) megabytes = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[argument], "-r")) run_count = strtoul(value, NULL, 10);
+        else if (!strcmp(argv[argument], "-f")) filter = value;
+        else if (!strcmp(argv[argument], "-e")) {
+            if (!parse_engine(value, &engine)) return print_usage(argv[0]);
+        } else return print_usage(argv[0]);
+    }
+    if (megabytes == 0 || run_count == 0) return print_usage(argv[0]);
+
+    // Ein Fall, der nicht übersetzt werden kann (z. B. mit -e full über dfa_state_limit), bekommt - statt Zahlen.
+    printf("case\tcorpus\tmode\tengine\tinput_bytes\tcompile_ms\tmb_per_s\tmatches\tmatches_per_s\tpeak_rss_kb\n");
+    int failures = 0;
+    for (size_t index = 0; index < sizeof(bench_cases) / sizeof(bench_cases[0]); index++) {
+        const Bench_Case* bench_case = &bench_cases[index];
+        if (strstr(bench_case->name, filter) == NULL) continue;
+
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            size_t length = megabytes << 20;
+            if (bench_case->input_limit != 0 && bench_case->input_limit < length) length = bench_case->input_limit;
+            int result = run_case(bench_case, engine, length, run_count);
+            fflush(stdout);
+            _exit(result);
+        }
+        int status;
+        waitpid(child, &status, 0);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == CASE_FOUND_NOTHING) {
+            failures++;
+        } else if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0 && WEXITSTATUS(status) != CASE_NOT_COMPILED)) {
+            fprintf(stderr, "Case %s crashed.\n", bench_case->name);
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
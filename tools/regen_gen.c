@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include "matcher.h"
+
+#define DEFAULT_FUNCTION_NAME "regen_match"
+
+bool parse_match_mode(const char* name, Regen_Match_Mode* mode);
+bool is_identifier(const char* name);
+void write_regex_comment(const char* regex, const char* mode_name, FILE* output);
+int print_usage(const char* program);
+
+bool parse_match_mode(const char* name, Regen_Match_Mode* mode) {
+    if (!strcmp(name, "all")) *mode = match_all;
+    else if (!strcmp(name, "longest")) *mode = match_leftmost_longest;
+    else if (!strcmp(name, "shortest")) *mode = match_shortest;
+    else return false;
+    return true;
+}
+
+bool is_identifier(const char* name) {
+    if (*name == '\0' || (*name >= '0' && *name <= '9')) return false;
+    for (const char* current = name; *current != '\0'; current++) {
+        char c = *current;
+        bool allowed = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        if (!allowed) return false;
+    }
+    return true;
+}
+
+// Der Regex darf alles enthalten, auch Zeilenumbrüche, die den Kommentar beenden würden.
+void write_regex_comment(const char* regex, const char* mode_name, FILE* output) {
+    fprintf(output, "// Erzeugt von regen-gen -m %s aus dem Regex \"", mode_name);
+    for (const unsigned char* current = (const unsigned char*)regex; *current != '\0'; current++) {
+        if (*current < 0x20 || *current == 0x7f) fprintf(output, "\\x%02x", *current);
+        else fputc(*current, output);
+    }
+    fprintf(output, "\".\n\n");
+}
+
+int print_usage(const char* program) {
+    printf("Benutzung: %s [-m all|longest|shortest] [-n Funktionsname] [--] Regex\n", program);
+    printf("Schreibt eine C-Funktion, die den Regex ohne regen matcht, auf die Standardausgabe.\n");
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    Regen_Options options = regen_default_options();
+    const char* mode_name = "all";
+    const char* function_name = DEFAULT_FUNCTION_NAME;
+
+    // Nach -- ist alles der Regex, auch wenn er mit - anfängt.
+    int argument = 1;
+    for (; argument < argc && argv[argument][0] == '-'; argument += 2) {
+        if (!strcmp(argv[argument], "--")) {
+            argument++;
+            break;
+        }
+        if (argument + 1 >= argc) return print_usage(argv[0]);
+        if (!strcmp(argv[argument], "-m")) mode_name = argv[argument + 1];
+        else if (!strcmp(argv[argument], "-n")) function_name = argv[argument + 1];
+        else return print_usage(argv[0]);
+    }
+    if (argument != argc - 1) return print_usage(argv[0]);
+
+    // Die Standardausgabe gehört dem erzeugten Code, Fehler gehen deshalb nach stderr.
+    if (!parse_match_mode(mode_name, &options.match_mode)) {
+        fprintf(stderr, "Unknown match mode %s.\n", mode_name);
+        return 1;
+    }
+    if (!is_identifier(function_name)) {
+        fprintf(stderr, "%s is not a valid C function name.\n", function_name);
+        return 1;
+    }
+
+    Compiled_Regex* compiled = regen_compile_with_options(argv[argument], &options);
+    if (compiled == NULL) {
+        fprintf(stderr, "%s %s.\n", argv[argument], regen_compile_error_message(regen_compile_error()));
+        return 1;
+    }
+
+    write_regex_comment(argv[argument], mode_name, stdout);
+    bool generated = regen_generate_c(compiled, function_name, stdout);
+    if (!generated) fprintf(stderr, "%s %s.\n", argv[argument], regen_compile_error_message(regen_compile_error()));
+    regen_free(compiled);
+    return generated ? 0 : 1;
+}
\ No newline at end of file